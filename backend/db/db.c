@@ -0,0 +1,206 @@
+#include "db.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/* a section of count items of width bytes, inside the image and aligned */
+static bool
+re_db_section(size_t size, uint32_t off, uint64_t count, size_t width)
+{
+    return off % RE_DB_ALIGN == 0 && off <= size && count * width <= size - off;
+}
+
+/**
+ * @brief Check a database image and point a handle into it. The image is
+ * read once, in order, and never copied or changed.
+ *
+ * @param db Handle to fill in.
+ * @param image Database bytes, aligned to RE_DB_ALIGN.
+ * @param size Length of the image.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the image is not a database
+ * this reader understands.
+ */
+int re_db_load(re_db* db, const void* image, size_t size)
+{
+    const re_db_header* h = (const re_db_header*)image;
+
+    memset(db, 0, sizeof(re_db));
+    if (size < sizeof(re_db_header) || (uintptr_t)image % RE_DB_ALIGN)
+        return EXIT_FAILURE;
+    if (memcmp(h->magic, RE_DB_MAGIC, 4) || h->version != RE_DB_VERSION || h->order != RE_DB_ORDER)
+        return EXIT_FAILURE;
+    if (h->size != size || h->nstates == 0 || h->nclasses == 0 || h->nclasses > 256 || h->start >= h->nstates)
+        return EXIT_FAILURE;
+
+    if (!re_db_section(size, h->classes, 256, 1)
+     || !re_db_section(size, h->trans, (uint64_t)h->nstates * h->nclasses, 4)
+     || !re_db_section(size, h->accepts, (uint64_t)h->nstates + 1, 4)
+     || !re_db_section(size, h->ids, h->nids, 4)
+     || !re_db_section(size, h->names, h->npatterns, 4)
+     || !re_db_section(size, h->strings, h->nstrings, 1))
+        return EXIT_FAILURE;
+
+    db->base    = (const unsigned char*)image;
+    db->size    = size;
+    db->hdr     = h;
+    db->classes = db->base + h->classes;
+    db->trans   = (const uint32_t*)(db->base + h->trans);
+    db->accepts = (const uint32_t*)(db->base + h->accepts);
+    db->ids     = (const uint32_t*)(db->base + h->ids);
+    db->names   = (const uint32_t*)(db->base + h->names);
+    db->strings = (const char*)(db->base + h->strings);
+
+    /* every index must stay inside its section, so matching never has to check */
+    for (int c = 0; c < 256; ++c)
+        if (db->classes[c] >= h->nclasses)
+            return EXIT_FAILURE;
+    for (uint64_t i = 0; i < (uint64_t)h->nstates * h->nclasses; ++i)
+        if (db->trans[i] >= h->nstates)
+            return EXIT_FAILURE;
+    for (uint32_t s = 0; s < h->nstates; ++s)
+        if (db->accepts[s] > db->accepts[s+1])
+            return EXIT_FAILURE;
+    if (db->accepts[0] != 0 || db->accepts[h->nstates] != h->nids)
+        return EXIT_FAILURE;
+    for (uint32_t i = 0; i < h->nids; ++i)
+        if (db->ids[i] >= h->npatterns)
+            return EXIT_FAILURE;
+    if (h->npatterns && (h->nstrings == 0 || db->strings[h->nstrings - 1] != '\0'))
+        return EXIT_FAILURE;
+    for (uint32_t p = 0; p < h->npatterns; ++p)
+        if (db->names[p] >= h->nstrings)
+            return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Map a database file into memory.
+ *
+ * @param db Handle to fill in.
+ * @param path File written by regexer -d.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE with errno set when the file could
+ * not be read, or left alone when it is not a valid database.
+ */
+int re_db_open(re_db* db, const char* path)
+{
+    void* image;
+    size_t size;
+
+#ifndef _WIN32
+    int fd;
+    struct stat st;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return EXIT_FAILURE;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    size  = (size_t)st.st_size;
+    image = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (image == MAP_FAILED)
+        return EXIT_FAILURE;
+
+    if (re_db_load(db, image, size) != EXIT_SUCCESS) {
+        munmap(image, size);
+        return EXIT_FAILURE;
+    }
+#else
+    FILE* fptr;
+
+    if ((fptr = fopen(path, "rb")) == NULL)
+        return EXIT_FAILURE;
+    fseek(fptr, 0, SEEK_END);
+    size = (size_t)ftell(fptr);
+    rewind(fptr);
+
+    image = _aligned_malloc(size ? size : 1, RE_DB_ALIGN);
+    if (fread(image, 1, size, fptr) != size || re_db_load(db, image, size) != EXIT_SUCCESS) {
+        fclose(fptr);
+        _aligned_free(image);
+        return EXIT_FAILURE;
+    }
+    fclose(fptr);
+#endif
+
+    db->mapped = true;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Release a database opened with re_db_open. Images handed to
+ * re_db_load stay with their owner.
+ *
+ * @param db Handle to release.
+ */
+void re_db_close(re_db* db)
+{
+    if (db->mapped) {
+#ifndef _WIN32
+        munmap((void*)db->base, db->size);
+#else
+        _aligned_free((void*)db->base);
+#endif
+    }
+    memset(db, 0, sizeof(re_db));
+}
+
+/**
+ * @brief Find the patterns matching a prefix of a string.
+ *
+ * @param db Database to match with.
+ * @param str NUL terminated input; matches start at its first byte.
+ * @param ids Where to store the ids of matching patterns, ascending.
+ * @param max Room in ids; may be 0 when only the count is wanted.
+ * @return Number of patterns that match, which can be more than max.
+ */
+int re_db_match(re_db* db, const char* str, uint32_t* ids, int max)
+{
+    int count = 0;
+    uint32_t state = db->hdr->start;
+    uint32_t nclasses = db->hdr->nclasses;
+    uint32_t npatterns = db->hdr->npatterns;
+    uint8_t seen[(npatterns + 7) / 8 + 1];
+
+    memset(seen, 0, sizeof(seen));
+    for (;;) {
+        for (uint32_t i = db->accepts[state]; i < db->accepts[state+1]; ++i) {
+            uint32_t id = db->ids[i];
+            if (!(seen[id >> 3] & (1 << (id & 7)))) {
+                seen[id >> 3] |= 1 << (id & 7);
+                count++;
+            }
+        }
+        if (*str == '\0' || count == (int)npatterns)
+            break;
+        state = db->trans[state * nclasses + db->classes[(unsigned char)*str++]];
+        if (state == 0)
+            break;
+    }
+
+    /* the bitmap is in id order, so the ids come out sorted */
+    for (uint32_t id = 0, n = 0; id < npatterns && (int)n < max; ++id)
+        if (seen[id >> 3] & (1 << (id & 7)))
+            ids[n++] = id;
+
+    return count;
+}
+
+/**
+ * @brief Name of a pattern, as given in the manifest.
+ *
+ * @param db Database holding the pattern.
+ * @param id Pattern id.
+ * @return The name, or NULL for an unknown id.
+ */
+const char* re_db_name(re_db* db, uint32_t id)
+{
+    return id < db->hdr->npatterns ? db->strings + db->names[id] : NULL;
+}
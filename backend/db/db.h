@@ -0,0 +1,76 @@
+#ifndef DB_H
+#define DB_H
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * A compiled rule database: one DFA over every pattern of a manifest,
+ * laid out so a mapped file can be matched against in place. Every
+ * section starts on a RE_DB_ALIGN boundary and is found through the
+ * header by offset, so the file can be mapped anywhere.
+ *
+ *   classes  256 bytes, the byte class of every input byte
+ *   trans    nstates * nclasses u32, the next state; state 0 is dead
+ *   accepts  nstates + 1 u32, where each state's accepted ids start
+ *   ids      u32 pattern ids, ascending within each state
+ *   names    npatterns u32, where each pattern's name starts
+ *   strings  NUL terminated pattern names
+ *
+ * Numbers are in the byte order of the writer; order tells a reader
+ * with the other order to refuse the file.
+ */
+#define RE_DB_MAGIC   "RXDB"
+#define RE_DB_VERSION 1
+#define RE_DB_ORDER   0x01020304u
+#define RE_DB_ALIGN   64
+
+typedef struct
+re_db_header
+{
+    char     magic[4];                          // RE_DB_MAGIC, unterminated
+    uint32_t version;                           // RE_DB_VERSION
+    uint32_t order;                             // RE_DB_ORDER as written
+    uint32_t size;                              // Length of the whole file
+    uint32_t nstates;                           // States, the dead one included
+    uint32_t nclasses;                          // Byte classes, row width of trans
+    uint32_t npatterns;                         // Patterns, numbered from 0
+    uint32_t start;                             // State matching begins in
+    uint32_t classes;                           // Offset of the class map
+    uint32_t trans;                             // Offset of the transition table
+    uint32_t accepts;                           // Offset of the accept index
+    uint32_t ids;                               // Offset of the accepted ids
+    uint32_t names;                             // Offset of the name index
+    uint32_t strings;                           // Offset of the names
+    uint32_t nids;                              // Number of accepted ids
+    uint32_t nstrings;                          // Length of the names
+}
+re_db_header;
+
+typedef struct
+re_db
+{
+    const unsigned char* base;                  // Start of the image
+    size_t size;                                // Length of the image
+    bool mapped;                                // Whether base came from mmap
+    const re_db_header* hdr;                    // Header, at base
+    const uint8_t* classes;                     // Class of every byte
+    const uint32_t* trans;                      // Row per state, column per class
+    const uint32_t* accepts;                    // Index into ids per state
+    const uint32_t* ids;                        // Accepted ids
+    const uint32_t* names;                      // Index into strings per pattern
+    const char* strings;                        // Pattern names
+}
+re_db;
+
+int re_db_load(re_db* db, const void* image, size_t size);
+int re_db_open(re_db* db, const char* path);
+void re_db_close(re_db* db);
+int re_db_match(re_db* db, const char* str, uint32_t* ids, int max);
+const char* re_db_name(re_db* db, uint32_t id);
+
+#endif
@@ -0,0 +1,914 @@
+#include "dfa.h"
+#include "../prog/prog.h"
+#include "../db/db.h"
+#include "../../types/stack/stack.h"
+
+enum { RE_NFA_BYTES, RE_NFA_EPS, RE_NFA_ACCEPT };
+
+typedef struct
+re_nfa_state
+{
+    int kind;                                   // One of the RE_NFA_ kinds
+    int out;                                    // Next state, -1 for none
+    int out1;                                   // Second epsilon edge, -1 for none
+    int arg;                                    // Bitmap for bytes, id for accept
+}
+re_nfa_state;
+
+typedef struct
+re_nfa
+{
+    m_stack states;                             // re_nfa_state
+    m_stack sets;                               // Bitmaps, RE_SET_BYTES each
+    bool reverse;                               // Whether sequences run back to front
+}
+re_nfa;
+
+typedef struct
+re_frag
+{
+    int start;                                  // Entry state
+    int end;                                    // Epsilon state left dangling
+}
+re_frag;
+
+#define re_nfa_at(n, i) (((re_nfa_state*)(n)->states.content) + (i))
+#define re_nfa_set(n, i) (((unsigned char*)(n)->sets.content) + (i) * RE_SET_BYTES)
+
+static int
+re_nfa_add(re_nfa* n, int kind, int out, int out1, int arg)
+{
+    m_stack_push(&n->states, &(re_nfa_state) { .kind = kind, .out = out, .out1 = out1, .arg = arg });
+    return n->states.count - 1;
+}
+
+static int
+re_nfa_addset(re_nfa* n, unsigned char* set)
+{
+    for (int i = 0; i < RE_SET_BYTES; ++i)
+        m_stack_push(&n->sets, &set[i]);
+    return n->sets.count / RE_SET_BYTES - 1;
+}
+
+/* a fragment consuming one byte from a bitmap */
+static re_frag
+re_nfa_bytes(re_nfa* n, unsigned char* set)
+{
+    int end = re_nfa_add(n, RE_NFA_EPS, -1, -1, 0);
+    int arg = re_nfa_addset(n, set);
+    return (re_frag) { .start = re_nfa_add(n, RE_NFA_BYTES, end, -1, arg), .end = end };
+}
+
+static re_frag
+re_nfa_str(re_nfa* n, char* str, int len)
+{
+    re_frag f, g;
+    unsigned char set[RE_SET_BYTES];
+
+    f.start = f.end = re_nfa_add(n, RE_NFA_EPS, -1, -1, 0);
+    for (int k = 0; k < len; ++k) {
+        int i = n->reverse ? len - 1 - k : k;
+        memset(set, 0, RE_SET_BYTES);
+        set[(unsigned char)str[i] >> 3] |= 1 << ((unsigned char)str[i] & 7);
+        g = re_nfa_bytes(n, set);
+        re_nfa_at(n, f.end)->out = g.start;
+        f.end = g.end;
+    }
+    return f;
+}
+
+static re_frag re_nfa_exp(re_nfa* n, re_exp* re);
+
+static re_frag
+re_nfa_seq(re_nfa* n, re_comp* comp)
+{
+    re_frag f, g;
+    m_stack order;
+
+    /* a reversed automaton takes the steps last to first */
+    order = m_stack_init(re_comp*);
+    for (; comp; comp = comp->next)
+        m_stack_push(&order, &comp);
+
+    f.start = f.end = re_nfa_add(n, RE_NFA_EPS, -1, -1, 0);
+    for (int k = 0; k < order.count; ++k) {
+        int i = n->reverse ? order.count - 1 - k : k;
+        g = re_nfa_exp(n, ((re_comp**)order.content)[i]->elem);
+        re_nfa_at(n, f.end)->out = g.start;
+        f.end = g.end;
+    }
+
+    free(order.content);
+    return f;
+}
+
+/* either of two fragments */
+static re_frag
+re_nfa_alt(re_nfa* n, re_frag a, re_frag b)
+{
+    int end = re_nfa_add(n, RE_NFA_EPS, -1, -1, 0);
+
+    re_nfa_at(n, a.end)->out = end;
+    re_nfa_at(n, b.end)->out = end;
+    return (re_frag) { .start = re_nfa_add(n, RE_NFA_EPS, a.start, b.start, 0), .end = end };
+}
+
+static re_frag
+re_nfa_exp(re_nfa* n, re_exp* re)
+{
+    re_frag f, g;
+    re_comp* iter;
+    unsigned char set[RE_SET_BYTES];
+
+    switch (re->tag)
+    {
+        case char_exp:
+        case range_exp:
+        case dot_exp:
+        case select_exp:
+            re_set_fill(set, re);
+            return re_nfa_bytes(n, set);
+
+        case str_exp:
+            return re_nfa_str(n, re->op.strExp.str, re->op.strExp.len);
+
+        case plain_exp:
+            return re_nfa_seq(n, re->op.plainExp);
+
+        case bar_exp:
+            if (!(re->op.barExp.left && re->op.barExp.right))
+                return re_nfa_seq(n, re->op.barExp.left ? re->op.barExp.left : re->op.barExp.right);
+            f = re_nfa_seq(n, re->op.barExp.left);
+            for (; re_bar_chained(re->op.barExp.right); re = re->op.barExp.right->elem)
+                f = re_nfa_alt(n, f, re_nfa_seq(n, re->op.barExp.right->elem->op.barExp.left));
+            return re_nfa_alt(n, f, re_nfa_seq(n, re->op.barExp.right));
+
+        case trie_exp:
+            f = re_nfa_exp(n, re->op.trieExp->elem);
+            for (iter = re->op.trieExp->next; iter; iter = iter->next)
+                f = re_nfa_alt(n, f, re_nfa_exp(n, iter->elem));
+            return f;
+
+        case opt_exp:
+            f = re_nfa_seq(n, re->op.optExp);
+            g.start = g.end = re_nfa_add(n, RE_NFA_EPS, -1, -1, 0);
+            return re_nfa_alt(n, f, g);
+
+        case kleene_exp:
+        case rep_exp:
+            /* body, then back round or out; a* may also skip the body */
+            f = re_nfa_seq(n, re->op.kleeneExp);
+            g.end = re_nfa_add(n, RE_NFA_EPS, -1, -1, 0);
+            re_nfa_at(n, f.end)->out  = f.start;
+            re_nfa_at(n, f.end)->out1 = g.end;
+            g.start = re->tag == rep_exp ? f.start : re_nfa_add(n, RE_NFA_EPS, f.start, g.end, 0);
+            return g;
+
+        default:
+            g.start = g.end = re_nfa_add(n, RE_NFA_EPS, -1, -1, 0);
+            return g;
+    }
+}
+
+typedef struct
+re_subset
+{
+    re_nfa* nfa;
+    int* mark;                                  // Generation each NFA state was last seen in
+    int gen;                                    // Current generation
+    m_stack work;                               // States still to follow
+    m_stack keys;                               // Sorted NFA states of every DFA state
+    m_stack offs;                               // Where each DFA state's key starts
+    int* table;                                 // Open addressing, DFA state or -1
+    int tsize;                                  // Slots in table, a power of two
+}
+re_subset;
+
+static int
+re_int_comp(const void* a, const void* b)
+{
+    return *(const int*)a - *(const int*)b;
+}
+
+/**
+ * follow epsilon edges, keeping only the states that consume or accept,
+ * added sorted to the end of out. states seen since the last call of
+ * re_subset_close are left out, so earlier groups keep them.
+ */
+static void
+re_subset_follow(re_subset* s, m_stack* seed, m_stack* out)
+{
+    int from = out->count;
+
+    s->work.count = 0;
+
+    for (int i = 0; i < seed->count; ++i)
+        m_stack_push(&s->work, (int*)seed->content + i);
+
+    while (s->work.count) {
+        int id = *(int*)m_stack_pop(&s->work);
+        re_nfa_state* st;
+
+        if (id < 0 || s->mark[id] == s->gen)
+            continue;
+        s->mark[id] = s->gen;
+        st = re_nfa_at(s->nfa, id);
+
+        if (st->kind == RE_NFA_EPS) {
+            m_stack_push(&s->work, &st->out1);
+            m_stack_push(&s->work, &st->out);
+        }
+        else m_stack_push(out, &id);
+    }
+
+    qsort((int*)out->content + from, out->count - from, sizeof(int), re_int_comp);
+}
+
+static void
+re_subset_close(re_subset* s, m_stack* seed, m_stack* out)
+{
+    out->count = 0;
+    s->gen++;
+    re_subset_follow(s, seed, out);
+}
+
+/* whether any of count NFA states from first on accepts */
+static bool
+re_subset_accepts(re_nfa* n, int* first, int count)
+{
+    for (int i = 0; i < count; ++i)
+        if (first[i] >= 0 && re_nfa_at(n, first[i])->kind == RE_NFA_ACCEPT)
+            return true;
+    return false;
+}
+
+/**
+ * the next leftmost state. its key lists groups of NFA states, each ended
+ * by RE_KEY_GROUP, in the order their matches started; a state in an
+ * earlier group is left out of later ones. a group that accepts drops the
+ * groups after it, since their matches start later, and once anything
+ * has matched no new match is started; RE_KEY_MATCHED at the end says so.
+ */
+#define RE_KEY_GROUP   -1
+#define RE_KEY_MATCHED -2
+
+static void
+re_subset_leftmost(re_subset* s, int* key, int len, int byte, int start, m_stack* seed, m_stack* out)
+{
+    bool matched = len > 0 && key[len - 1] == RE_KEY_MATCHED;
+    bool accepts = false;
+    int from;
+
+    out->count = 0;
+    s->gen++;
+    for (int i = 0; i < len && !accepts; ++i) {
+        seed->count = 0;
+        for (; i < len && key[i] >= 0; ++i) {
+            re_nfa_state* st = re_nfa_at(s->nfa, key[i]);
+            if (byte >= 0 && st->kind == RE_NFA_BYTES && re_set_has(re_nfa_set(s->nfa, st->arg), byte))
+                m_stack_push(seed, &st->out);
+        }
+        from = out->count;
+        re_subset_follow(s, seed, out);
+        if (out->count > from) {
+            accepts = re_subset_accepts(s->nfa, (int*)out->content + from, out->count - from);
+            m_stack_push(out, (int[]){ RE_KEY_GROUP });
+        }
+    }
+
+    /* a match may still start here */
+    if (!matched && !accepts) {
+        seed->count = 0;
+        m_stack_push(seed, &start);
+        from = out->count;
+        re_subset_follow(s, seed, out);
+        if (out->count > from) {
+            accepts = re_subset_accepts(s->nfa, (int*)out->content + from, out->count - from);
+            m_stack_push(out, (int[]){ RE_KEY_GROUP });
+        }
+    }
+
+    /* with no groups left the state is dead, however it got there */
+    if (out->count && (matched || accepts))
+        m_stack_push(out, (int[]){ RE_KEY_MATCHED });
+}
+
+static unsigned long
+re_subset_hash(int* key, int len)
+{
+    unsigned long h = 5381;
+    for (int i = 0; i < len; ++i)
+        h = ((h << 5) + h) ^ (unsigned long)key[i];
+    return h;
+}
+
+static int*
+re_subset_key(re_subset* s, int state, int* len)
+{
+    int* offs = (int*)s->offs.content;
+    *len = offs[state + 1] - offs[state];
+    return (int*)s->keys.content + offs[state];
+}
+
+/* the DFA state for a set of NFA states, or -1 if it is new */
+static int
+re_subset_find(re_subset* s, m_stack* set, unsigned long h)
+{
+    for (unsigned long i = h & (s->tsize - 1); s->table[i] != -1; i = (i + 1) & (s->tsize - 1)) {
+        int len;
+        int* key = re_subset_key(s, s->table[i], &len);
+        if (len == set->count && !memcmp(key, set->content, len * sizeof(int)))
+            return s->table[i];
+    }
+    return -1;
+}
+
+static void
+re_subset_insert(re_subset* s, int state, unsigned long h)
+{
+    unsigned long i;
+
+    /* keep the table at most half full */
+    if (2 * (state + 1) > s->tsize) {
+        int old = s->tsize;
+        int* prev = s->table;
+
+        s->tsize *= 2;
+        s->table  = (int*)malloc(s->tsize * sizeof(int));
+        memset(s->table, -1, s->tsize * sizeof(int));
+        for (int j = 0; j < old; ++j) {
+            if (prev[j] != -1) {
+                int len;
+                int* key = re_subset_key(s, prev[j], &len);
+                for (i = re_subset_hash(key, len) & (s->tsize - 1); s->table[i] != -1; i = (i + 1) & (s->tsize - 1));
+                s->table[i] = prev[j];
+            }
+        }
+        free(prev);
+    }
+
+    for (i = h & (s->tsize - 1); s->table[i] != -1; i = (i + 1) & (s->tsize - 1));
+    s->table[i] = state;
+}
+
+/* number a new set of NFA states as the next DFA state */
+static int
+re_subset_add(re_subset* s, m_stack* set, unsigned long h)
+{
+    int id = s->offs.count - 1;
+
+    for (int i = 0; i < set->count; ++i)
+        m_stack_push(&s->keys, (int*)set->content + i);
+    m_stack_push(&s->offs, &s->keys.count);
+    re_subset_insert(s, id, h);
+
+    return id;
+}
+
+/* split bytes into classes no bitmap tells apart */
+static int
+re_dfa_classes(re_nfa* n, unsigned char* classes)
+{
+    int count = 1;
+    int remap[2][256];
+    int nsets = n->sets.count / RE_SET_BYTES;
+
+    memset(classes, 0, 256);
+    for (int i = 0; i < nsets; ++i) {
+        unsigned char* set = re_nfa_set(n, i);
+
+        memset(remap, -1, sizeof(remap));
+        count = 0;
+        for (int c = 0; c < 256; ++c) {
+            int in = re_set_has(set, c);
+            if (remap[in][classes[c]] == -1)
+                remap[in][classes[c]] = count++;
+            classes[c] = remap[in][classes[c]];
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Build one automaton recognising a prefix of any of the patterns.
+ *
+ * @param pats Pattern trees from the front end; pattern i gets id i.
+ * @param count Number of patterns.
+ * @param maxstates Most states to create, RE_DFA_MAX_STATES if 0 or less.
+ * @return The automaton, or NULL if it would need more than maxstates.
+ */
+re_dfa* re_dfa_build(re_exp** pats, int count, int maxstates)
+{
+    return re_dfa_compile(pats, count, maxstates, 0);
+}
+
+/**
+ * @brief Build an automaton over the patterns, in one of several modes.
+ * RE_DFA_REVERSE reads the patterns back to front, for running over an
+ * input from its end. RE_DFA_LEFTMOST lets matches start anywhere but
+ * stops starting them once one has matched, and forgets those that began
+ * after a match; the last accept before the dead state then ends the
+ * leftmost longest match. RE_DFA_ANYWHERE lets matches start anywhere
+ * and keeps starting them, so a state accepts wherever a match ends.
+ *
+ * @param pats Pattern trees from the front end; pattern i gets id i.
+ * @param count Number of patterns.
+ * @param maxstates Most states to create, RE_DFA_MAX_STATES if 0 or less.
+ * @param flags RE_DFA_ flags.
+ * @return The automaton, or NULL if it would need more than maxstates.
+ */
+re_dfa* re_dfa_compile(re_exp** pats, int count, int maxstates, int flags)
+{
+    int start;
+    re_nfa nfa;
+    re_dfa* dfa;
+    re_subset s;
+    m_stack seed, set, trans, accepts, ids;
+    int reps[256];
+
+    if (maxstates <= 0)
+        maxstates = RE_DFA_MAX_STATES;
+
+    /* one NFA, entered through a fan of epsilon edges */
+    nfa.states  = m_stack_init(re_nfa_state);
+    nfa.sets    = m_stack_init(unsigned char);
+    nfa.reverse = (flags & RE_DFA_REVERSE) != 0;
+    start       = -1;
+    for (int i = count - 1; i >= 0; --i) {
+        re_frag f  = re_nfa_exp(&nfa, pats[i]);
+        int accept = re_nfa_add(&nfa, RE_NFA_ACCEPT, -1, -1, i);
+        re_nfa_at(&nfa, f.end)->out = accept;
+        start = re_nfa_add(&nfa, RE_NFA_EPS, f.start, start, 0);
+    }
+
+    dfa = (re_dfa*)malloc(sizeof(re_dfa));
+    dfa->npatterns = count;
+    dfa->nclasses  = re_dfa_classes(&nfa, dfa->classes);
+    for (int c = 255; c >= 0; --c)
+        reps[dfa->classes[c]] = c;
+
+    s.nfa   = &nfa;
+    s.mark  = (int*)calloc(nfa.states.count, sizeof(int));
+    s.gen   = 0;
+    s.work  = m_stack_init(int);
+    s.keys  = m_stack_init(int);
+    s.offs  = m_stack_init(int);
+    s.tsize = 64;
+    s.table = (int*)malloc(s.tsize * sizeof(int));
+    memset(s.table, -1, s.tsize * sizeof(int));
+
+    seed    = m_stack_init(int);
+    set     = m_stack_init(int);
+    trans   = m_stack_init(int);
+    accepts = m_stack_init(int);
+    ids     = m_stack_init(int);
+    m_stack_push(&s.offs, (int[]){ 0 });
+    m_stack_push(&accepts, (int[]){ 0 });
+
+    /* state 0 is the empty set, so it is dead */
+    re_subset_add(&s, &set, re_subset_hash(set.content, 0));
+    if (flags & RE_DFA_LEFTMOST)
+        re_subset_leftmost(&s, NULL, 0, -1, start, &seed, &set);
+    else {
+        m_stack_push(&seed, &start);
+        re_subset_close(&s, &seed, &set);
+    }
+    dfa->start = re_subset_find(&s, &set, re_subset_hash(set.content, set.count));
+    if (dfa->start == -1)
+        dfa->start = re_subset_add(&s, &set, re_subset_hash(set.content, set.count));
+
+    /* states are numbered as they are found, and filled in the same order */
+    for (int cur = 0; cur < s.offs.count - 1; ++cur)
+    {
+        int len;
+        int* key = re_subset_key(&s, cur, &len);
+
+        for (int i = 0; i < len; ++i)
+            if (key[i] >= 0 && re_nfa_at(&nfa, key[i])->kind == RE_NFA_ACCEPT)
+                m_stack_push(&ids, &re_nfa_at(&nfa, key[i])->arg);
+        qsort((int*)ids.content + ((int*)accepts.content)[cur], ids.count - ((int*)accepts.content)[cur], sizeof(int), re_int_comp);
+        m_stack_push(&accepts, &ids.count);
+
+        for (int c = 0; c < dfa->nclasses; ++c)
+        {
+            int next;
+            unsigned long h;
+
+            key = re_subset_key(&s, cur, &len);
+            if (flags & RE_DFA_LEFTMOST)
+                re_subset_leftmost(&s, key, len, reps[c], start, &seed, &set);
+            else {
+                seed.count = 0;
+                for (int i = 0; i < len; ++i) {
+                    re_nfa_state* st = re_nfa_at(&nfa, key[i]);
+                    if (st->kind == RE_NFA_BYTES && re_set_has(re_nfa_set(&nfa, st->arg), reps[c]))
+                        m_stack_push(&seed, &st->out);
+                }
+                /* the dead state stays dead, so it never starts one */
+                if ((flags & RE_DFA_ANYWHERE) && cur != 0)
+                    m_stack_push(&seed, &start);
+                re_subset_close(&s, &seed, &set);
+            }
+
+            h = re_subset_hash(set.content, set.count);
+            if ((next = re_subset_find(&s, &set, h)) == -1) {
+                if (s.offs.count - 1 >= maxstates) {
+                    dfa->nstates = -1;
+                    goto out;
+                }
+                next = re_subset_add(&s, &set, h);
+            }
+            m_stack_push(&trans, &next);
+        }
+    }
+    dfa->nstates = s.offs.count - 1;
+
+out:
+    free(s.mark);
+    free(s.table);
+    free(s.work.content);
+    free(s.keys.content);
+    free(s.offs.content);
+    free(seed.content);
+    free(set.content);
+    free(nfa.states.content);
+    free(nfa.sets.content);
+
+    if (dfa->nstates < 0) {
+        free(trans.content);
+        free(accepts.content);
+        free(ids.content);
+        free(dfa);
+        return NULL;
+    }
+
+    dfa->trans   = (int*)trans.content;
+    dfa->accepts = (int*)accepts.content;
+    dfa->ids     = (int*)ids.content;
+    dfa->nids    = ids.count;
+
+    return dfa;
+}
+
+/**
+ * @brief Check whether any pattern matches a prefix of a string.
+ *
+ * @param dfa Automaton to run.
+ * @param str NUL terminated input.
+ * @return Whether some pattern matches.
+ */
+bool re_dfa_match(re_dfa* dfa, const char* str)
+{
+    int state = dfa->start;
+
+    for (;;) {
+        if (dfa->accepts[state + 1] > dfa->accepts[state])
+            return true;
+        if (*str == '\0')
+            return false;
+        state = dfa->trans[state * dfa->nclasses + dfa->classes[(unsigned char)*str++]];
+        if (state == 0)
+            return false;
+    }
+}
+
+/**
+ * the table re_dfa_match_many runs on: each entry is the next state's row
+ * offset shifted left twice, under 1 when that state accepts and 2 when
+ * it is dead, so a step is a shift and an add rather than a multiply, and
+ * whether to stop comes with the same load.
+ */
+static unsigned*
+re_dfa_lane_table(re_dfa* dfa, unsigned* start)
+{
+    long size = (long)dfa->nstates * dfa->nclasses;
+    unsigned* table = (unsigned*)malloc(size * sizeof(unsigned));
+
+    for (long i = 0; i < size; ++i) {
+        int s = dfa->trans[i];
+        int halt = dfa->accepts[s + 1] > dfa->accepts[s] ? 1 : s == 0 ? 2 : 0;
+        table[i] = (unsigned)(s * dfa->nclasses) << 2 | halt;
+    }
+    *start = (unsigned)(dfa->start * dfa->nclasses) << 2 | (dfa->accepts[dfa->start + 1] > dfa->accepts[dfa->start]);
+    return table;
+}
+
+/**
+ * advance up to lanes strings at once, one byte each per round, so the
+ * table loads of different strings are in flight together. A lane whose
+ * string is done takes the next one; with lanes constant at the call,
+ * the lane arrays can live in registers.
+ */
+static inline void
+re_dfa_lanes(re_dfa* dfa, const unsigned* table, unsigned start, const char** strs, size_t count, bool* out, const int lanes)
+{
+    unsigned state[RE_DFA_MAX_LANES];
+    size_t index[RE_DFA_MAX_LANES];
+    const unsigned char* at[RE_DFA_MAX_LANES];
+    const unsigned char* classes = dfa->classes;
+    size_t next = 0;
+    int live = 0;
+
+    /* idle lanes sit in the dead state with no string to report */
+    for (int l = 0; l < lanes; ++l) {
+        index[l] = next < count ? next++ : (size_t)-1;
+        at[l]    = (const unsigned char*)(index[l] != (size_t)-1 ? strs[index[l]] : "");
+        state[l] = index[l] != (size_t)-1 ? start : 2;
+        live    += index[l] != (size_t)-1;
+    }
+
+    while (live > 0)
+    {
+#ifdef __GNUC__
+#pragma GCC unroll 8
+#endif
+        for (int l = 0; l < lanes; ++l)
+        {
+            unsigned c = *at[l];
+
+            if ((state[l] & 3) | !c) {
+                if (index[l] == (size_t)-1)
+                    continue;
+                out[index[l]] = (state[l] & 3) == 1;
+                if (next < count) {
+                    index[l] = next;
+                    at[l]    = (const unsigned char*)strs[next++];
+                    state[l] = start;
+                } else {
+                    index[l] = (size_t)-1;
+                    state[l] = 2;
+                    live--;
+                }
+                continue;
+            }
+            state[l] = table[(state[l] >> 2) + classes[c]];
+            at[l]++;
+        }
+    }
+}
+
+/**
+ * @brief Check many strings, as re_dfa_match does each, advancing several
+ * of them in step to hide the latency of the table.
+ *
+ * @param dfa Automaton to run.
+ * @param strs NUL terminated inputs.
+ * @param count Number of inputs.
+ * @param out Whether some pattern matches each input, in the order of strs.
+ * @param lanes Strings advanced together: 1, 2, 4 or RE_DFA_MAX_LANES.
+ */
+void re_dfa_match_many(re_dfa* dfa, const char** strs, size_t count, bool* out, int lanes)
+{
+    unsigned start;
+    unsigned* table = re_dfa_lane_table(dfa, &start);
+
+    switch (lanes)
+    {
+        case 1:  re_dfa_lanes(dfa, table, start, strs, count, out, 1); break;
+        case 2:  re_dfa_lanes(dfa, table, start, strs, count, out, 2); break;
+        case 4:  re_dfa_lanes(dfa, table, start, strs, count, out, 4); break;
+        default: re_dfa_lanes(dfa, table, start, strs, count, out, RE_DFA_MAX_LANES); break;
+    }
+
+    free(table);
+}
+
+static void
+re_dfa_pad(FILE* fptr, long* at)
+{
+    while (*at % RE_DB_ALIGN) {
+        fputc(0, fptr);
+        (*at)++;
+    }
+}
+
+static void
+re_dfa_u32s(FILE* fptr, long* at, int* vals, long count)
+{
+    for (long i = 0; i < count; ++i) {
+        uint32_t v = (uint32_t)vals[i];
+        fwrite(&v, sizeof(v), 1, fptr);
+    }
+    *at += count * 4;
+}
+
+/**
+ * @brief Write an automaton as a rule database, in the layout of db.h.
+ *
+ * @param dfa Automaton to write.
+ * @param names Name of every pattern.
+ * @param fptr File to write into, at its start.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if writing failed.
+ */
+int re_dfa_save(re_dfa* dfa, char** names, FILE* fptr)
+{
+    long at;
+    re_db_header h;
+    int* nameoffs;
+    uint32_t nstrings = 0;
+
+    nameoffs = (int*)malloc((dfa->npatterns + 1) * sizeof(int));
+    for (int i = 0; i < dfa->npatterns; ++i) {
+        nameoffs[i] = nstrings;
+        nstrings   += strlen(names[i]) + 1;
+    }
+
+#define RE_DB_NEXT(off, bytes) (((off) + (bytes) + RE_DB_ALIGN - 1) / RE_DB_ALIGN * RE_DB_ALIGN)
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, RE_DB_MAGIC, 4);
+    h.version   = RE_DB_VERSION;
+    h.order     = RE_DB_ORDER;
+    h.nstates   = dfa->nstates;
+    h.nclasses  = dfa->nclasses;
+    h.npatterns = dfa->npatterns;
+    h.start     = dfa->start;
+    h.nids      = dfa->nids;
+    h.nstrings  = nstrings;
+    h.classes   = RE_DB_NEXT(0, sizeof(h));
+    h.trans     = RE_DB_NEXT(h.classes, 256);
+    h.accepts   = RE_DB_NEXT(h.trans, (uint64_t)h.nstates * h.nclasses * 4);
+    h.ids       = RE_DB_NEXT(h.accepts, (h.nstates + 1) * 4);
+    h.names     = RE_DB_NEXT(h.ids, h.nids * 4);
+    h.strings   = RE_DB_NEXT(h.names, h.npatterns * 4);
+    h.size      = RE_DB_NEXT(h.strings, h.nstrings);
+#undef RE_DB_NEXT
+
+    at = 0;
+    fwrite(&h, sizeof(h), 1, fptr);
+    at += sizeof(h);
+    re_dfa_pad(fptr, &at);
+    fwrite(dfa->classes, 1, 256, fptr);
+    at += 256;
+    re_dfa_pad(fptr, &at);
+    re_dfa_u32s(fptr, &at, dfa->trans, (long)dfa->nstates * dfa->nclasses);
+    re_dfa_pad(fptr, &at);
+    re_dfa_u32s(fptr, &at, dfa->accepts, dfa->nstates + 1);
+    re_dfa_pad(fptr, &at);
+    re_dfa_u32s(fptr, &at, dfa->ids, dfa->nids);
+    re_dfa_pad(fptr, &at);
+    re_dfa_u32s(fptr, &at, nameoffs, dfa->npatterns);
+    re_dfa_pad(fptr, &at);
+    for (int i = 0; i < dfa->npatterns; ++i)
+        fwrite(names[i], 1, strlen(names[i]) + 1, fptr);
+    at += nstrings;
+    re_dfa_pad(fptr, &at);
+
+    free(nameoffs);
+    return ferror(fptr) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+static void
+re_dfa_indent(m_buffer* out, int space)
+{
+    m_buffer_pad(out, space * 4);
+}
+
+static void
+re_dfa_array(m_buffer* out, int space, const char* type, const char* name, int align, unsigned* vals, long count)
+{
+    re_dfa_indent(out, space);
+    if (align)
+        m_buffer_printf(out, "static const _Alignas(%d) %s %s[%ld] = {", align, type, name, count);
+    else
+        m_buffer_printf(out, "static const %s %s[%ld] = {", type, name, count);
+    for (long i = 0; i < count; ++i) {
+        if (i % 16 == 0) {
+            m_buffer_putc(out, '\n');
+            re_dfa_indent(out, space + 1);
+        }
+        m_buffer_putu(out, vals[i]);
+        if (i + 1 < count)
+            m_buffer_puts(out, i % 16 == 15 ? "," : ", ");
+    }
+    m_buffer_putc(out, '\n');
+    re_dfa_indent(out, space);
+    m_buffer_puts(out, "};\n");
+}
+
+/**
+ * @brief Write the body of a matcher that runs an automaton from tables.
+ * Only the first pattern is looked at, and since a match only needs some
+ * prefix, every accepting state is merged into one the matcher stops in.
+ *
+ * The live states are numbered first and premultiplied by the row stride,
+ * so the next state is one load away and the loop ends on a single
+ * compare: dead and accepting come right after the last live row. Rows
+ * shorter than a cache line are padded to a power of two bytes, longer
+ * ones to whole lines, so no row straddles two lines; ids take the
+ * narrowest unsigned type that holds them.
+ *
+ * @param dfa Automaton to write.
+ * @param out Buffer to write into.
+ * @param space Indentation level of the code, in steps of four spaces.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the states do not fit in 32 bits.
+ */
+int re_dfa_emit(re_dfa* dfa, m_buffer* out, int space)
+{
+    int nlive = 0;
+    int width, stride;
+    int* order;
+    int* number;
+    unsigned* vals;
+    unsigned dead, accept;
+    static const char* types[] = { NULL, "unsigned char", "unsigned short", NULL, "unsigned int" };
+
+#define re_dfa_accepting(st) (dfa->accepts[(st) + 1] > dfa->accepts[(st)])
+
+    /* the states the matcher can be in while still running */
+    number = (int*)malloc(dfa->nstates * sizeof(int));
+    order  = (int*)malloc(dfa->nstates * sizeof(int));
+    for (int i = 0; i < dfa->nstates; ++i)
+        number[i] = -1;
+    if (dfa->start != 0 && !re_dfa_accepting(dfa->start)) {
+        number[dfa->start] = 0;
+        order[nlive++]     = dfa->start;
+    }
+    for (int i = 0; i < nlive; ++i) {
+        for (int c = 0; c < dfa->nclasses; ++c) {
+            int next = dfa->trans[order[i] * dfa->nclasses + c];
+            if (next != 0 && !re_dfa_accepting(next) && number[next] == -1) {
+                number[next]   = nlive;
+                order[nlive++] = next;
+            }
+        }
+    }
+
+    if (nlive == 0) {
+        re_dfa_indent(out, space);
+        m_buffer_printf(out, "save_bool(%s);\n", dfa->start != 0 ? "true" : "false");
+        free(number);
+        free(order);
+        return EXIT_SUCCESS;
+    }
+
+    for (width = 1; width <= 4; width *= 2) {
+        uint64_t limit = width == 4 ? 0xFFFFFFFFu : (1u << (width * 8)) - 1;
+
+        if (dfa->nclasses * width <= 64)
+            for (stride = 1; stride < dfa->nclasses || 64 % (stride * width); stride *= 2);
+        else stride = (dfa->nclasses * width + 63) / 64 * 64 / width;
+        if ((uint64_t)(nlive + 1) * stride <= limit)
+            break;
+    }
+    if (width > 4) {
+        free(number);
+        free(order);
+        return EXIT_FAILURE;
+    }
+
+    dead   = nlive * stride;
+    accept = dead + stride;
+
+    re_dfa_indent(out, space);
+    m_buffer_puts(out, "{\n");
+    re_dfa_indent(out, space + 1);
+    m_buffer_printf(out, "/* %d states over %d byte classes, %d byte rows */\n", nlive, dfa->nclasses, stride * width);
+
+    vals = (unsigned*)malloc(((size_t)nlive * stride > 256 ? (size_t)nlive * stride : 256) * sizeof(unsigned));
+    for (int c = 0; c < 256; ++c)
+        vals[c] = dfa->classes[c];
+    re_dfa_array(out, space + 1, "unsigned char", "re_classes", 0, vals, 256);
+
+    for (int i = 0; i < nlive; ++i) {
+        for (int c = 0; c < stride; ++c) {
+            int next = c < dfa->nclasses ? dfa->trans[order[i] * dfa->nclasses + c] : 0;
+            vals[i * stride + c] = next == 0 ? dead : re_dfa_accepting(next) ? accept : (unsigned)number[next] * stride;
+        }
+    }
+    re_dfa_array(out, space + 1, types[width], "re_trans", 64, vals, (long)nlive * stride);
+
+    /* a NUL leads every live state to the dead one, so the loop needs no other test */
+    re_dfa_indent(out, space + 1);
+    m_buffer_puts(out, "const unsigned char* re_at = (const unsigned char*)re_string;\n");
+    re_dfa_indent(out, space + 1);
+    m_buffer_printf(out, "%s re_state = 0;\n", types[width]);
+    re_dfa_indent(out, space + 1);
+    m_buffer_printf(out, "while (re_state < %uu)\n", dead);
+    re_dfa_indent(out, space + 2);
+    m_buffer_puts(out, "re_state = re_trans[re_state + re_classes[*re_at++]];\n");
+    re_dfa_indent(out, space + 1);
+    m_buffer_printf(out, "save_bool(re_state == %uu);\n", accept);
+    re_dfa_indent(out, space);
+    m_buffer_puts(out, "}\n");
+
+#undef re_dfa_accepting
+
+    free(vals);
+    free(number);
+    free(order);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Free an automaton.
+ *
+ * @param dfa Automaton to free.
+ */
+void re_dfa_free(re_dfa* dfa)
+{
+    free(dfa->trans);
+    free(dfa->accepts);
+    free(dfa->ids);
+    free(dfa);
+}
@@ -0,0 +1,53 @@
+#ifndef DFA_H
+#define DFA_H
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../../regexer.h"
+
+/* states a construction may create before it gives up */
+#define RE_DFA_MAX_STATES 65536
+
+/* most strings re_dfa_match_many advances together */
+#define RE_DFA_MAX_LANES 8
+
+/* modes for re_dfa_compile */
+#define RE_DFA_REVERSE  0x01                    // Patterns read back to front
+#define RE_DFA_LEFTMOST 0x02                    // Unanchored, leftmost longest
+#define RE_DFA_ANYWHERE 0x04                    // Unanchored, accepting every match end
+
+/**
+ * A deterministic automaton over one or more patterns. Unlike re_conv,
+ * it gives patterns their usual regular meaning: choices and loops are
+ * not committed to, so a|ab and (a|ab)c match whatever the regular
+ * language holds. A pattern matches when some prefix of the input is in
+ * its language. State 0 is dead, and stays so on every byte.
+ */
+typedef struct
+re_dfa
+{
+    int nstates;                                // States, the dead one included
+    int nclasses;                               // Byte classes, the row width of trans
+    int npatterns;                              // Patterns, numbered from 0
+    int start;                                  // State matching begins in
+    unsigned char classes[256];                 // Class of every byte
+    int* trans;                                 // Next state, row per state
+    int* accepts;                               // nstates + 1 offsets into ids
+    int* ids;                                   // Patterns each state accepts
+    int nids;                                   // Length of ids
+}
+re_dfa;
+
+re_dfa* re_dfa_build(re_exp** pats, int count, int maxstates);
+re_dfa* re_dfa_compile(re_exp** pats, int count, int maxstates, int flags);
+bool re_dfa_match(re_dfa* dfa, const char* str);
+void re_dfa_match_many(re_dfa* dfa, const char** strs, size_t count, bool* out, int lanes);
+int re_dfa_save(re_dfa* dfa, char** names, FILE* fptr);
+int re_dfa_emit(re_dfa* dfa, m_buffer* out, int space);
+void re_dfa_free(re_dfa* dfa);
+
+#endif
@@ -0,0 +1,290 @@
+#include "jit.h"
+#include "../../types/stack/stack.h"
+
+#if RE_JIT_NATIVE
+#include <sys/mman.h>
+
+/**
+ * register use in the generated code:
+ *   rbx  current input position
+ *   rbp  native stack pointer on entry, where the choice stack starts
+ *   rsp  top of the choice stack; each entry is a position and the
+ *        address to resume at, pushed in that order
+ *   rax  scratch
+ */
+
+typedef struct
+re_asm
+{
+    m_stack bytes;                              // Machine code emitted so far
+    m_stack fixes;                              // Displacements waiting for a target
+    int* addr;                                  // Code offset of every instruction
+    int fail;                                   // Offset of the shared failure path
+    int done;                                   // Offset of the epilogue
+}
+re_asm;
+
+typedef struct
+re_fix
+{
+    int at;                                     // Offset of the rel32 to patch
+    int kind;                                   // What target refers to
+    int target;                                 // Instruction, bitmap or offset
+}
+re_fix;
+
+enum { RE_FIX_INST, RE_FIX_SET, RE_FIX_OFFSET };
+
+static void
+re_asm_bytes(re_asm* a, const unsigned char* bytes, int count)
+{
+    for (int i = 0; i < count; ++i)
+        m_stack_push(&a->bytes, (void*)&bytes[i]);
+}
+
+#define re_asm_emit(a, ...) re_asm_bytes((a), (const unsigned char[]){ __VA_ARGS__ }, sizeof((const unsigned char[]){ __VA_ARGS__ }))
+
+static void
+re_asm_u32(re_asm* a, unsigned int v)
+{
+    re_asm_emit(a, v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >> 24) & 0xff);
+}
+
+/* a rel32 to be filled in once every offset is known */
+static void
+re_asm_rel(re_asm* a, int kind, int target)
+{
+    re_fix fix = { .at = a->bytes.count, .kind = kind, .target = target };
+
+    m_stack_push(&a->fixes, &fix);
+    re_asm_u32(a, 0);
+}
+
+static void
+re_asm_fail_if(re_asm* a, unsigned char cc)
+{
+    re_asm_emit(a, 0x0f, cc);
+    re_asm_rel(a, RE_FIX_OFFSET, -1);
+}
+
+static void
+re_asm_inst(re_asm* a, re_prog* prog, int pc)
+{
+    re_inst* in = prog->code + pc;
+
+    switch (in->op)
+    {
+        case RE_OP_CHAR:
+            re_asm_emit(a, 0x80, 0x3b, in->arg);        /* cmp byte [rbx], c */
+            re_asm_fail_if(a, 0x85);                    /* jne fail */
+            re_asm_emit(a, 0x48, 0xff, 0xc3);           /* inc rbx */
+            break;
+
+        case RE_OP_ANY:
+            re_asm_emit(a, 0x80, 0x3b, 0x00);           /* cmp byte [rbx], 0 */
+            re_asm_fail_if(a, 0x84);                    /* je fail */
+            re_asm_emit(a, 0x48, 0xff, 0xc3);           /* inc rbx */
+            break;
+
+        case RE_OP_SET:
+            re_asm_emit(a, 0x0f, 0xb6, 0x03);           /* movzx eax, byte [rbx] */
+            re_asm_emit(a, 0x0f, 0xa3, 0x05);           /* bt [rip+set], eax */
+            re_asm_rel(a, RE_FIX_SET, in->arg);
+            re_asm_fail_if(a, 0x83);                    /* jnc fail */
+            re_asm_emit(a, 0x48, 0xff, 0xc3);           /* inc rbx */
+            break;
+
+        case RE_OP_STR:
+            /* unrolled; a NUL in the input mismatches before anything is overread */
+            for (int i = 0; i < in->len; ++i) {
+                re_asm_emit(a, 0x80, 0xbb);             /* cmp byte [rbx+i], c */
+                re_asm_u32(a, i);
+                re_asm_emit(a, (unsigned char)prog->pool[in->arg + i]);
+                re_asm_fail_if(a, 0x85);                /* jne fail */
+            }
+            re_asm_emit(a, 0x48, 0x81, 0xc3);           /* add rbx, len */
+            re_asm_u32(a, in->len);
+            break;
+
+        case RE_OP_CHOICE:
+            re_asm_emit(a, 0x53);                       /* push rbx */
+            re_asm_emit(a, 0x48, 0x8d, 0x05);           /* lea rax, [rip+next] */
+            re_asm_rel(a, RE_FIX_INST, in->arg);
+            re_asm_emit(a, 0x50);                       /* push rax */
+            break;
+
+        case RE_OP_COMMIT:
+            re_asm_emit(a, 0x48, 0x83, 0xc4, 0x10);     /* add rsp, 16 */
+            re_asm_emit(a, 0xe9);                       /* jmp target */
+            re_asm_rel(a, RE_FIX_INST, in->arg);
+            break;
+
+        case RE_OP_LOOP:
+            re_asm_emit(a, 0x48, 0x3b, 0x5c, 0x24, 0x08); /* cmp rbx, [rsp+8] */
+            re_asm_emit(a, 0x74, 0x15);                 /* je leave */
+            re_asm_emit(a, 0x48, 0x89, 0x5c, 0x24, 0x08); /* mov [rsp+8], rbx */
+            re_asm_emit(a, 0x48, 0x8d, 0x05);           /* lea rax, [rip+next] */
+            re_asm_rel(a, RE_FIX_INST, pc + 1);
+            re_asm_emit(a, 0x48, 0x89, 0x04, 0x24);     /* mov [rsp], rax */
+            re_asm_emit(a, 0xe9);                       /* jmp start */
+            re_asm_rel(a, RE_FIX_INST, in->arg);
+            re_asm_emit(a, 0x48, 0x83, 0xc4, 0x10);     /* leave: add rsp, 16 */
+            break;
+
+        case RE_OP_JMP:
+            re_asm_emit(a, 0xe9);
+            re_asm_rel(a, RE_FIX_INST, in->arg);
+            break;
+
+        case RE_OP_FAIL:
+            re_asm_emit(a, 0xe9);
+            re_asm_rel(a, RE_FIX_OFFSET, -1);
+            break;
+
+        case RE_OP_MATCH:
+            re_asm_emit(a, 0xb8, 0x01, 0x00, 0x00, 0x00); /* mov eax, 1 */
+            re_asm_emit(a, 0xe9);                       /* jmp done */
+            re_asm_rel(a, RE_FIX_OFFSET, -2);
+            break;
+    }
+}
+
+/* lay out the code, then patch every displacement */
+static bool
+re_jit_assemble(re_jit* jit, re_prog* prog)
+{
+    re_asm a;
+    int sets;
+    unsigned char* buf;
+
+    a.bytes = m_stack_init(unsigned char);
+    a.fixes = m_stack_init(re_fix);
+    a.addr  = (int*)malloc((prog->count + 1) * sizeof(int));
+
+    re_asm_emit(&a, 0x53);                              /* push rbx */
+    re_asm_emit(&a, 0x55);                              /* push rbp */
+    re_asm_emit(&a, 0x48, 0x89, 0xfb);                  /* mov rbx, rdi */
+    re_asm_emit(&a, 0x48, 0x89, 0xe5);                  /* mov rbp, rsp */
+
+    for (int pc = 0; pc < prog->count; ++pc) {
+        a.addr[pc] = a.bytes.count;
+        re_asm_inst(&a, prog, pc);
+    }
+    a.addr[prog->count] = a.bytes.count;
+
+    /* fail: resume at the last choice, or give up when there is none */
+    a.fail = a.bytes.count;
+    re_asm_emit(&a, 0x48, 0x39, 0xec);                  /* cmp rsp, rbp */
+    re_asm_emit(&a, 0x74, 0x04);                        /* je nomatch */
+    re_asm_emit(&a, 0x58);                              /* pop rax */
+    re_asm_emit(&a, 0x5b);                              /* pop rbx */
+    re_asm_emit(&a, 0xff, 0xe0);                        /* jmp rax */
+    re_asm_emit(&a, 0x31, 0xc0);                        /* nomatch: xor eax, eax */
+
+    a.done = a.bytes.count;
+    re_asm_emit(&a, 0x48, 0x89, 0xec);                  /* mov rsp, rbp */
+    re_asm_emit(&a, 0x5d);                              /* pop rbp */
+    re_asm_emit(&a, 0x5b);                              /* pop rbx */
+    re_asm_emit(&a, 0xc3);                              /* ret */
+
+    /* the bitmaps follow the code */
+    while (a.bytes.count % 16)
+        re_asm_emit(&a, 0xcc);
+    sets = a.bytes.count;
+    re_asm_bytes(&a, prog->sets, prog->nsets * RE_SET_BYTES);
+
+    buf = (unsigned char*)a.bytes.content;
+    for (int i = 0; i < a.fixes.count; ++i) {
+        re_fix* fix = (re_fix*)a.fixes.content + i;
+        int to;
+
+        switch (fix->kind) {
+            case RE_FIX_INST:   to = a.addr[fix->target]; break;
+            case RE_FIX_SET:    to = sets + fix->target * RE_SET_BYTES; break;
+            default:            to = fix->target == -1 ? a.fail : a.done; break;
+        }
+
+        /* relative to the end of the displacement, which ends every instruction using one */
+        int rel = to - (fix->at + 4);
+        memcpy(buf + fix->at, &rel, 4);
+    }
+
+    jit->size = a.bytes.count;
+    jit->code = mmap(NULL, jit->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (jit->code != MAP_FAILED) {
+        memcpy(jit->code, buf, jit->size);
+        if (mprotect(jit->code, jit->size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(jit->code, jit->size);
+            jit->code = MAP_FAILED;
+        }
+    }
+
+    free(a.bytes.content);
+    free(a.fixes.content);
+    free(a.addr);
+
+    if (jit->code == MAP_FAILED) {
+        jit->code = NULL;
+        return false;
+    }
+
+    jit->fn = (int (*)(const char*))jit->code;
+    return true;
+}
+#endif
+
+/**
+ * @brief Compile a program to machine code for this host.
+ *
+ * @param prog Program to compile; it must outlive the result.
+ * @return A matcher, which falls back to the bytecode vm when the host has
+ * no code generator or executable memory could not be mapped.
+ */
+re_jit* re_jit_compile(re_prog* prog)
+{
+    re_jit* jit = (re_jit*)malloc(sizeof(re_jit));
+
+    jit->prog = prog;
+    jit->vm   = NULL;
+    jit->code = NULL;
+    jit->size = 0;
+    jit->fn   = NULL;
+
+#if RE_JIT_NATIVE
+    if (re_jit_assemble(jit, prog))
+        return jit;
+#endif
+
+    jit->vm = re_vm_compile(prog);
+    return jit;
+}
+
+/**
+ * @brief Match a string.
+ *
+ * @param jit Matcher to run.
+ * @param str NUL terminated input; a match must start at its first byte.
+ * @return Whether some prefix of the input matches.
+ */
+bool re_jit_match(re_jit* jit, char* str)
+{
+    if (jit->fn)
+        return jit->fn(str) != 0;
+    return re_vm_run(jit->vm, str);
+}
+
+/**
+ * @brief Free a matcher, but not the program it was compiled from.
+ *
+ * @param jit Matcher to free.
+ */
+void re_jit_free(re_jit* jit)
+{
+#if RE_JIT_NATIVE
+    if (jit->code)
+        munmap(jit->code, jit->size);
+#endif
+    if (jit->vm)
+        re_vm_free(jit->vm);
+    free(jit);
+}
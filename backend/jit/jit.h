@@ -0,0 +1,35 @@
+#ifndef JIT_H
+#define JIT_H
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../prog/prog.h"
+#include "../vm/vm.h"
+
+/* machine code is only generated for x86-64 hosts with mmap */
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(RE_JIT_DISABLE)
+#define RE_JIT_NATIVE 1
+#else
+#define RE_JIT_NATIVE 0
+#endif
+
+typedef struct
+re_jit
+{
+    re_prog* prog;                              // Program compiled
+    re_vm* vm;                                  // Bytecode run when fn is NULL
+    void* code;                                 // Executable mapping
+    size_t size;                                // Length of the mapping
+    int (*fn)(const char*);                     // Entry point, NULL when interpreting
+}
+re_jit;
+
+re_jit* re_jit_compile(re_prog* prog);
+bool re_jit_match(re_jit* jit, char* str);
+void re_jit_free(re_jit* jit);
+
+#endif
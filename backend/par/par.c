@@ -0,0 +1,367 @@
+#include "par.h"
+
+#include <stdatomic.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#include <windows.h>
+#endif
+
+/* bytes run between looks at whether the chunk is still wanted */
+#define RE_PAR_BLOCK 65536
+
+typedef struct
+re_par_chunk
+{
+    re_dfa* dfa;                                // Automaton to run
+    const unsigned char* acc;                   // Whether each state accepts
+    const unsigned char* text;                  // First byte of the chunk
+    size_t len;                                 // Length of the chunk
+    int index;                                  // Place among the chunks
+    bool known;                                 // Run from the start state only
+    bool first;                                 // Stop at the first accept that settles the answer
+    atomic_int* stop;                           // Chunks after this one are not wanted
+    int* end;                                   // State each origin ends in
+    size_t* count;                              // Accepts each origin sees
+}
+re_par_chunk;
+
+/**
+ * @brief Number of threads the machine can run at once.
+ *
+ * @return Processors online, at least 1.
+ */
+int re_par_threads(void)
+{
+#ifndef _WIN32
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#else
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+#endif
+}
+
+/* record that no chunk after index is wanted */
+static void
+re_par_settle(atomic_int* stop, int index)
+{
+    int cur = atomic_load_explicit(stop, memory_order_relaxed);
+    while (index < cur && !atomic_compare_exchange_weak(stop, &cur, index))
+        ;
+}
+
+/**
+ * run a chunk from each of its origins. Paths that reach the same state
+ * are merged, the later one remembering how many more accepts it had, so
+ * the work per byte shrinks to the number of states still apart.
+ */
+static void
+re_par_chunk_run(re_par_chunk* ch)
+{
+    re_dfa* dfa  = ch->dfa;
+    int stride   = dfa->nclasses;
+    int npaths   = ch->known ? 1 : dfa->nstates - 1;
+    int nlive    = npaths;
+    int nmerged  = 0;
+    size_t i     = 0;
+
+    int* cur       = (int*)malloc(npaths * sizeof(int));
+    int* live      = (int*)malloc(npaths * sizeof(int));
+    int* parent    = (int*)malloc(npaths * sizeof(int));
+    int* merged    = (int*)malloc(npaths * sizeof(int));
+    int* owner     = (int*)malloc(dfa->nstates * sizeof(int));
+    long long* cnt = (long long*)calloc(npaths, sizeof(long long));
+    long long* dif = (long long*)malloc(npaths * sizeof(long long));
+
+    /* path k begins in state k + 1; the dead state needs no path */
+    for (int k = 0; k < npaths; ++k) {
+        cur[k]  = ch->known ? dfa->start : k + 1;
+        live[k] = k;
+    }
+    for (int s = 0; s < dfa->nstates; ++s)
+        owner[s] = -1;
+
+    /* lockstep while paths are apart */
+    while (i < ch->len && nlive > 1)
+    {
+        int c = dfa->classes[ch->text[i++]];
+        int kept = 0;
+
+        for (int j = 0; j < nlive; ++j) {
+            int k  = live[j];
+            cur[k] = dfa->trans[cur[k] * stride + c];
+            cnt[k] += ch->acc[cur[k]];
+        }
+
+        for (int j = 0; j < nlive; ++j) {
+            int k = live[j];
+            int o = owner[cur[k]];
+            if (o < 0) {
+                owner[cur[k]] = k;
+                live[kept++]  = k;
+            } else {
+                parent[k] = o;
+                dif[k]    = cnt[k] - cnt[o];
+                merged[nmerged++] = k;
+            }
+        }
+        for (int j = 0; j < kept; ++j)
+            owner[cur[live[j]]] = -1;
+        nlive = kept;
+
+        if (ch->first && (i & (RE_PAR_BLOCK - 1)) == 0 && atomic_load_explicit(ch->stop, memory_order_relaxed) < ch->index)
+            goto out;
+    }
+
+    /* one path left: the plain loop */
+    if (nlive == 1)
+    {
+        int k = live[0];
+        int state = cur[k];
+        long long seen = cnt[k];
+        long long before = seen;
+
+        while (i < ch->len)
+        {
+            size_t stop = ch->len - i < RE_PAR_BLOCK ? ch->len : i + RE_PAR_BLOCK;
+            const unsigned char* p = ch->text + i;
+            const unsigned char* e = ch->text + stop;
+
+            while (p < e) {
+                state = dfa->trans[state * stride + dfa->classes[*p++]];
+                seen += ch->acc[state];
+            }
+            i = stop;
+
+            /* every origin has merged into this path, so an accept now counts for all */
+            if (ch->first && seen > before) {
+                re_par_settle(ch->stop, ch->index);
+                break;
+            }
+            if (ch->first && atomic_load_explicit(ch->stop, memory_order_relaxed) < ch->index)
+                break;
+        }
+
+        cur[k] = state;
+        cnt[k] = seen;
+    }
+
+out:
+    /* origins still apart hold their own results; merged ones add theirs to the path they joined */
+    for (int j = 0; j < nlive; ++j) {
+        int k = live[j];
+        int o = ch->known ? dfa->start : k + 1;
+        ch->end[o]   = cur[k];
+        ch->count[o] = (size_t)cnt[k];
+    }
+    for (int m = nmerged - 1; m >= 0; --m) {
+        int k = merged[m];
+        int o = k + 1;
+        int p = parent[k] + 1;
+        ch->end[o]   = ch->end[p];
+        ch->count[o] = (size_t)((long long)ch->count[p] + dif[k]);
+    }
+    ch->end[0]   = 0;
+    ch->count[0] = 0;
+
+    free(cur);
+    free(live);
+    free(parent);
+    free(merged);
+    free(owner);
+    free(cnt);
+    free(dif);
+}
+
+#ifndef _WIN32
+static void*
+re_par_thread(void* arg)
+{
+    re_par_chunk_run((re_par_chunk*)arg);
+    return NULL;
+}
+#else
+static DWORD WINAPI
+re_par_thread(LPVOID arg)
+{
+    re_par_chunk_run((re_par_chunk*)arg);
+    return 0;
+}
+#endif
+
+/**
+ * @brief Run an automaton over a text split across threads, counting the
+ * offsets at which it accepts.
+ *
+ * @param dfa Automaton to run, from its start state at offset 0.
+ * @param text Text to run over; NUL bytes are input like any other.
+ * @param len Length of text.
+ * @param nthreads Most threads to use, or 0 for one per processor.
+ * @param first Stop once it is known whether the automaton accepts at
+ * all, leaving count and state incomplete.
+ * @param res Where the counts and final state go.
+ */
+void re_par_run(re_dfa* dfa, const char* text, size_t len, int nthreads, bool first, re_par_result* res)
+{
+    int nchunks;
+    int state;
+    size_t size;
+    unsigned char* acc;
+    atomic_int stop;
+    re_par_chunk chunks[RE_PAR_MAX_THREADS];
+#ifndef _WIN32
+    pthread_t threads[RE_PAR_MAX_THREADS];
+#else
+    HANDLE threads[RE_PAR_MAX_THREADS];
+#endif
+    bool started[RE_PAR_MAX_THREADS];
+
+    if (nthreads <= 0)
+        nthreads = re_par_threads();
+    if (nthreads > RE_PAR_MAX_THREADS)
+        nthreads = RE_PAR_MAX_THREADS;
+    nchunks = len / RE_PAR_MIN_CHUNK < (size_t)nthreads ? (int)(len / RE_PAR_MIN_CHUNK) : nthreads;
+    if (nchunks < 1)
+        nchunks = 1;
+
+    res->state = dfa->start;
+    res->count = dfa->accepts[dfa->start + 1] > dfa->accepts[dfa->start];
+    res->any   = res->count > 0;
+    if (first && res->any)
+        return;
+
+    acc = (unsigned char*)malloc(dfa->nstates);
+    for (int s = 0; s < dfa->nstates; ++s)
+        acc[s] = dfa->accepts[s + 1] > dfa->accepts[s];
+
+    atomic_init(&stop, nchunks);
+    size = len / nchunks;
+    for (int c = 0; c < nchunks; ++c) {
+        re_par_chunk* ch = &chunks[c];
+        ch->dfa   = dfa;
+        ch->acc   = acc;
+        ch->text  = (const unsigned char*)text + c * size;
+        ch->len   = c == nchunks - 1 ? len - c * size : size;
+        ch->index = c;
+        ch->known = c == 0;
+        ch->first = first;
+        ch->stop  = &stop;
+        ch->end   = (int*)malloc(dfa->nstates * sizeof(int));
+        ch->count = (size_t*)malloc(dfa->nstates * sizeof(size_t));
+    }
+
+    /* the caller takes the first chunk; a thread that cannot start is run here after */
+    for (int c = 1; c < nchunks; ++c) {
+#ifndef _WIN32
+        started[c] = pthread_create(&threads[c], NULL, re_par_thread, &chunks[c]) == 0;
+#else
+        started[c] = (threads[c] = CreateThread(NULL, 0, re_par_thread, &chunks[c], 0, NULL)) != NULL;
+#endif
+    }
+    re_par_chunk_run(&chunks[0]);
+    if (first && chunks[0].count[dfa->start] > 0)
+        re_par_settle(&stop, 0);
+    for (int c = 1; c < nchunks; ++c) {
+        if (!started[c])
+            re_par_chunk_run(&chunks[c]);
+#ifndef _WIN32
+        else pthread_join(threads[c], NULL);
+#else
+        else {
+            WaitForSingleObject(threads[c], INFINITE);
+            CloseHandle(threads[c]);
+        }
+#endif
+    }
+
+    /* chain the maps: each chunk begins where the one before it ended */
+    state = dfa->start;
+    for (int c = 0; c < nchunks && !(first && res->count); ++c) {
+        res->count += chunks[c].count[state];
+        state = chunks[c].end[state];
+    }
+    res->any   = res->count > 0;
+    res->state = state;
+
+    for (int c = 0; c < nchunks; ++c) {
+        free(chunks[c].end);
+        free(chunks[c].count);
+    }
+    free(acc);
+}
+
+/**
+ * @brief Map a file for reading, so a large one is never copied.
+ *
+ * @param path File to map.
+ * @param len Where its length goes.
+ * @return The bytes of the file, or NULL with errno set when it could not
+ * be read. An empty file gives a non-NULL pointer and a length of 0.
+ */
+const char* re_par_map(const char* path, size_t* len)
+{
+    void* image;
+
+#ifndef _WIN32
+    int fd;
+    struct stat st;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        return NULL;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    *len  = (size_t)st.st_size;
+    image = *len ? mmap(NULL, *len, PROT_READ, MAP_PRIVATE, fd, 0) : (void*)"";
+    close(fd);
+    if (image == MAP_FAILED)
+        return NULL;
+#ifdef MADV_SEQUENTIAL
+    if (*len)
+        madvise(image, *len, MADV_SEQUENTIAL);
+#endif
+#else
+    FILE* fptr;
+
+    if ((fptr = fopen(path, "rb")) == NULL)
+        return NULL;
+    fseek(fptr, 0, SEEK_END);
+    *len = (size_t)ftell(fptr);
+    rewind(fptr);
+
+    image = malloc(*len ? *len : 1);
+    if (fread(image, 1, *len, fptr) != *len) {
+        fclose(fptr);
+        free(image);
+        return NULL;
+    }
+    fclose(fptr);
+#endif
+
+    return (const char*)image;
+}
+
+/**
+ * @brief Release a file mapped with re_par_map.
+ *
+ * @param text Bytes of the file.
+ * @param len Length of the file.
+ */
+void re_par_unmap(const char* text, size_t len)
+{
+#ifndef _WIN32
+    if (len)
+        munmap((void*)text, len);
+#else
+    free((void*)text);
+#endif
+}
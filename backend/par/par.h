@@ -0,0 +1,45 @@
+#ifndef PAR_H
+#define PAR_H
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../dfa/dfa.h"
+
+/* most chunks an input is cut into */
+#define RE_PAR_MAX_THREADS 64
+
+/* least bytes worth handing to a thread of its own */
+#define RE_PAR_MIN_CHUNK (1 << 16)
+
+/**
+ * Runs one automaton over one large input on several threads. The input
+ * is cut into a chunk per thread. The first chunk is run from the start
+ * state; the others are run from every state at once, since the state
+ * they begin in is not known until the chunks before them are done. The
+ * paths through a chunk soon meet, and a path stops being followed once
+ * it has met another, so most of a chunk is run over a single state.
+ * Each chunk ends with a map from the state it began in to the state it
+ * ended in and the accepts it saw, and the maps are chained in order.
+ *
+ * Built with RE_DFA_ANYWHERE, the accepts counted are the places in the
+ * input where a match ends.
+ */
+typedef struct
+re_par_result
+{
+    size_t count;                               // Offsets, 0 to len, the automaton accepted at
+    bool any;                                   // Whether it accepted anywhere
+    int state;                                  // State at the end, unless stopped early
+}
+re_par_result;
+
+int re_par_threads(void);
+void re_par_run(re_dfa* dfa, const char* text, size_t len, int nthreads, bool first, re_par_result* res);
+const char* re_par_map(const char* path, size_t* len);
+void re_par_unmap(const char* text, size_t len);
+
+#endif
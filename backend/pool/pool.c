@@ -0,0 +1,294 @@
+#include "pool.h"
+#include "../jit/jit.h"
+#include "../par/par.h"
+
+#include <stdatomic.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#else
+#include <windows.h>
+#endif
+
+/* strings looked at to guess how many make a batch */
+#define RE_POOL_SAMPLE 256
+
+typedef struct
+re_pool_share
+{
+    _Alignas(64) atomic_flag lock;              // Held while lo or hi change
+    size_t lo;                                  // First item not yet taken
+    size_t hi;                                  // One past the last item
+}
+re_pool_share;
+
+typedef struct
+re_pool_worker
+{
+    re_pool_task* task;                         // Work being done
+    re_pool_share* shares;                      // Every worker's share
+    int index;                                  // This worker's share
+    int nworkers;                               // Number of shares
+    size_t grain;                               // Items per batch
+}
+re_pool_worker;
+
+static void
+re_pool_lock(re_pool_share* sh)
+{
+    while (atomic_flag_test_and_set_explicit(&sh->lock, memory_order_acquire))
+        ;
+}
+
+static void
+re_pool_unlock(re_pool_share* sh)
+{
+    atomic_flag_clear_explicit(&sh->lock, memory_order_release);
+}
+
+/* take a batch from the front of a share; false when it is empty */
+static bool
+re_pool_take(re_pool_share* sh, size_t grain, size_t* lo, size_t* hi)
+{
+    bool got;
+
+    re_pool_lock(sh);
+    got = sh->lo < sh->hi;
+    if (got) {
+        *lo = sh->lo;
+        *hi = sh->hi - sh->lo > grain ? sh->lo + grain : sh->hi;
+        sh->lo = *hi;
+    }
+    re_pool_unlock(sh);
+    return got;
+}
+
+/* move the back half of the largest other share into this one */
+static bool
+re_pool_steal(re_pool_worker* w)
+{
+    for (;;)
+    {
+        int victim = -1;
+        size_t most = 0, lo, hi;
+        re_pool_share* sh;
+
+        for (int k = 1; k < w->nworkers; ++k) {
+            int v = (w->index + k) % w->nworkers;
+            re_pool_lock(&w->shares[v]);
+            if (w->shares[v].hi - w->shares[v].lo > most) {
+                most   = w->shares[v].hi - w->shares[v].lo;
+                victim = v;
+            }
+            re_pool_unlock(&w->shares[v]);
+        }
+        if (victim < 0)
+            return false;
+
+        sh = &w->shares[victim];
+        re_pool_lock(sh);
+        lo = sh->lo;
+        hi = sh->hi;
+        if (hi - lo > w->grain)
+            lo += (hi - lo) / 2;
+        sh->hi = lo;
+        re_pool_unlock(sh);
+
+        /* the share may have emptied since it was picked */
+        if (lo == hi)
+            continue;
+
+        sh = &w->shares[w->index];
+        re_pool_lock(sh);
+        sh->lo = lo;
+        sh->hi = hi;
+        re_pool_unlock(sh);
+        return true;
+    }
+}
+
+static void
+re_pool_work(re_pool_worker* w)
+{
+    size_t lo, hi;
+    void* ctx = w->task->open ? w->task->open(w->task->arg) : w->task->arg;
+
+    do {
+        while (re_pool_take(&w->shares[w->index], w->grain, &lo, &hi))
+            w->task->run(ctx, lo, hi);
+    } while (re_pool_steal(w));
+
+    if (w->task->close)
+        w->task->close(ctx);
+}
+
+#ifndef _WIN32
+static void*
+re_pool_thread(void* arg)
+{
+    re_pool_work((re_pool_worker*)arg);
+    return NULL;
+}
+#else
+static DWORD WINAPI
+re_pool_thread(LPVOID arg)
+{
+    re_pool_work((re_pool_worker*)arg);
+    return 0;
+}
+#endif
+
+/**
+ * @brief Run a task over count items on a pool of threads, returning once
+ * every item is done.
+ *
+ * @param task Work to do.
+ * @param count Number of items.
+ * @param grain Items per batch, at least 1.
+ * @param nthreads Most threads to use, or 0 for one per processor.
+ */
+void re_pool_run(re_pool_task* task, size_t count, size_t grain, int nthreads)
+{
+    int nworkers;
+    re_pool_share shares[RE_POOL_MAX_THREADS];
+    re_pool_worker workers[RE_POOL_MAX_THREADS];
+#ifndef _WIN32
+    pthread_t threads[RE_POOL_MAX_THREADS];
+#else
+    HANDLE threads[RE_POOL_MAX_THREADS];
+#endif
+    bool started[RE_POOL_MAX_THREADS];
+
+    if (grain < 1)
+        grain = 1;
+    if (nthreads <= 0)
+        nthreads = re_par_threads();
+    if (nthreads > RE_POOL_MAX_THREADS)
+        nthreads = RE_POOL_MAX_THREADS;
+
+    /* no more workers than there are batches */
+    nworkers = (count + grain - 1) / grain < (size_t)nthreads ? (int)((count + grain - 1) / grain) : nthreads;
+    if (nworkers < 1)
+        nworkers = 1;
+
+    for (int k = 0; k < nworkers; ++k) {
+        atomic_flag_clear(&shares[k].lock);
+        shares[k].lo = count / nworkers * k;
+        shares[k].hi = k == nworkers - 1 ? count : count / nworkers * (k + 1);
+
+        workers[k].task     = task;
+        workers[k].shares   = shares;
+        workers[k].index    = k;
+        workers[k].nworkers = nworkers;
+        workers[k].grain    = grain;
+    }
+
+    /* the caller is worker 0; a thread that cannot start leaves its share to be stolen */
+    for (int k = 1; k < nworkers; ++k) {
+#ifndef _WIN32
+        started[k] = pthread_create(&threads[k], NULL, re_pool_thread, &workers[k]) == 0;
+#else
+        started[k] = (threads[k] = CreateThread(NULL, 0, re_pool_thread, &workers[k], 0, NULL)) != NULL;
+#endif
+    }
+    re_pool_work(&workers[0]);
+    for (int k = 1; k < nworkers; ++k) {
+        if (!started[k])
+            continue;
+#ifndef _WIN32
+        pthread_join(threads[k], NULL);
+#else
+        WaitForSingleObject(threads[k], INFINITE);
+        CloseHandle(threads[k]);
+#endif
+    }
+}
+
+/**
+ * @brief Guess how many strings make a batch of about RE_POOL_BATCH_BYTES.
+ *
+ * @param strs Strings to be matched.
+ * @param count Number of strings.
+ * @return Strings per batch, at least 1.
+ */
+size_t re_pool_grain(const char** strs, size_t count)
+{
+    size_t seen  = count < RE_POOL_SAMPLE ? count : RE_POOL_SAMPLE;
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < seen; ++i)
+        bytes += strlen(strs[i]) + 1;
+    if (bytes == 0)
+        return 1;
+
+    return RE_POOL_BATCH_BYTES * seen / bytes > 0 ? RE_POOL_BATCH_BYTES * seen / bytes : 1;
+}
+
+typedef struct
+re_pool_job
+{
+    re_prog* prog;                              // Program every worker compiles
+    const char** strs;                          // Strings to match
+    bool* out;                                  // Result for each string
+}
+re_pool_job;
+
+typedef struct
+re_pool_matcher
+{
+    re_pool_job* job;                           // Work shared by the pool
+    re_jit* jit;                                // This worker's own matcher
+}
+re_pool_matcher;
+
+static void*
+re_pool_match_open(void* arg)
+{
+    re_pool_matcher* m = (re_pool_matcher*)malloc(sizeof(re_pool_matcher));
+
+    m->job = (re_pool_job*)arg;
+    m->jit = re_jit_compile(m->job->prog);
+    return m;
+}
+
+static void
+re_pool_match_run(void* ctx, size_t lo, size_t hi)
+{
+    re_pool_matcher* m = (re_pool_matcher*)ctx;
+
+    for (size_t i = lo; i < hi; ++i)
+        m->job->out[i] = re_jit_match(m->jit, (char*)m->job->strs[i]);
+}
+
+static void
+re_pool_match_close(void* ctx)
+{
+    re_pool_matcher* m = (re_pool_matcher*)ctx;
+
+    re_jit_free(m->jit);
+    free(m);
+}
+
+/**
+ * @brief Match many strings against one program on a pool of threads.
+ * Each worker compiles its own matcher from the program, which is only
+ * read.
+ *
+ * @param prog Program to match with.
+ * @param strs NUL terminated strings; matches start at their first byte.
+ * @param count Number of strings.
+ * @param nthreads Most threads to use, or 0 for one per processor.
+ * @param out Where each result goes, in the order of strs.
+ */
+void re_pool_match(re_prog* prog, const char** strs, size_t count, int nthreads, bool* out)
+{
+    re_pool_job job = { .prog = prog, .strs = strs, .out = out };
+    re_pool_task task = {
+        .open  = re_pool_match_open,
+        .run   = re_pool_match_run,
+        .close = re_pool_match_close,
+        .arg   = &job
+    };
+
+    re_pool_run(&task, count, re_pool_grain(strs, count), nthreads);
+}
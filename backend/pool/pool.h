@@ -0,0 +1,40 @@
+#ifndef POOL_H
+#define POOL_H
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../prog/prog.h"
+
+/* most workers a pool runs */
+#define RE_POOL_MAX_THREADS 64
+
+/* input a batch aims to cover, about a first-level data cache */
+#define RE_POOL_BATCH_BYTES 32768
+
+/**
+ * Work to spread over a pool. Items are numbered from 0 and handed out in
+ * batches of consecutive items. Every worker starts with an equal share
+ * and takes batches from the front of it; one that runs dry steals the
+ * back half of the largest share left. Each worker opens a context of its
+ * own before its first batch and closes it after its last, so nothing a
+ * batch writes to is shared but the results.
+ */
+typedef struct
+re_pool_task
+{
+    void* (*open)(void* arg);                   // Private context for a worker
+    void (*run)(void* ctx, size_t lo, size_t hi); // Handle items lo up to hi
+    void (*close)(void* ctx);                   // Release a context
+    void* arg;                                  // Passed to open
+}
+re_pool_task;
+
+void re_pool_run(re_pool_task* task, size_t count, size_t grain, int nthreads);
+size_t re_pool_grain(const char** strs, size_t count);
+void re_pool_match(re_prog* prog, const char** strs, size_t count, int nthreads, bool* out);
+
+#endif
@@ -0,0 +1,398 @@
+#include "prog.h"
+#include "../../types/stack/stack.h"
+
+typedef struct
+re_build
+{
+    m_stack code;                               // re_inst being emitted
+    m_stack sets;                               // Bitmaps, RE_SET_BYTES each
+    m_stack pool;                               // Literal bytes
+    int depth;                                  // Choices open at this point
+    int maxdepth;                               // Deepest it has been
+}
+re_build;
+
+typedef struct
+re_back
+{
+    char* pos;                                  // Input position to go back to
+    int   next;                                 // Instruction to resume at
+}
+re_back;
+
+#ifdef RE_COUNT_WORK
+_Thread_local re_prog_work re_prog_counters;
+#define re_prog_tally(field) (re_prog_counters.field++)
+#else
+#define re_prog_tally(field) ((void)0)
+#endif
+
+#define re_build_at(b, i) (((re_inst*)(b)->code.content) + (i))
+
+static int
+re_build_emit(re_build* b, int op, int arg, int len)
+{
+    m_stack_push(&b->code, &(re_inst) { .op = op, .arg = arg, .len = len });
+    return b->code.count - 1;
+}
+
+static void
+re_build_open(re_build* b)
+{
+    if (++b->depth > b->maxdepth)
+        b->maxdepth = b->depth;
+}
+
+static void re_build_exp(re_build* b, re_exp* re);
+
+static void
+re_build_seq(re_build* b, re_comp* comp)
+{
+    for (; comp; comp = comp->next)
+        re_build_exp(b, comp->elem);
+}
+
+/* add the bytes one class member admits to a bitmap */
+static void
+re_set_member(unsigned char* set, re_exp* re)
+{
+    int lo, hi;
+
+    switch (re->tag)
+    {
+        case char_exp:
+            lo = hi = (unsigned char)re->op.charExp;
+            break;
+
+        case range_exp:
+            lo = (unsigned char)re->op.rangeExp.min;
+            hi = (unsigned char)re->op.rangeExp.max;
+            break;
+
+        case dot_exp:
+            lo = 1;
+            hi = 255;
+            break;
+
+        default:
+            return;
+    }
+
+    for (int c = lo; c <= hi; ++c)
+        set[c >> 3] |= 1 << (c & 7);
+}
+
+/**
+ * @brief Fill a bitmap with the bytes a single-byte step accepts.
+ *
+ * @param set Bitmap of RE_SET_BYTES bytes, overwritten.
+ * @param re A char, range, dot or bracket step.
+ */
+void re_set_fill(unsigned char* set, re_exp* re)
+{
+    memset(set, 0, RE_SET_BYTES);
+
+    if (re->tag == select_exp) {
+        for (re_comp* iter = re->op.selectExp.select; iter; iter = iter->next)
+            re_set_member(set, iter->elem);
+        if (!re->op.selectExp.pos)
+            for (int i = 0; i < RE_SET_BYTES; ++i)
+                set[i] = ~set[i];
+    }
+    else re_set_member(set, re);
+
+    /* the end of input never matches a class */
+    set[0] &= ~1;
+}
+
+static int
+re_build_set(re_build* b, re_exp* re)
+{
+    unsigned char set[RE_SET_BYTES];
+
+    re_set_fill(set, re);
+    for (int i = 0; i < RE_SET_BYTES; ++i)
+        m_stack_push(&b->sets, &set[i]);
+    return b->sets.count / RE_SET_BYTES - 1;
+}
+
+static void
+re_build_str(re_build* b, char* str, int len)
+{
+    int off = b->pool.count;
+
+    for (int i = 0; i < len; ++i)
+        m_stack_push(&b->pool, &str[i]);
+    re_build_emit(b, RE_OP_STR, off, len);
+}
+
+static void
+re_build_exp(re_build* b, re_exp* re)
+{
+    int choice, jump, start;
+    re_comp* iter;
+    m_stack commits;
+
+    switch (re->tag)
+    {
+        case char_exp:
+            re_build_emit(b, RE_OP_CHAR, (unsigned char)re->op.charExp, 0);
+            break;
+
+        case dot_exp:
+            re_build_emit(b, RE_OP_ANY, 0, 0);
+            break;
+
+        case str_exp:
+            re_build_str(b, re->op.strExp.str, re->op.strExp.len);
+            break;
+
+        case range_exp:
+        case select_exp:
+            re_build_emit(b, RE_OP_SET, re_build_set(b, re), 0);
+            break;
+
+        case empty_exp:
+            break;
+
+        case plain_exp:
+            re_build_seq(b, re->op.plainExp);
+            break;
+
+        case opt_exp:
+            choice = re_build_emit(b, RE_OP_CHOICE, 0, 0);
+            re_build_open(b);
+            re_build_seq(b, re->op.optExp);
+            b->depth--;
+            jump = re_build_emit(b, RE_OP_COMMIT, 0, 0);
+            re_build_at(b, choice)->arg = b->code.count;
+            re_build_at(b, jump)->arg   = b->code.count;
+            break;
+
+        case kleene_exp:
+        case rep_exp:
+            /* the first failure of a+ fails it, later ones end the loop */
+            choice = re_build_emit(b, RE_OP_CHOICE, 0, 0);
+            start  = b->code.count;
+            re_build_open(b);
+            re_build_seq(b, re->op.kleeneExp);
+            b->depth--;
+            re_build_emit(b, RE_OP_LOOP, start, 0);
+            if (re->tag == rep_exp) {
+                jump = re_build_emit(b, RE_OP_JMP, 0, 0);
+                re_build_at(b, choice)->arg = b->code.count;
+                re_build_emit(b, RE_OP_FAIL, 0, 0);
+                re_build_at(b, jump)->arg = b->code.count;
+            }
+            else re_build_at(b, choice)->arg = b->code.count;
+            break;
+
+        case bar_exp:
+            if (!(re->op.barExp.left && re->op.barExp.right)) {
+                re_build_seq(b, re->op.barExp.left ? re->op.barExp.left : re->op.barExp.right);
+                break;
+            }
+            /* down the chain of alternatives, each but the last a choice */
+            commits = m_stack_init(int);
+            for (;; re = re->op.barExp.right->elem) {
+                choice = re_build_emit(b, RE_OP_CHOICE, 0, 0);
+                re_build_open(b);
+                re_build_seq(b, re->op.barExp.left);
+                b->depth--;
+                jump = re_build_emit(b, RE_OP_COMMIT, 0, 0);
+                m_stack_push(&commits, &jump);
+                re_build_at(b, choice)->arg = b->code.count;
+                if (!re_bar_chained(re->op.barExp.right))
+                    break;
+            }
+            re_build_seq(b, re->op.barExp.right);
+            for (int i = 0; i < commits.count; ++i)
+                re_build_at(b, ((int*)commits.content)[i])->arg = b->code.count;
+            free(commits.content);
+            break;
+
+        case trie_exp:
+            /* the alternatives in order, as a chain of choices */
+            commits = m_stack_init(int);
+            for (iter = re->op.trieExp; iter; iter = iter->next) {
+                if (iter->next) {
+                    choice = re_build_emit(b, RE_OP_CHOICE, 0, 0);
+                    re_build_open(b);
+                    re_build_exp(b, iter->elem);
+                    b->depth--;
+                    jump = re_build_emit(b, RE_OP_COMMIT, 0, 0);
+                    m_stack_push(&commits, &jump);
+                    re_build_at(b, choice)->arg = b->code.count;
+                }
+                else re_build_exp(b, iter->elem);
+            }
+            for (int i = 0; i < commits.count; ++i)
+                re_build_at(b, ((int*)commits.content)[i])->arg = b->code.count;
+            free(commits.content);
+            break;
+    }
+}
+
+/**
+ * @brief Lower a pattern tree into an instruction program.
+ *
+ * @param re Tree returned by the front end.
+ * @return A program with the same matching behaviour as re_conv's output.
+ */
+re_prog* re_prog_compile(re_exp* re)
+{
+    re_build b;
+    re_prog* prog;
+
+    b.code     = m_stack_init(re_inst);
+    b.sets     = m_stack_init(unsigned char);
+    b.pool     = m_stack_init(char);
+    b.depth    = 0;
+    b.maxdepth = 0;
+
+    re_build_exp(&b, re);
+    re_build_emit(&b, RE_OP_MATCH, 0, 0);
+
+    prog = (re_prog*)malloc(sizeof(re_prog));
+    prog->code     = (re_inst*)b.code.content;
+    prog->count    = b.code.count;
+    prog->sets     = (unsigned char*)b.sets.content;
+    prog->nsets    = b.sets.count / RE_SET_BYTES;
+    prog->pool     = (char*)b.pool.content;
+    prog->poolsize = b.pool.count;
+    prog->depth    = b.maxdepth;
+
+    return prog;
+}
+
+/**
+ * @brief Run a program over a string, the way the generated code would.
+ *
+ * @param prog Program to run.
+ * @param str NUL terminated input; a match must start at its first byte.
+ * @return Whether some prefix of the input matches.
+ */
+bool re_prog_run(re_prog* prog, char* str)
+{
+    int pc    = 0;
+    int top   = 0;
+    char* pos = str;
+    re_back back[prog->depth + 1];
+
+    for (;;)
+    {
+        re_inst* in = prog->code + pc;
+
+#ifdef RE_COUNT_WORK
+        re_prog_counters.steps++;
+        if (re_prog_counters.hits)
+            re_prog_counters.hits[pc]++;
+#endif
+
+        switch (in->op)
+        {
+            case RE_OP_CHAR:
+                if ((unsigned char)*pos != in->arg)
+                    goto fail;
+                pos++, pc++;
+                break;
+
+            case RE_OP_ANY:
+                if (*pos == '\0')
+                    goto fail;
+                pos++, pc++;
+                break;
+
+            case RE_OP_SET:
+                if (!re_set_has(re_prog_set(prog, in->arg), *pos))
+                    goto fail;
+                pos++, pc++;
+                break;
+
+            case RE_OP_STR:
+                if (strncmp(pos, prog->pool + in->arg, in->len))
+                    goto fail;
+                pos += in->len, pc++;
+                break;
+
+            case RE_OP_CHOICE:
+                back[top++] = (re_back) { .pos = pos, .next = in->arg };
+                re_prog_tally(saves);
+                pc++;
+                break;
+
+            case RE_OP_COMMIT:
+                top--;
+                pc = in->arg;
+                break;
+
+            case RE_OP_LOOP:
+                /* a pass that consumed nothing would repeat forever */
+                if (back[top-1].pos == pos) {
+                    top--;
+                    pc++;
+                } else {
+                    back[top-1] = (re_back) { .pos = pos, .next = pc + 1 };
+                    pc = in->arg;
+                }
+                break;
+
+            case RE_OP_JMP:
+                pc = in->arg;
+                break;
+
+            case RE_OP_FAIL:
+                goto fail;
+
+            case RE_OP_MATCH:
+                return true;
+        }
+        continue;
+
+    fail:
+        if (top == 0)
+            return false;
+        re_prog_tally(backtracks);
+        top--;
+        pos = back[top].pos;
+        pc  = back[top].next;
+    }
+}
+
+/**
+ * @brief Print a program, one instruction per line.
+ *
+ * @param prog Program to print.
+ * @param fptr File to print into.
+ */
+void re_prog_print(re_prog* prog, FILE* fptr)
+{
+    static const char* names[] = {
+        "char", "any", "set", "str", "choice", "commit", "loop", "jmp", "fail", "match"
+    };
+
+    for (int i = 0; i < prog->count; ++i) {
+        re_inst* in = prog->code + i;
+        fprintf(fptr, "%4d  %-7s", i, names[in->op]);
+        if (in->op == RE_OP_CHAR)
+            fprintf(fptr, isprint(in->arg) ? "'%c'" : "0x%02x", in->arg);
+        else if (in->op == RE_OP_STR)
+            fprintf(fptr, "\"%.*s\"", in->len, prog->pool + in->arg);
+        else if (in->op != RE_OP_ANY && in->op != RE_OP_FAIL && in->op != RE_OP_MATCH)
+            fprintf(fptr, "%d", in->arg);
+        fputc('\n', fptr);
+    }
+}
+
+/**
+ * @brief Free a program.
+ *
+ * @param prog Program to free.
+ */
+void re_prog_free(re_prog* prog)
+{
+    free(prog->code);
+    free(prog->sets);
+    free(prog->pool);
+    free(prog);
+}
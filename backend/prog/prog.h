@@ -0,0 +1,87 @@
+#ifndef PROG_H
+#define PROG_H
+#pragma once
+
+#include <stdio.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../../regexer.h"
+
+/**
+ * The instruction set mirrors what re_conv emits: steps either consume
+ * input or fail, choices save a position and an alternative to resume at,
+ * and a commit throws the saved alternative away once a branch succeeds.
+ */
+typedef enum
+re_op
+{
+    RE_OP_CHAR,                                 // Match the byte in arg
+    RE_OP_ANY,                                  // Match any byte but the end of input
+    RE_OP_SET,                                  // Match a byte in bitmap number arg
+    RE_OP_STR,                                  // Match len bytes of the pool, from arg
+    RE_OP_CHOICE,                               // Save the position, resuming at arg on failure
+    RE_OP_COMMIT,                               // Drop the saved choice and jump to arg
+    RE_OP_LOOP,                                 // Repeat from arg, or leave if nothing was consumed
+    RE_OP_JMP,                                  // Jump to arg
+    RE_OP_FAIL,                                 // Resume at the last saved choice
+    RE_OP_MATCH                                 // The pattern matched
+}
+re_op;
+
+typedef struct
+re_inst
+{
+    int op;                                     // One of re_op
+    int arg;                                    // Byte, bitmap, pool offset or target
+    int len;                                    // Literal length for RE_OP_STR
+}
+re_inst;
+
+typedef struct
+re_prog
+{
+    re_inst* code;                              // Instructions, entered at the first
+    int count;                                  // Number of instructions
+    unsigned char* sets;                        // 32-byte bitmaps, the NUL bit never set
+    int nsets;                                  // Number of bitmaps
+    char* pool;                                 // Bytes of every literal
+    int poolsize;                               // Length of the pool
+    int depth;                                  // Most choices ever saved at once
+}
+re_prog;
+
+/**
+ * Work done by re_prog_run, kept only when built with RE_COUNT_WORK so
+ * the plain matcher pays nothing for it. The program makes the choices
+ * the generated code makes, so these are the backtracks re_conv's output
+ * would take on the same input. With hits set, the instruction at each
+ * pc adds to hits[pc] whenever it runs.
+ */
+typedef struct
+re_prog_work
+{
+    size_t steps;                               // Instructions run
+    size_t saves;                               // Choices saved
+    size_t backtracks;                          // Returns to a saved choice
+    unsigned* hits;                             // Runs per instruction, or NULL
+}
+re_prog_work;
+
+#ifdef RE_COUNT_WORK
+extern _Thread_local re_prog_work re_prog_counters;
+#endif
+
+#define RE_SET_BYTES 32
+#define re_prog_set(prog, n) ((prog)->sets + (n) * RE_SET_BYTES)
+#define re_set_has(set, c) (((set)[(unsigned char)(c) >> 3] >> ((unsigned char)(c) & 7)) & 1)
+
+void re_set_fill(unsigned char* set, re_exp* re);
+re_prog* re_prog_compile(re_exp* re);
+bool re_prog_run(re_prog* prog, char* str);
+void re_prog_print(re_prog* prog, FILE* fptr);
+void re_prog_free(re_prog* prog);
+
+#endif
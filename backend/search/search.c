@@ -0,0 +1,250 @@
+#include "search.h"
+#include "../../types/stack/stack.h"
+
+#define re_dfa_accepting(dfa, st) ((dfa)->accepts[(st) + 1] > (dfa)->accepts[(st)])
+#define re_dfa_step(dfa, st, c) ((dfa)->trans[(st) * (dfa)->nclasses + (dfa)->classes[(unsigned char)(c)]])
+
+#ifdef RE_COUNT_WORK
+_Thread_local re_search_work re_search_counters;
+#define re_search_tally(field) (re_search_counters.field++)
+#else
+#define re_search_tally(field) ((void)0)
+#endif
+
+static int re_search_seq(re_comp* comp, char* rev, int cap, bool* exact);
+
+/**
+ * the literal every string of a tree ends with, written last byte first
+ * into rev; exact is set when the tree matches nothing but that literal.
+ */
+static int
+re_search_tail(re_exp* re, char* rev, int cap, bool* exact)
+{
+    int len, len2;
+    bool ex2;
+    char other[RE_SEARCH_SUFFIX];
+    re_comp* iter;
+
+    *exact = false;
+    switch (re->tag)
+    {
+        case char_exp:
+            *exact = cap > 0;
+            if (cap > 0) rev[0] = re->op.charExp;
+            return cap > 0;
+
+        case str_exp:
+            len = re->op.strExp.len < cap ? re->op.strExp.len : cap;
+            for (int i = 0; i < len; ++i)
+                rev[i] = re->op.strExp.str[re->op.strExp.len - 1 - i];
+            *exact = len == re->op.strExp.len;
+            return len;
+
+        case select_exp:
+            iter = re->op.selectExp.select;
+            if (re->op.selectExp.pos && iter && !iter->next && iter->elem->tag == char_exp)
+                return re_search_tail(iter->elem, rev, cap, exact);
+            return 0;
+
+        case empty_exp:
+            *exact = true;
+            return 0;
+
+        case plain_exp:
+            return re_search_seq(re->op.plainExp, rev, cap, exact);
+
+        case rep_exp:
+            /* the last pass of the body ends every match */
+            return re_search_seq(re->op.repExp, rev, cap, &ex2);
+
+        case bar_exp:
+            if (!(re->op.barExp.left && re->op.barExp.right))
+                return re_search_seq(re->op.barExp.left ? re->op.barExp.left : re->op.barExp.right, rev, cap, exact);
+            /* alternatives share the tail they have in common, taken down the chain */
+            len = re_search_seq(re->op.barExp.left, rev, cap, exact);
+            for (;;) {
+                bool more = re_bar_chained(re->op.barExp.right);
+                len2 = re_search_seq(more ? re->op.barExp.right->elem->op.barExp.left : re->op.barExp.right, other, cap, &ex2);
+                *exact = *exact && ex2 && len2 == len && !memcmp(rev, other, len);
+                for (int i = 0; i < len; ++i)
+                    if (i >= len2 || rev[i] != other[i])
+                        len = i;
+                if (!more)
+                    return len;
+                re = re->op.barExp.right->elem;
+            }
+
+        case trie_exp:
+            len = re_search_tail(re->op.trieExp->elem, rev, cap, exact);
+            for (iter = re->op.trieExp->next; iter; iter = iter->next) {
+                len2 = re_search_tail(iter->elem, other, cap, &ex2);
+                *exact = *exact && ex2 && len2 == len && !memcmp(rev, other, len);
+                for (int i = 0; i < len; ++i)
+                    if (i >= len2 || rev[i] != other[i])
+                        len = i;
+            }
+            return len;
+
+        default:
+            return 0;
+    }
+}
+
+static int
+re_search_seq(re_comp* comp, char* rev, int cap, bool* exact)
+{
+    int len = 0;
+    bool ex;
+    m_stack order;
+
+    /* from the last step back, for as long as the steps are literals */
+    order = m_stack_init(re_comp*);
+    for (; comp; comp = comp->next)
+        m_stack_push(&order, &comp);
+
+    *exact = true;
+    for (int i = order.count - 1; i >= 0; --i) {
+        len += re_search_tail(((re_comp**)order.content)[i]->elem, rev + len, cap - len, &ex);
+        if (!ex) {
+            *exact = false;
+            break;
+        }
+    }
+
+    free(order.content);
+    return len;
+}
+
+/**
+ * @brief Build the automata and skip table for searching with a pattern.
+ *
+ * @param re Pattern tree from the front end.
+ * @param maxstates Most states either automaton may have, as for re_dfa_build.
+ * @return The searcher, or NULL if an automaton would be too big.
+ */
+re_search* re_search_build(re_exp* re, int maxstates)
+{
+    int min;
+    bool exact;
+    char rev[RE_SEARCH_SUFFIX];
+    re_search* sr = (re_search*)calloc(1, sizeof(re_search));
+
+    sr->fwd = re_dfa_compile(&re, 1, maxstates, RE_DFA_LEFTMOST);
+    sr->rev = re_dfa_compile(&re, 1, maxstates, RE_DFA_REVERSE);
+    if (sr->fwd == NULL || sr->rev == NULL) {
+        re_search_free(sr);
+        return NULL;
+    }
+
+    re_exp_len(re, &min, &sr->maxlen);
+    sr->suflen = re_search_tail(re, rev, RE_SEARCH_SUFFIX, &exact);
+    for (int i = 0; i < sr->suflen; ++i)
+        sr->suffix[i] = rev[sr->suflen - 1 - i];
+
+    /* how far a window may move on, given the byte it ends on */
+    for (int c = 0; c < 256; ++c)
+        sr->skip[c] = sr->suflen;
+    for (int i = 0; i < sr->suflen - 1; ++i)
+        sr->skip[(unsigned char)sr->suffix[i]] = sr->suflen - 1 - i;
+
+    return sr;
+}
+
+/* where the longest match ending at end and starting at or after stop starts, or -1 if none does */
+static long
+re_search_back(re_dfa* rev, const char* text, size_t end, size_t stop)
+{
+    long best = -1;
+    int state = rev->start;
+
+    for (size_t i = end; ; --i) {
+        if (re_dfa_accepting(rev, state))
+            best = (long)i;
+        if (i == stop || (state = re_dfa_step(rev, state, text[i - 1])) == 0)
+            break;
+        re_search_tally(steps);
+    }
+    return best;
+}
+
+/* where the leftmost longest match starting at or after from ends, or -1 */
+static long
+re_search_forward(re_dfa* fwd, const char* text, size_t len, size_t from)
+{
+    long best = -1;
+    int state = fwd->start;
+
+    if (re_dfa_accepting(fwd, state))
+        best = (long)from;
+    for (size_t i = from; i < len; ++i) {
+        if ((state = re_dfa_step(fwd, state, text[i])) == 0)
+            break;
+        re_search_tally(steps);
+        if (re_dfa_accepting(fwd, state))
+            best = (long)i + 1;
+    }
+    return best;
+}
+
+/**
+ * @brief Find the leftmost longest match in a text.
+ *
+ * @param sr Searcher built for the pattern.
+ * @param text Text to search; it may hold NUL bytes, which nothing matches.
+ * @param len Length of text.
+ * @param start Where the match starts, when there is one.
+ * @param end Where the match ends, one past its last byte.
+ * @return Whether the pattern matches anywhere in the text.
+ */
+bool re_search_find(re_search* sr, const char* text, size_t len, size_t* start, size_t* end)
+{
+    size_t from = 0;
+    long e, s;
+
+    /**
+     * no match ends before the first place the suffix does and the
+     * reversed automaton accepts. each check goes back at most maxlen
+     * bytes, so the skip costs no more than maxlen a byte. an unbounded
+     * pattern could send every check back to the start of the text, and
+     * would prune nothing anyway, so for one only the suffix is looked for.
+     */
+    if (sr->suflen > 0) {
+        size_t p = sr->suflen;
+
+        for (;; p += sr->skip[(unsigned char)text[p - 1]]) {
+            if (p > len)
+                return false;
+            if (memcmp(text + p - sr->suflen, sr->suffix, sr->suflen))
+                continue;
+            if (sr->maxlen < 0)
+                break;
+            re_search_tally(candidates);
+            if (re_search_back(sr->rev, text, p, p > (size_t)sr->maxlen ? p - sr->maxlen : 0) >= 0)
+                break;
+        }
+        if (sr->maxlen >= 0 && p > (size_t)sr->maxlen)
+            from = p - sr->maxlen;
+    }
+
+    if ((e = re_search_forward(sr->fwd, text, len, from)) < 0)
+        return false;
+    s = re_search_back(sr->rev, text, (size_t)e, from);
+
+    *start = (size_t)s;
+    *end   = (size_t)e;
+    return true;
+}
+
+/**
+ * @brief Free a searcher.
+ *
+ * @param sr Searcher to free.
+ */
+void re_search_free(re_search* sr)
+{
+    if (sr->fwd)
+        re_dfa_free(sr->fwd);
+    if (sr->rev)
+        re_dfa_free(sr->rev);
+    free(sr);
+}
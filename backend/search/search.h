@@ -0,0 +1,59 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../dfa/dfa.h"
+
+/* longest literal suffix kept for skipping */
+#define RE_SEARCH_SUFFIX 64
+
+/**
+ * Finds the leftmost longest match of a pattern anywhere in a text, with
+ * regular semantics as in dfa.h. A forward pass finds where the match
+ * ends and a reversed automaton, run back from there, where it starts.
+ * When every match ends in the same literal, candidate ends are found by
+ * skipping through the text for it. For a pattern of bounded length each
+ * is checked by the reversed automaton, going back no further than the
+ * longest match, before any forward pass starts that far before the
+ * first one that passes.
+ */
+typedef struct
+re_search
+{
+    re_dfa* fwd;                                // Leftmost longest, unanchored
+    re_dfa* rev;                                // Reversed, anchored at a match end
+    int maxlen;                                 // Longest match, -1 if unbounded
+    int suflen;                                 // Length of suffix, 0 for none
+    char suffix[RE_SEARCH_SUFFIX];              // Literal every match ends with
+    int skip[256];                              // Horspool shift per last byte
+}
+re_search;
+
+/**
+ * Work done by re_search_find, kept only when built with RE_COUNT_WORK.
+ * A text with many places that end in the suffix but start no match
+ * sends the reversed automaton back over the same bytes, but never more
+ * than the longest match a place.
+ */
+typedef struct
+re_search_work
+{
+    size_t steps;                               // Automaton steps, both ways
+    size_t candidates;                          // Suffix places checked backwards
+}
+re_search_work;
+
+#ifdef RE_COUNT_WORK
+extern _Thread_local re_search_work re_search_counters;
+#endif
+
+re_search* re_search_build(re_exp* re, int maxstates);
+bool re_search_find(re_search* sr, const char* text, size_t len, size_t* start, size_t* end);
+void re_search_free(re_search* sr);
+
+#endif
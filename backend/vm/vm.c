@@ -0,0 +1,273 @@
+#include "vm.h"
+
+#define RE_VM_STR_MAX 0xffff
+
+typedef struct
+re_vm_back
+{
+    const char* pos;                            // Input position to go back to
+    const unsigned char* ip;                    // Instruction to resume at
+}
+re_vm_back;
+
+/* bytes an instruction takes once encoded; long literals are split */
+static size_t
+re_vm_width(re_inst* in)
+{
+    switch (in->op)
+    {
+        case RE_OP_CHAR:    return 2;
+        case RE_OP_SET:     return 3;
+        case RE_OP_STR:     return (size_t)3 * ((in->len + RE_VM_STR_MAX - 1) / RE_VM_STR_MAX) + in->len;
+        case RE_OP_CHOICE:
+        case RE_OP_COMMIT:
+        case RE_OP_LOOP:
+        case RE_OP_JMP:     return 5;
+        default:            return 1;
+    }
+}
+
+static unsigned char*
+re_vm_u16(unsigned char* out, unsigned int v)
+{
+    out[0] = v & 0xff;
+    out[1] = (v >> 8) & 0xff;
+    return out + 2;
+}
+
+static unsigned char*
+re_vm_u32(unsigned char* out, unsigned int v)
+{
+    out[0] = v & 0xff;
+    out[1] = (v >> 8) & 0xff;
+    out[2] = (v >> 16) & 0xff;
+    out[3] = (v >> 24) & 0xff;
+    return out + 4;
+}
+
+#define re_vm_get16(p) ((unsigned int)(p)[0] | ((unsigned int)(p)[1] << 8))
+#define re_vm_get32(p) ((unsigned int)(p)[0] | ((unsigned int)(p)[1] << 8) | ((unsigned int)(p)[2] << 16) | ((unsigned int)(p)[3] << 24))
+
+/**
+ * @brief Encode an instruction program as compact bytecode.
+ *
+ * @param prog Program to encode; the result does not refer back to it.
+ * @return The bytecode, which matches exactly what prog does.
+ */
+re_vm* re_vm_compile(re_prog* prog)
+{
+    re_vm* vm;
+    size_t* at;
+    unsigned char* out;
+
+    /* where every instruction will start, so jumps can be written in one pass */
+    at = (size_t*)malloc((prog->count + 1) * sizeof(size_t));
+    at[0] = 0;
+    for (int i = 0; i < prog->count; ++i)
+        at[i+1] = at[i] + re_vm_width(prog->code + i);
+
+    vm = (re_vm*)malloc(sizeof(re_vm));
+    vm->size  = at[prog->count];
+    vm->code  = (unsigned char*)malloc(vm->size);
+    vm->nsets = prog->nsets;
+    vm->sets  = (unsigned char*)malloc(prog->nsets * RE_SET_BYTES + 1);
+    vm->depth = prog->depth;
+    memcpy(vm->sets, prog->sets, prog->nsets * RE_SET_BYTES);
+
+    out = vm->code;
+    for (int i = 0; i < prog->count; ++i)
+    {
+        re_inst* in = prog->code + i;
+
+        switch (in->op)
+        {
+            case RE_OP_CHAR:
+                *out++ = RE_VM_CHAR;
+                *out++ = in->arg;
+                break;
+
+            case RE_OP_ANY:
+                *out++ = RE_VM_ANY;
+                break;
+
+            case RE_OP_SET:
+                *out++ = RE_VM_SET;
+                out = re_vm_u16(out, in->arg);
+                break;
+
+            case RE_OP_STR:
+                for (int off = 0; off < in->len; off += RE_VM_STR_MAX) {
+                    int len = in->len - off < RE_VM_STR_MAX ? in->len - off : RE_VM_STR_MAX;
+                    *out++ = RE_VM_STR;
+                    out = re_vm_u16(out, len);
+                    memcpy(out, prog->pool + in->arg + off, len);
+                    out += len;
+                }
+                break;
+
+            case RE_OP_CHOICE:
+            case RE_OP_COMMIT:
+            case RE_OP_LOOP:
+            case RE_OP_JMP:
+                *out++ = in->op == RE_OP_CHOICE ? RE_VM_SPLIT
+                       : in->op == RE_OP_COMMIT ? RE_VM_COMMIT
+                       : in->op == RE_OP_LOOP   ? RE_VM_LOOP : RE_VM_JMP;
+                out = re_vm_u32(out, at[in->arg]);
+                break;
+
+            case RE_OP_FAIL:
+                *out++ = RE_VM_FAIL;
+                break;
+
+            case RE_OP_MATCH:
+                *out++ = RE_VM_MATCH;
+                break;
+        }
+    }
+
+    free(at);
+    return vm;
+}
+
+#if RE_VM_THREADED
+#define VM_OP(op, label) label:
+#define VM_NEXT() goto *dispatch[*ip]
+#else
+#define VM_OP(op, label) case op:
+#define VM_NEXT() goto next
+#endif
+
+/**
+ * @brief Run bytecode over a string.
+ *
+ * @param vm Bytecode to run.
+ * @param str NUL terminated input; a match must start at its first byte.
+ * @return Whether some prefix of the input matches.
+ */
+bool re_vm_run(re_vm* vm, const char* str)
+{
+    bool res;
+    int top = 0;
+    const char* pos = str;
+    const unsigned char* ip = vm->code;
+    const unsigned char* code = vm->code;
+    re_vm_back stack[RE_VM_STACK];
+    re_vm_back* back = stack;
+
+    /* the depth is known up front, so there is never a push to check */
+    if (vm->depth > RE_VM_STACK)
+        back = (re_vm_back*)malloc(vm->depth * sizeof(re_vm_back));
+
+#if RE_VM_THREADED
+    static void* const dispatch[] = {
+        [RE_VM_CHAR]   = &&vm_char,
+        [RE_VM_ANY]    = &&vm_any,
+        [RE_VM_SET]    = &&vm_set,
+        [RE_VM_STR]    = &&vm_str,
+        [RE_VM_SPLIT]  = &&vm_split,
+        [RE_VM_COMMIT] = &&vm_commit,
+        [RE_VM_LOOP]   = &&vm_loop,
+        [RE_VM_JMP]    = &&vm_jmp,
+        [RE_VM_FAIL]   = &&vm_fail,
+        [RE_VM_MATCH]  = &&vm_match
+    };
+
+    VM_NEXT();
+#else
+next:
+    switch (*ip)
+#endif
+    {
+        VM_OP(RE_VM_CHAR, vm_char)
+            if ((unsigned char)*pos != ip[1])
+                goto fail;
+            pos++;
+            ip += 2;
+            VM_NEXT();
+
+        VM_OP(RE_VM_ANY, vm_any)
+            if (*pos == '\0')
+                goto fail;
+            pos++;
+            ip += 1;
+            VM_NEXT();
+
+        VM_OP(RE_VM_SET, vm_set)
+            if (!re_set_has(vm->sets + re_vm_get16(ip + 1) * RE_SET_BYTES, *pos))
+                goto fail;
+            pos++;
+            ip += 3;
+            VM_NEXT();
+
+        VM_OP(RE_VM_STR, vm_str)
+        {
+            unsigned int len = re_vm_get16(ip + 1);
+            if (strncmp(pos, (const char*)ip + 3, len))
+                goto fail;
+            pos += len;
+            ip  += 3 + len;
+            VM_NEXT();
+        }
+
+        VM_OP(RE_VM_SPLIT, vm_split)
+            back[top].pos = pos;
+            back[top].ip  = code + re_vm_get32(ip + 1);
+            top++;
+            ip += 5;
+            VM_NEXT();
+
+        VM_OP(RE_VM_COMMIT, vm_commit)
+            top--;
+            ip = code + re_vm_get32(ip + 1);
+            VM_NEXT();
+
+        VM_OP(RE_VM_LOOP, vm_loop)
+            /* a pass that consumed nothing would repeat forever */
+            if (back[top-1].pos == pos) {
+                top--;
+                ip += 5;
+            } else {
+                back[top-1].pos = pos;
+                back[top-1].ip  = ip + 5;
+                ip = code + re_vm_get32(ip + 1);
+            }
+            VM_NEXT();
+
+        VM_OP(RE_VM_JMP, vm_jmp)
+            ip = code + re_vm_get32(ip + 1);
+            VM_NEXT();
+
+        VM_OP(RE_VM_FAIL, vm_fail)
+            goto fail;
+
+        VM_OP(RE_VM_MATCH, vm_match)
+            res = true;
+            goto done;
+    }
+
+fail:
+    if (top > 0) {
+        top--;
+        pos = back[top].pos;
+        ip  = back[top].ip;
+        VM_NEXT();
+    }
+    res = false;
+
+done:
+    if (back != stack)
+        free(back);
+    return res;
+}
+
+/**
+ * @brief Free bytecode.
+ *
+ * @param vm Bytecode to free.
+ */
+void re_vm_free(re_vm* vm)
+{
+    free(vm->code);
+    free(vm->sets);
+    free(vm);
+}
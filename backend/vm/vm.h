@@ -0,0 +1,62 @@
+#ifndef VM_H
+#define VM_H
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../prog/prog.h"
+
+/* computed goto is a GNU extension; elsewhere the loop is a plain switch */
+#if defined(__GNUC__) && !defined(RE_VM_SWITCH)
+#define RE_VM_THREADED 1
+#else
+#define RE_VM_THREADED 0
+#endif
+
+/* choices saved on the C stack before the vm falls back to the heap */
+#define RE_VM_STACK 64
+
+/**
+ * Bytecode layout, one opcode byte then its operands. Offsets are
+ * absolute, 32 bits and unaligned:
+ *   char   c        any
+ *   set    u16 n    str     u16 len, bytes
+ *   split  u32 alt  commit  u32 to
+ *   loop   u32 to   jmp     u32 to
+ *   fail            match
+ */
+typedef enum
+re_vm_op
+{
+    RE_VM_CHAR,
+    RE_VM_ANY,
+    RE_VM_SET,
+    RE_VM_STR,
+    RE_VM_SPLIT,
+    RE_VM_COMMIT,
+    RE_VM_LOOP,
+    RE_VM_JMP,
+    RE_VM_FAIL,
+    RE_VM_MATCH
+}
+re_vm_op;
+
+typedef struct
+re_vm
+{
+    unsigned char* code;                        // Bytecode, entered at offset 0
+    size_t size;                                // Length of the bytecode
+    unsigned char* sets;                        // Bitmaps, as in re_prog
+    int nsets;                                  // Number of bitmaps
+    int depth;                                  // Most choices ever saved at once
+}
+re_vm;
+
+re_vm* re_vm_compile(re_prog* prog);
+bool re_vm_run(re_vm* vm, const char* str);
+void re_vm_free(re_vm* vm);
+
+#endif
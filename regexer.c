@@ -6,38 +6,55 @@
 #include <assert.h>
 #include <ctype.h>
 #include <stdbool.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <limits.h>
 
 #include "types/stack/stack.h"
 #include "types/list/lists.h"
+#include "types/arena/arena.h"
+#include "types/bstree/bstree.h"
+#include "types/map/maps.h"
+#include "backend/prog/prog.h"
+#include "backend/jit/jit.h"
+#include "backend/dfa/dfa.h"
+#include "backend/search/search.h"
+#include "backend/par/par.h"
+#include "backend/pool/pool.h"
+#include "regexer.h"
+
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/socket.h>
+#else
+#include <direct.h>
+#include <process.h>
+#define getpid _getpid
+#define mkdir(path, mode) _mkdir(path)
+#endif
 
-struct re_exp;
 struct re_scan_t;
-struct re_comp;
 struct re_state;
 struct re_parse_t;
 
 #define SPACING_COUNT 3
 
-void re_exp_print(struct re_exp*, int);
-void re_comp_print(struct re_comp*, int);
+/* bump whenever generated code changes, so cached output is dropped */
+#define REGEXER_VERSION "0.6"
 
-int issubstr(char* line, char* sub) {
-	size_t slen = strlen(sub);
-	size_t llen = strlen(line);
-	
-	if (llen >= slen) {
-		char buf[slen+1];	
-		size_t max  = llen - slen;
-
-		for (int i = 0; i < max; ++i) {
-			memcpy(buf, line + i, slen);
-			buf[slen] = '\0';
-			if (!strcmp(buf, sub)) return i;
-		}
-	}
+/**
+ * deepest groups may nest. walks over the tree loop along sequences and
+ * chains of alternatives, however long, but recurse into groups, so it is
+ * nesting alone that the call stack has to hold.
+ */
+#define RE_MAX_NESTING 1000
 
-	return -1;
-}
+void re_exp_print(struct re_exp*, int);
+void re_comp_print(struct re_comp*, int);
 
 /* https://stackoverflow.com/questions/735126/are-there-alternate-implementations-of-gnu-getline-interface/47229318#47229318 */
 ssize_t getline(char **lineptr, size_t *n, FILE *stream) {
@@ -165,126 +182,268 @@ re_tk_string(re_tk tok) {
 	}
 }
 
-typedef struct re_exp {
-    enum { char_exp, empty_exp,
-		   dot_exp, rep_exp, bar_exp, 
-		   plain_exp, opt_exp, range_exp, 
-		   select_exp, kleene_exp } 		   tag;
-    union { char                               charExp;
-			char                               emptyExp;
-			char						       dotExp;
-            struct re_comp*                    repExp;
-            struct re_comp*                    plainExp;
-            struct { struct re_comp* left;
-                     struct re_comp* right; }  barExp;
-            struct re_comp*                    optExp;
-			struct { char min; char max; }     rangeExp;
-            struct { int pos;
-			         struct re_comp* select; } selectExp;
-            struct re_comp*                    kleeneExp; } op;
-} re_exp;
-
-typedef struct re_comp {
-    re_exp*         elem;
-    struct re_comp* next;
-} re_comp;
 
-void re_exp_print(re_exp* re, int ind)
+/* a step of printing a tree: a line, an expression, or the rest of a sequence */
+typedef struct
+re_print_t
+{
+	char*    line;
+	re_exp*  re;
+	re_comp* comp;
+	int      ind;
+}
+re_print_t;
+
+#define re_print_push(todo, ...) m_stack_push((todo), &(re_print_t) { __VA_ARGS__ })
+
+/* print a tree, with the pending steps on a stack of their own rather than the call stack */
+void re_comp_print(re_comp* comp, int indent)
 {
-	if (re)
+	re_print_t at;
+	m_stack todo = m_stack_init(re_print_t);
+
+	re_print_push(&todo, .comp = comp, .ind = indent);
+	while (todo.count > 0)
 	{
-		switch(re->tag)
+		at = *(re_print_t*)m_stack_pop(&todo);
+
+		if (at.line) {
+			getspacing(at.ind);
+			printf("%s", at.line);
+			continue;
+		}
+		if (at.comp) {
+			if (at.comp->next)
+				re_print_push(&todo, .comp = at.comp->next, .ind = at.ind);
+			re_print_push(&todo, .re = at.comp->elem, .ind = at.ind);
+			continue;
+		}
+		if (at.re == NULL)
+			continue;
+
+		/* children go on the stack last first */
+		getspacing(at.ind);
+		switch (at.re->tag)
 		{
 			case kleene_exp:
-				getspacing(ind);
+			case rep_exp:
 				printf("rep-exp:\n");
-				re_comp_print(re->op.kleeneExp, ind+1);
+				re_print_push(&todo, .comp = at.re->op.kleeneExp, .ind = at.ind + 1);
 				break;
 
 			case select_exp:
-				getspacing(ind);
-				printf("select-exp: %s\n", re->op.selectExp.pos ? "" : " not");
-				re_comp_print(re->op.selectExp.select, ind+1);
+				printf("select-exp: %s\n", at.re->op.selectExp.pos ? "" : " not");
+				re_print_push(&todo, .comp = at.re->op.selectExp.select, .ind = at.ind + 1);
 				break;
 
 			case range_exp:
-				getspacing(ind);
 				printf(
 					"range: %c-%c\n", 
-					re->op.rangeExp.min,
-					re->op.rangeExp.max
+					at.re->op.rangeExp.min,
+					at.re->op.rangeExp.max
 				);
 				break;
 
 			case opt_exp:
-				getspacing(ind);
 				printf("opt-exp:\n");
-				re_comp_print(re->op.optExp, ind+1);
+				re_print_push(&todo, .comp = at.re->op.optExp, .ind = at.ind + 1);
 				break;
 
 			case bar_exp:
-				getspacing(ind);
 				printf("bar-exp:\n");
-
-				getspacing(ind+1);
-				printf("alt #1:\n");
-				re_comp_print(re->op.barExp.left, ind+2);
-				
-				getspacing(ind+1);
-				printf("alt #2:\n");
-				re_comp_print(re->op.barExp.right, ind+2);
+				re_print_push(&todo, .comp = at.re->op.barExp.right, .ind = at.ind + 2);
+				re_print_push(&todo, .line = "alt #2:\n", .ind = at.ind + 1);
+				re_print_push(&todo, .comp = at.re->op.barExp.left, .ind = at.ind + 2);
+				re_print_push(&todo, .line = "alt #1:\n", .ind = at.ind + 1);
 				break;
 
 			case plain_exp:
-				getspacing(ind);
 				printf("plain-exp:\n");
-				re_comp_print(re->op.plainExp, ind+1);
-				break;
-
-			case rep_exp:
-				getspacing(ind);
-				printf("rep-exp:\n");
-				re_comp_print(re->op.repExp, ind+1);
+				re_print_push(&todo, .comp = at.re->op.plainExp, .ind = at.ind + 1);
 				break;
 
 			case empty_exp:
-				getspacing(ind);
 				printf("empty\n");
 				break;
 
 			case char_exp:
-				getspacing(ind);
-				printf("char: %c\n", re->op.charExp);
+				printf("char: %c\n", at.re->op.charExp);
+				break;
+
+			case str_exp:
+				printf("str: %.*s\n", at.re->op.strExp.len, at.re->op.strExp.str);
+				break;
+
+			case dot_exp:
+				printf("dot\n");
+				break;
+
+			case trie_exp:
+				printf("trie-exp:\n");
+				re_print_push(&todo, .comp = at.re->op.trieExp, .ind = at.ind + 1);
 				break;
 		}
 	}
+
+	free(todo.content);
 }
 
-void re_comp_print(re_comp* comp, int indent)
+void re_exp_print(re_exp* re, int ind)
 {
-	re_comp* top;
-
-	if (comp) {
-		top = comp;
-		while (top) {
-			re_exp_print(top->elem, indent);
-			top = top->next;
-		}
-	}
+	re_comp_print(&(re_comp) { .elem = re, .next = NULL }, ind);
 }
 
+m_arena re_arena;
+
 re_exp* re_exp_new(re_exp re) {
-	re_exp* ptr = (re_exp*)malloc(sizeof(re_exp));
+	re_exp* ptr = m_arena_new(&re_arena, re_exp);
 	if (ptr) *ptr = re;
 	return ptr;
 }
 
 re_comp* re_comp_new(re_comp re) {
-	re_comp* ptr = (re_comp*)malloc(sizeof(re_comp));
+	re_comp* ptr = m_arena_new(&re_arena, re_comp);
 	if (ptr) *ptr = re;
 	return ptr;
 }
 
+/*
+ * single chars and the empty step are shared by every tree, so they cost
+ * the parser nothing, and no pass may change a node of either in place
+ */
+static re_exp* re_char_new(char ch)
+{
+	static re_exp chars[256];
+	static bool ready = false;
+
+	if (!ready) {
+		for (int c = 0; c < 256; ++c)
+			chars[c] = (re_exp) { .tag = char_exp, .op.charExp = (char)c };
+		ready = true;
+	}
+	return &chars[(unsigned char)ch];
+}
+
+static re_exp re_empty = { .tag = empty_exp, .op.emptyExp = 0 };
+
+void re_key_puts(m_stack* key, char* str)
+{
+	while (*str)
+		m_stack_push(key, str++);
+}
+
+void re_comp_key(re_comp* comp, m_stack* key);
+
+/**
+ * append a canonical form of a tree to a char stack, so that patterns
+ * which only differ in grouping or escaping share a key.
+ */
+void re_exp_key(re_exp* re, m_stack* key)
+{
+	int depth;
+	char buf[16];
+	re_comp* iter;
+
+	switch (re->tag)
+	{
+		case char_exp:
+			snprintf(buf, sizeof(buf), "c%02x", (unsigned char)re->op.charExp);
+			re_key_puts(key, buf);
+			break;
+
+		case str_exp:
+			/* spelled out, so a literal keys the same as its chars */
+			for (int i = 0; i < re->op.strExp.len; ++i) {
+				snprintf(buf, sizeof(buf), "c%02x", (unsigned char)re->op.strExp.str[i]);
+				re_key_puts(key, buf);
+			}
+			break;
+
+		case range_exp:
+			snprintf(
+				buf, sizeof(buf), "r%02x%02x",
+				(unsigned char)re->op.rangeExp.min,
+				(unsigned char)re->op.rangeExp.max
+			);
+			re_key_puts(key, buf);
+			break;
+
+		case dot_exp:
+			re_key_puts(key, ".");
+			break;
+
+		case empty_exp:
+			re_key_puts(key, "e");
+			break;
+
+		case kleene_exp:
+		case rep_exp:
+		case opt_exp:
+			re_key_puts(key, re->tag == kleene_exp ? "*" : (re->tag == rep_exp ? "+" : "?"));
+			re_comp_key(re->op.kleeneExp, key);
+			break;
+
+		case select_exp:
+			re_key_puts(key, re->op.selectExp.pos ? "[" : "[^");
+			for (iter = re->op.selectExp.select; iter; iter = iter->next)
+				re_exp_key(iter->elem, key);
+			re_key_puts(key, "]");
+			break;
+
+		case bar_exp:
+			if (!(re->op.barExp.left && re->op.barExp.right)) {
+				re_comp_key(re->op.barExp.left ? re->op.barExp.left : re->op.barExp.right, key);
+				break;
+			}
+			/* the same key as keying each link inside the one before it */
+			for (depth = 0; ; ++depth) {
+				re_key_puts(key, "|");
+				re_comp_key(re->op.barExp.left, key);
+				if (!re_bar_chained(re->op.barExp.right))
+					break;
+				re_key_puts(key, "(");
+				re = re->op.barExp.right->elem;
+			}
+			re_comp_key(re->op.barExp.right, key);
+			while (depth-- > 0)
+				re_key_puts(key, ")");
+			break;
+
+		case plain_exp:
+			re_comp_key(re->op.plainExp, key);
+			break;
+
+		case trie_exp:
+			re_key_puts(key, "t");
+			for (iter = re->op.trieExp; iter; iter = iter->next) {
+				re_key_puts(key, "(");
+				re_exp_key(iter->elem, key);
+				re_key_puts(key, ")");
+			}
+			break;
+	}
+}
+
+/* sequences are flattened, so (ab)c and a(bc) share a key */
+static void re_seq_key(re_comp* comp, m_stack* key)
+{
+	for (; comp; comp = comp->next) {
+		re_exp* re = comp->elem;
+		if (re->tag == plain_exp)
+			re_seq_key(re->op.plainExp, key);
+		else if (re->tag == bar_exp && !(re->op.barExp.left && re->op.barExp.right))
+			re_seq_key(re->op.barExp.left ? re->op.barExp.left : re->op.barExp.right, key);
+		else re_exp_key(re, key);
+	}
+}
+
+void re_comp_key(re_comp* comp, m_stack* key)
+{
+	re_key_puts(key, "(");
+	re_seq_key(comp, key);
+	re_key_puts(key, ")");
+}
+
 typedef struct 
 re_sc
 {
@@ -295,6 +454,10 @@ re_sc
 	m_stack unlex;
     int     column;
     int     lastchar;
+    int     lastcode;
+    int     depth;
+    bool    escaped;
+    bool    inclass;
 }
 re_scan_t;
 
@@ -316,9 +479,13 @@ re_scan_init(char* str)
 
 	sc.line     = 0;
 	sc.lastchar = 0;
+	sc.lastcode = -1;
 	sc.src      = str;
 	sc.cur      = str;
 	sc.column   = 0;
+	sc.depth    = 0;
+	sc.escaped  = false;
+	sc.inclass  = false;
 	sc.unget    = m_stack_init(char);
 	sc.unlex    = m_stack_init(re_tk);
 
@@ -356,10 +523,40 @@ re_getch(re_scan_t* sc)
 	m_stack_push(&((sc)->unlex), (re_tk[]){tok});\
 }
 
+/* take the rest of a UTF-8 sequence led by ch, keeping its code point */
+static void
+re_utf8_scan(re_scan_t* sc, int ch)
+{
+	int n, cp, min;
+	unsigned char c = ch;
+
+	if (sc->unget.count > 0)
+		return;
+	if (c >= 0xC2 && c <= 0xDF) n = 1, cp = c & 0x1F, min = 0x80;
+	else if (c >= 0xE0 && c <= 0xEF) n = 2, cp = c & 0x0F, min = 0x800;
+	else if (c >= 0xF0 && c <= 0xF4) n = 3, cp = c & 0x07, min = 0x10000;
+	else return;
+
+	for (int i = 0; i < n; ++i) {
+		if (((unsigned char)sc->cur[i] & 0xC0) != 0x80)
+			return;
+		cp = cp << 6 | ((unsigned char)sc->cur[i] & 0x3F);
+	}
+
+	/* overlong forms and surrogates stay single bytes */
+	if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF))
+		return;
+	sc->cur     += n;
+	sc->lastcode = cp;
+}
+
+void re_error(const char* fmt, ...);
+
 re_tk
 re_lex(re_scan_t* sc)
 {
     int ch;
+	bool esc;
 
 	if (sc->unlex.count > 0) {
 		ch = *(re_tk*)m_stack_pop(&(sc->unlex));
@@ -369,16 +566,32 @@ re_lex(re_scan_t* sc)
     while (1)
     {
 		ch = re_getch(sc);
+		sc->lastcode = -1;
+
+		/* groups are counted as they open, outside classes and escapes */
+		esc = sc->escaped;
+		sc->escaped = false;
+		if (!esc && ch == '(' && !sc->inclass && ++sc->depth > RE_MAX_NESTING)
+			re_error("groups nest deeper than %d.\n", RE_MAX_NESTING);
+		if (!esc && ch == ')' && !sc->inclass)
+			sc->depth--;
+
 		switch (ch)
 		{
-			case '[': return P_TOK_LBRACK;
-			case ']': return P_TOK_RBRACK;
+			case '[':
+				sc->inclass |= !esc;
+				return P_TOK_LBRACK;
+			case ']':
+				sc->inclass &= esc;
+				return P_TOK_RBRACK;
 			case '+': return P_TOK_PLUS;
 			case '-': return P_TOK_MINUS;
 			case '*': return P_TOK_TIMES;
 			case '?': return P_TOK_QUESTION;
 			case '|': return P_TOK_BAR;
-			case '\\': return P_TOK_SLASH;
+			case '\\':
+				sc->escaped = !esc;
+				return P_TOK_SLASH;
 			case '^': return P_TOK_CAP;
 			case '(': return P_TOK_LPAREN;
 			case ')': return P_TOK_RPAREN;
@@ -387,7 +600,9 @@ re_lex(re_scan_t* sc)
 			case 't': return P_TOK_TABULATE_CHAR;
 			case '.': return P_TOK_DOT;
             case -1:  return P_TOK_END;
-            default:  return P_TOK_CHAR;
+            default:
+				re_utf8_scan(sc, ch);
+				return P_TOK_CHAR;
 		}
     }
 }
@@ -478,24 +693,21 @@ re_pobj_print(re_pobj re)
 	switch (re.action)
 	{
 		case GOTO:
-			len    = snprintf(NULL, 0, "g%d", re.op.sgoto);
-			buf    = (char*)malloc(len);
-			buf[0] = 'g';
-			itoa(re.op.sgoto, buf+1, 10);
+			len = snprintf(NULL, 0, "g%d", re.op.sgoto);
+			buf = (char*)malloc(len + 1);
+			snprintf(buf, len + 1, "g%d", re.op.sgoto);
 			break;
 
 		case SHIFT:
-			len    = snprintf(NULL, 0, "s%d", re.op.shift);
-			buf    = (char*)malloc(len);
-			buf[0] = 's';
-			itoa(re.op.shift, buf+1, 10);
+			len = snprintf(NULL, 0, "s%d", re.op.shift);
+			buf = (char*)malloc(len + 1);
+			snprintf(buf, len + 1, "s%d", re.op.shift);
 			break;
 
 		case REDUCE:
-			len    = snprintf(NULL, 0, "r%d", re.op.reduce.rule);
-			buf    = (char*)malloc(len);
-			buf[0] = 'r';
-			itoa(re.op.reduce.rule, buf+1, 10);
+			len = snprintf(NULL, 0, "r%d", re.op.reduce.rule);
+			buf = (char*)malloc(len + 1);
+			snprintf(buf, len + 1, "r%d", re.op.reduce.rule);
 			break;
 
 		case ERROR:
@@ -1279,6 +1491,15 @@ re_table_prepare()
     return table;
 }
 
+/* the code points behind a char or range node led by a multibyte char, found through the node's ucs */
+typedef struct
+re_ucs
+{
+	int min;
+	int max;
+}
+re_ucs;
+
 typedef struct
 re_parse_t
 {
@@ -1289,6 +1510,7 @@ re_parse_t
     m_stack    ststack;
 	m_stack    tkstack;
 	m_stack    restack;
+	m_stack    ucs;
 }
 re_parse_t;
 
@@ -1307,18 +1529,294 @@ re_parse_t;
 re_parse_t
 re_parse_init(re_scan_t* sc)
 {
+	static re_pobj* table = NULL;
 	re_parse_t ps;
 
+	/* the table never changes, so build it once per process */
+	if (table == NULL)
+		table = re_table_prepare();
+
 	ps.scanner = sc;
 	ps.cid     = 0;
 	ps.ststack = m_stack_init(int);
 	ps.tkstack = m_stack_init(re_tk);
 	ps.restack = m_stack_init(re_exp*);
-	ps.table   = re_table_prepare();
+	ps.ucs     = m_stack_init(re_ucs);
+	ps.table   = table;
 	
 	return ps;
 }
 
+/* release the stacks of a parser and its scanner, but not the shared table */
+void
+re_parse_free(re_parse_t* ps)
+{
+	free(ps->ststack.content);
+	free(ps->tkstack.content);
+	free(ps->restack.content);
+	free(ps->ucs.content);
+	free(ps->scanner->unget.content);
+	free(ps->scanner->unlex.content);
+}
+
+jmp_buf* re_recover = NULL;
+char re_errmsg[256];
+
+void
+re_error(const char* fmt, ...)
+{
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(re_errmsg, sizeof(re_errmsg), fmt, args);
+	va_end(args);
+
+	if (re_recover != NULL)
+		longjmp(*re_recover, 1);
+
+	fputs(re_errmsg, stderr);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * UTF-8 classes. a multibyte char stands for its code point, and a class
+ * holding one is turned into alternatives over byte ranges, split the way
+ * RE2 does it so each alternative is a short run of byte classes. nothing
+ * is decoded while matching. classes of plain bytes keep matching single
+ * bytes, and a stray high byte in a UTF-8 class is read as U+0080-U+00FF.
+ */
+typedef struct
+re_utf8_seq
+{
+	int           len;
+	unsigned char lo[4];
+	unsigned char hi[4];
+}
+re_utf8_seq;
+
+static re_ucs* re_ucs_find(re_parse_t* pr, re_exp* re)
+{
+	return re->ucs > 0 ? (re_ucs*)pr->ucs.content + re->ucs - 1 : NULL;
+}
+
+static void re_ucs_set(re_parse_t* pr, re_exp* re, int min, int max)
+{
+	m_stack_push(&(pr->ucs), &(re_ucs) { min, max });
+	re->ucs = pr->ucs.count;
+}
+
+static int re_utf8_encode(int cp, unsigned char* out)
+{
+	if (cp < 0x80) {
+		out[0] = cp;
+		return 1;
+	}
+	if (cp < 0x800) {
+		out[0] = 0xC0 | cp >> 6;
+		out[1] = 0x80 | (cp & 0x3F);
+		return 2;
+	}
+	if (cp < 0x10000) {
+		out[0] = 0xE0 | cp >> 12;
+		out[1] = 0x80 | (cp >> 6 & 0x3F);
+		out[2] = 0x80 | (cp & 0x3F);
+		return 3;
+	}
+	out[0] = 0xF0 | cp >> 18;
+	out[1] = 0x80 | (cp >> 12 & 0x3F);
+	out[2] = 0x80 | (cp >> 6 & 0x3F);
+	out[3] = 0x80 | (cp & 0x3F);
+	return 4;
+}
+
+/* cut lo-hi until every piece encodes as byte ranges of the same length */
+static void re_utf8_split(int lo, int hi, m_stack* seqs)
+{
+	static const int bounds[] = { 0x7F, 0x7FF, 0xFFFF };
+	re_utf8_seq seq;
+
+	if (lo > hi)
+		return;
+	if (lo <= 0xDFFF && hi >= 0xD800) {
+		re_utf8_split(lo, 0xD7FF, seqs);
+		re_utf8_split(0xE000, hi, seqs);
+		return;
+	}
+	for (int i = 0; i < 3; ++i) {
+		if (lo <= bounds[i] && hi > bounds[i]) {
+			re_utf8_split(lo, bounds[i], seqs);
+			re_utf8_split(bounds[i] + 1, hi, seqs);
+			return;
+		}
+	}
+	for (int i = 1; i < 4 && hi > 0x7F; ++i) {
+		int m = (1 << (6 * i)) - 1;
+		if ((lo & ~m) == (hi & ~m))
+			continue;
+		if (lo & m) {
+			re_utf8_split(lo, lo | m, seqs);
+			re_utf8_split((lo | m) + 1, hi, seqs);
+			return;
+		}
+		if ((hi & m) != m) {
+			re_utf8_split(lo, (hi & ~m) - 1, seqs);
+			re_utf8_split(hi & ~m, hi, seqs);
+			return;
+		}
+	}
+
+	seq.len = re_utf8_encode(lo, seq.lo);
+	re_utf8_encode(hi, seq.hi);
+	m_stack_push(seqs, &seq);
+}
+
+static re_exp* re_utf8_byte(unsigned char lo, unsigned char hi)
+{
+	if (lo == hi)
+		return re_char_new(lo);
+
+	return re_exp_new((re_exp) {
+		.tag                 = select_exp,
+		.op.selectExp.pos    = 1,
+		.op.selectExp.select = re_comp_new((re_comp) {
+			.elem = re_exp_new((re_exp) { .tag = range_exp, .op.rangeExp.min = lo, .op.rangeExp.max = hi }),
+			.next = NULL
+		})
+	});
+}
+
+static int re_int_pair_comp(const void* a, const void* b)
+{
+	return ((const int*)a)[0] - ((const int*)b)[0];
+}
+
+/* a class with code points in it, as alternatives over bytes */
+static re_exp* re_utf8_class(re_parse_t* pr, re_exp* sel)
+{
+	int pair[2];
+	int count, next;
+	int* iv;
+	re_ucs* u;
+	re_utf8_seq* seq;
+	re_exp* alt;
+	re_exp* ascii;
+	re_comp* tail;
+	m_stack ivs, merged, seqs, alts;
+
+	ivs = m_stack_init(int[2]);
+	for (re_comp* iter = sel->op.selectExp.select; iter; iter = iter->next) {
+		re_exp* m = iter->elem;
+		if ((u = re_ucs_find(pr, m)) != NULL)
+			pair[0] = u->min, pair[1] = u->max;
+		else if (m->tag == char_exp)
+			pair[0] = pair[1] = (unsigned char)m->op.charExp;
+		else if (m->tag == range_exp)
+			pair[0] = (unsigned char)m->op.rangeExp.min, pair[1] = (unsigned char)m->op.rangeExp.max;
+		else pair[0] = 1, pair[1] = 0x10FFFF;
+		m_stack_push(&ivs, pair);
+	}
+
+	/* sorted and merged, then flipped over 1-0x10FFFF for [^...] */
+	iv = (int*)ivs.content;
+	qsort(iv, ivs.count, sizeof(int[2]), re_int_pair_comp);
+	merged = m_stack_init(int[2]);
+	for (int i = 0; i < ivs.count; ++i) {
+		int* top = merged.count ? (int*)m_stack_tos(merged) : NULL;
+		if (top && iv[2*i] <= top[1] + 1) {
+			if (iv[2*i+1] > top[1])
+				top[1] = iv[2*i+1];
+		}
+		else m_stack_push(&merged, &iv[2*i]);
+	}
+	if (!sel->op.selectExp.pos) {
+		next = 1;
+		ivs.count = 0;
+		for (int i = 0; i < merged.count; ++i) {
+			iv = (int*)merged.content + 2*i;
+			pair[0] = next, pair[1] = iv[0] - 1;
+			if (pair[0] <= pair[1])
+				m_stack_push(&ivs, pair);
+			next = iv[1] + 1;
+		}
+		pair[0] = next, pair[1] = 0x10FFFF;
+		if (pair[0] <= pair[1])
+			m_stack_push(&ivs, pair);
+		free(merged.content);
+		merged = ivs;
+	}
+	else free(ivs.content);
+
+	seqs = m_stack_init(re_utf8_seq);
+	for (int i = 0; i < merged.count; ++i) {
+		iv = (int*)merged.content + 2*i;
+		re_utf8_split(iv[0] ? iv[0] : 1, iv[1], &seqs);
+	}
+
+	/* the single bytes share one class, tried first */
+	alts  = m_stack_init(re_exp*);
+	ascii = NULL;
+	tail  = NULL;
+	seq   = (re_utf8_seq*)seqs.content;
+	for (int i = 0; i < seqs.count; ++i) {
+		if (seq[i].len != 1)
+			continue;
+		re_comp* c = re_comp_new((re_comp) { .elem = re_utf8_byte(seq[i].lo[0], seq[i].hi[0]), .next = NULL });
+		if (c->elem->tag == select_exp)
+			c->elem = c->elem->op.selectExp.select->elem;
+		if (ascii == NULL) {
+			ascii = re_exp_new((re_exp) { .tag = select_exp, .op.selectExp.pos = 1, .op.selectExp.select = c });
+			m_stack_push(&alts, &ascii);
+		}
+		else tail->next = c;
+		tail = c;
+	}
+	for (int i = 0; i < seqs.count; ++i) {
+		re_comp* head = NULL;
+		if (seq[i].len == 1)
+			continue;
+		for (int j = seq[i].len - 1; j >= 0; --j)
+			head = re_comp_new((re_comp) { .elem = re_utf8_byte(seq[i].lo[j], seq[i].hi[j]), .next = head });
+		alt = re_exp_new((re_exp) { .tag = plain_exp, .op.plainExp = head });
+		m_stack_push(&alts, &alt);
+	}
+
+	/* nothing at all: a class no byte is in */
+	count = alts.count;
+	if (count == 0) {
+		alt = re_exp_new((re_exp) {
+			.tag                 = select_exp,
+			.op.selectExp.pos    = 0,
+			.op.selectExp.select = re_comp_new((re_comp) { .elem = re_exp_new((re_exp) { .tag = dot_exp }), .next = NULL })
+		});
+	}
+	else alt = ((re_exp**)alts.content)[count - 1];
+
+	/* the alternatives start with different bytes, so their order is free */
+	for (int i = count - 2; i >= 0; --i) {
+		alt = re_exp_new((re_exp) {
+			.tag             = bar_exp,
+			.op.barExp.left  = re_comp_new((re_comp) { .elem = ((re_exp**)alts.content)[i], .next = NULL }),
+			.op.barExp.right = re_comp_new((re_comp) { .elem = alt, .next = NULL })
+		});
+	}
+
+	free(merged.content);
+	free(seqs.content);
+	free(alts.content);
+	return alt;
+}
+
+/* the bytes of a code point, in a row */
+static re_exp* re_utf8_string(int cp)
+{
+	unsigned char bytes[4];
+	re_comp* head = NULL;
+
+	for (int i = re_utf8_encode(cp, bytes) - 1; i >= 0; --i)
+		head = re_comp_new((re_comp) { .elem = re_utf8_byte(bytes[i], bytes[i]), .next = head });
+	return re_exp_new((re_exp) { .tag = plain_exp, .op.plainExp = head });
+}
+
 re_exp*
 re_compute(re_parse_t* pr)
 {
@@ -1341,8 +1839,7 @@ re_compute(re_parse_t* pr)
     {
 		/* state stack should not be empty here */
 		if (pr->ststack.count < 1) {
-			fprintf(stderr, "empty state stack!");
-			exit(EXIT_FAILURE);
+			re_error("empty state stack!\n");
 		}
 
 		/* set all the values for this round */
@@ -1375,11 +1872,12 @@ re_compute(re_parse_t* pr)
 				/* push next state to state stack */
                 m_stack_push(&(pr->ststack), &(pr->next.op.shift));
 				
-				/* create new regex S->END by char */
-				retmp1 = re_exp_new((re_exp) {
-					.tag = char_exp,
-					.op.charExp = pr->scanner->lastchar
-				});
+				/* create new regex S->END by char; only a multibyte one needs a node of its own */
+				retmp1 = re_char_new(pr->scanner->lastchar);
+				if (pr->scanner->lastcode >= 0) {
+					retmp1 = re_exp_new(*retmp1);
+					re_ucs_set(pr, retmp1, pr->scanner->lastcode, pr->scanner->lastcode);
+				}
 
 				/* push this new regex to regex stack */
                 m_stack_push(&(pr->restack), &retmp1);
@@ -1405,10 +1903,7 @@ re_compute(re_parse_t* pr)
 					case 11:
 					case 36:
 						/* empty statement */
-						retmp1 = re_exp_new((re_exp) {
-							.tag = empty_exp,
-							.op.emptyExp = 0
-						});
+						retmp1 = &re_empty;
 						break;
 
 					case 45:
@@ -1444,6 +1939,15 @@ re_compute(re_parse_t* pr)
 							.op.rangeExp.min = retmp2->op.charExp,
 							.op.rangeExp.max = retmp3->op.charExp
 						});
+
+						/* a range with a multibyte end is one of code points */
+						if (re_ucs_find(pr, retmp2) || re_ucs_find(pr, retmp3)) {
+							re_ucs* lo = re_ucs_find(pr, retmp2);
+							re_ucs* hi = re_ucs_find(pr, retmp3);
+							re_ucs_set(pr, retmp1,
+								lo ? lo->min : (unsigned char)retmp2->op.charExp,
+								hi ? hi->max : (unsigned char)retmp3->op.charExp);
+						}
 						break;
 
 					case 38:
@@ -1478,8 +1982,7 @@ re_compute(re_parse_t* pr)
 							retmp1 = retmp3;
 						}
 						else {
-							fprintf(stderr, "incorrect type\n");
-							exit(EXIT_FAILURE);
+							re_error("incorrect type\n");
 						}
 						break;
 
@@ -1509,33 +2012,23 @@ re_compute(re_parse_t* pr)
 							retmp1 = retmp3;
 						}
 						else {
-							fprintf(stderr, "incorrect type\n");
-							exit(EXIT_FAILURE);
+							re_error("incorrect type\n");
 						}
 						break;
 
 					case 33:
 						m_stack_pop(&(pr->restack));
-						retmp1 = re_exp_new((re_exp) {
-							.tag = char_exp,
-							.op.charExp = '\t'
-						});
+						retmp1 = re_char_new('\t');
 						break;
 
 					case 32:
 						m_stack_pop(&(pr->restack));
-						retmp1 = re_exp_new((re_exp) {
-							.tag = char_exp,
-							.op.charExp = '\r'
-						});
+						retmp1 = re_char_new('\r');
 						break;
 						
 					case 31:
 						m_stack_pop(&(pr->restack));
-						retmp1 = re_exp_new((re_exp) {
-							.tag = char_exp,
-							.op.charExp = '\n'
-						});
+						retmp1 = re_char_new('\n');
 						break;
 					
 					case 30:
@@ -1578,12 +2071,25 @@ re_compute(re_parse_t* pr)
 						retmp2 = *(re_exp**)m_stack_pop(&(pr->restack)); // slc, re
 						m_stack_pop(&(pr->restack));
 						retmp1 = retmp2;
+
+						if (retmp2->tag == select_exp) {
+							for (re_comp* iter = retmp2->op.selectExp.select; iter; iter = iter->next) {
+								if (re_ucs_find(pr, iter->elem)) {
+									retmp1 = re_utf8_class(pr, retmp2);
+									break;
+								}
+							}
+						}
 						break;
 
 					case 12:
 						/* sub <- elm */
 						retmp2 = *(re_exp**)m_stack_pop(&(pr->restack));
 						retmp1 = retmp2;
+
+						/* outside a class, a multibyte char is its bytes in a row */
+						if (re_ucs_find(pr, retmp2))
+							retmp1 = re_utf8_string(re_ucs_find(pr, retmp2)->min);
 						break;
 
 					case 10:
@@ -1638,13 +2144,11 @@ re_compute(re_parse_t* pr)
 										break;
 									
 									default:
-										fprintf(stderr, "incorrect type\n");
-										exit(EXIT_FAILURE);
+										re_error("incorrect type\n");
 								}
 							}
 							else {
-								fprintf(stderr, "incorrect type\n");
-								exit(EXIT_FAILURE);
+								re_error("incorrect type\n");
 							}
 						}
 						break;
@@ -1658,14 +2162,13 @@ re_compute(re_parse_t* pr)
 						
 						assert(retmp3->tag == plain_exp || retmp3->tag == empty_exp);
 						
+						/* the sequence node is reused, so a long sequence costs one node per step */
 						if (retmp3->tag == plain_exp) {
-							retmp1 = re_exp_new((re_exp) {
-								.tag         = plain_exp,
-								.op.plainExp = re_comp_new((re_comp) {
-									.elem = retmp2,
-									.next = retmp3->op.plainExp
-								})
+							retmp3->op.plainExp = re_comp_new((re_comp) {
+								.elem = retmp2,
+								.next = retmp3->op.plainExp
 							});
+							retmp1 = retmp3;
 						}
 						else
 						if (retmp3->tag == empty_exp) {
@@ -1678,8 +2181,7 @@ re_compute(re_parse_t* pr)
 							});
 						}
 						else {
-							fprintf(stderr, "incorrect type\n");
-							exit(EXIT_FAILURE);
+							re_error("incorrect type\n");
 						}
 						break;
 
@@ -1692,16 +2194,14 @@ re_compute(re_parse_t* pr)
 						assert(retmp2->tag == plain_exp);
 						assert(retmp3->tag == bar_exp || retmp3->tag == empty_exp);
 
+						/* the re' below becomes this alternative's link in the chain */
 						if (retmp3->tag == bar_exp) {
+							retmp3->op.barExp.left = retmp2->op.plainExp;
 							retmp1 = re_exp_new((re_exp) {
 								.tag             = bar_exp,
 								.op.barExp.left  = NULL,
 								.op.barExp.right = re_comp_new((re_comp) {
-									.elem = re_exp_new((re_exp) {
-										.tag             = bar_exp,
-										.op.barExp.left  = retmp2->op.plainExp,
-										.op.barExp.right = retmp3->op.barExp.right
-									}),
+									.elem = retmp3,
 									.next = NULL
 								})
 							});
@@ -1737,8 +2237,7 @@ re_compute(re_parse_t* pr)
 						break;
 
 					default:
-						fprintf(stderr, "state out of range.\n");
-						exit(EXIT_FAILURE);
+						re_error("state out of range.\n");
 				}
 
 				/*if (retmp2) {
@@ -1765,8 +2264,7 @@ re_compute(re_parse_t* pr)
 				if (pr->next.action == GOTO) {
 					m_stack_push(&(pr->ststack), &(pr->next.op.sgoto));
 				} else {
-					fprintf(stderr, "invalid token \"%s\" in state#%d.\n", re_tk_string(pr->next.op.reduce.lhs_tok), tos);
-					exit(EXIT_FAILURE);
+					re_error("invalid token \"%s\" in state#%d.\n", re_tk_string(pr->next.op.reduce.lhs_tok), tos);
 				}
 
 				//printf("\n");
@@ -1784,208 +2282,1962 @@ re_compute(re_parse_t* pr)
                 return retmp1;
 
             case ERROR:
-                fprintf(stderr, "invalid token \"%s\" in state#%d.\n", re_tk_string(a), tos);
-                exit(EXIT_FAILURE);
+                re_error("invalid token \"%s\" in state#%d.\n", re_tk_string(a), tos);
 		}
     }
 }
 
-/* utility concat function */
-char* re_strcat(char* dst, char* src) {
-	char* buf = NULL;
-	int dlen = strlen(dst);
-	int slen = strlen(src);
-
-	if (slen == 0) return dst;
+/**
+ * case folding, for -i: letters become two-member classes and class
+ * members gain their other case, so nothing is lowered while matching
+ * and the automaton sees no more states than it would for the classes.
+ */
+bool re_nocase = false;
 
-	buf = realloc(dst, (dlen + slen + 1) * sizeof(char));
-	
-	if (buf) {
-		dst = buf;
-		memcpy(dst+dlen, src, slen);
-		printf("Result: %s\n", dst);
-		return dst;
-	} else return NULL;
-}
+#define re_is_lower(c) ((c) >= 'a' && (c) <= 'z')
+#define re_is_upper(c) ((c) >= 'A' && (c) <= 'Z')
+#define re_other_case(c) (re_is_lower(c) ? (c) - 'a' + 'A' : (c) - 'A' + 'a')
 
-#define PAD_COUNT 4
-#define re_write(f, str, space) do {\
-	for (int i = 0; i < ((space) * PAD_COUNT); ++i)\
-		fwrite(" ", sizeof(char), 1, (fptr));\
-	fwrite((str), sizeof(char), strlen((str)), (f));\
-} while (0);
+static void re_fold_seq(re_comp* comp);
 
-#define ch_to_str(ch) ((ch) == '\n' ? "\\n" : ((ch) == '\t' ? "\\t" : ((ch) == '\r' ? "\\r" : ((ch) == '\"' ? "\\\"" : ((ch) == '\'' ? "\\\'" : ((ch) == '\\' ? "\\\\" : (char[]){(ch), 0}))))))
+/* add the other case of a class member's letters to the class */
+static void re_fold_member(re_comp* at)
+{
+	int lo, hi;
+	re_exp* m = at->elem;
+	static const char bounds[2][2] = { { 'a', 'z' }, { 'A', 'Z' } };
+
+	if (m->tag == char_exp && (re_is_lower(m->op.charExp) || re_is_upper(m->op.charExp))) {
+		at->next = re_comp_new((re_comp) {
+			.elem = re_char_new(re_other_case(m->op.charExp)),
+			.next = at->next
+		});
+		return;
+	}
+	if (m->tag != range_exp)
+		return;
+
+	/* the part of the range inside each case, moved to the other */
+	for (int i = 0; i < 2; ++i) {
+		lo = (unsigned char)m->op.rangeExp.min > bounds[i][0] ? (unsigned char)m->op.rangeExp.min : bounds[i][0];
+		hi = (unsigned char)m->op.rangeExp.max < bounds[i][1] ? (unsigned char)m->op.rangeExp.max : bounds[i][1];
+		if (lo > hi)
+			continue;
+		at->next = re_comp_new((re_comp) {
+			.elem = re_exp_new((re_exp) {
+				.tag             = range_exp,
+				.op.rangeExp.min = re_other_case(lo),
+				.op.rangeExp.max = re_other_case(hi)
+			}),
+			.next = at->next
+		});
+		at = at->next;
+	}
+}
 
-/* get string form of regular expression */
-void re_conv(re_exp* re, FILE* fptr, int space)
+/* a char node is shared, so a letter is replaced by a class rather than changed */
+static re_exp* re_fold_exp(re_exp* re)
 {
-	int k         = 0;
-	int curspace  = 0;
-	int depth     = 0;
-	re_exp* curr  = NULL;
-	bool pol      = false;
-	re_comp* iter = NULL;
+	re_comp* iter;
+	re_comp* next;
+	re_exp* root = re;
 
 	switch (re->tag)
 	{
 		case char_exp:
-			re_write(fptr, "save_bool(ch == \'", space);
-			re_write(fptr, ch_to_str(re->op.charExp), 0);
-			re_write(fptr, "\');\n", 0);
-			re_write(fptr, "ch = scan();\n", space);
+			if (!re_is_lower(re->op.charExp) && !re_is_upper(re->op.charExp))
+				break;
+			iter = re_comp_new((re_comp) { .elem = re, .next = NULL });
+			re_fold_member(iter);
+			return re_exp_new((re_exp) { .tag = select_exp, .op.selectExp.pos = 1, .op.selectExp.select = iter });
+
+		case select_exp:
+			/* members added behind a member are skipped over */
+			for (iter = re->op.selectExp.select; iter; iter = next) {
+				next = iter->next;
+				re_fold_member(iter);
+			}
 			break;
 
-		case dot_exp:
-			re_write(fptr, "save_bool(true);\n", space);
-			re_write(fptr, "ch = scan();\n", space);
+		case plain_exp:
+		case kleene_exp:
+		case rep_exp:
+		case opt_exp:
+			re_fold_seq(re->op.plainExp);
 			break;
 
-		case range_exp:
-			re_write(fptr, "save_bool(ch >= \'", space);
-			re_write(fptr, ch_to_str(re->op.rangeExp.min), 0);
-			re_write(fptr, "\' && ch <= \'", 0);
-			re_write(fptr, ch_to_str(re->op.rangeExp.max), 0);
-			re_write(fptr, "\');\n", 0);
-			re_write(fptr, "ch = scan();\n", space);
+		case bar_exp:
+			for (; re_bar_chained(re->op.barExp.right); re = re->op.barExp.right->elem)
+				re_fold_seq(re->op.barExp.left);
+			re_fold_seq(re->op.barExp.left);
+			re_fold_seq(re->op.barExp.right);
 			break;
 
-		case empty_exp:
-			re_write(fptr, "save_bool(true);\n", space);
+		default:
 			break;
+	}
+	return root;
+}
 
-		case kleene_exp:
-		case rep_exp:
-			re_write(fptr, "save_pos();\n", space);
-			re_write(fptr, "new_counter();\n", space);
-			re_write(fptr, "while (true) {\n", space);
-			
-			re_conv(re_exp_new((re_exp) {
-				.tag = plain_exp,
-				.op.plainExp = re->tag == kleene_exp ? re->op.kleeneExp : re->op.repExp
-			}), fptr, space + 1);
+static void re_fold_seq(re_comp* comp)
+{
+	for (; comp; comp = comp->next)
+		comp->elem = re_fold_exp(comp->elem);
+}
 
-			re_write(fptr, "if (!load_bool()) {\n", space + 1);
-			re_write(fptr, "ch = prev_pos();\n", space + 2);
-			re_write(fptr, "break;\n", space + 1);
-			re_write(fptr, "} else {\n", space + 2);
-			re_write(fptr, "save_pos();\n", space + 2);
-			re_write(fptr, "inc_counter();\n", space + 2);
-			re_write(fptr, "}\n", space + 1);
+/* fold case in a tree from re_compute when -i is on, before re_optimize */
+re_exp* re_fold(re_exp* re)
+{
+	return re_nocase ? re_fold_exp(re) : re;
+}
 
-			re_write(fptr, "} save_bool(count() > ", space);
-			re_write(fptr, re->tag == kleene_exp ? "-1" : "0", 0);
-			re_write(fptr, ");\n", 0);
+#undef re_is_lower
+#undef re_is_upper
+#undef re_other_case
 
+/**
+ * optimisation passes, run on the tree from re_compute before any code
+ * is generated. every rewrite keeps the matching behaviour of re_conv:
+ *   - nested sequences are flattened, and empty steps dropped from them
+ *   - a quantifier of a quantifier collapses into one, so (a*)* is a*
+ *   - class members are sorted, and overlapping ranges merged
+ *   - leading steps shared by neighbouring alternatives are factored out
+ *   - runs of chars become a single str_exp literal
+ *   - runs of literal alternatives become a single trie_exp
+ */
+
+bool re_comp_equal(re_comp* a, re_comp* b);
+
+bool re_exp_equal(re_exp* a, re_exp* b)
+{
+	if (a->tag != b->tag)
+		return false;
+
+	switch (a->tag)
+	{
+		case char_exp:
+			return a->op.charExp == b->op.charExp;
+
+		case str_exp:
+			return a->op.strExp.len == b->op.strExp.len
+			    && !memcmp(a->op.strExp.str, b->op.strExp.str, a->op.strExp.len);
+
+		case range_exp:
+			return a->op.rangeExp.min == b->op.rangeExp.min
+			    && a->op.rangeExp.max == b->op.rangeExp.max;
+
+		case select_exp:
+			return a->op.selectExp.pos == b->op.selectExp.pos
+			    && re_comp_equal(a->op.selectExp.select, b->op.selectExp.select);
+
+		case bar_exp:
+			while (re_bar_chained(a->op.barExp.right) && re_bar_chained(b->op.barExp.right)) {
+				if (!re_comp_equal(a->op.barExp.left, b->op.barExp.left))
+					return false;
+				a = a->op.barExp.right->elem;
+				b = b->op.barExp.right->elem;
+			}
+			return re_comp_equal(a->op.barExp.left, b->op.barExp.left)
+			    && re_comp_equal(a->op.barExp.right, b->op.barExp.right);
+
+		case kleene_exp:
+		case rep_exp:
+		case opt_exp:
+		case plain_exp:
+			return re_comp_equal(a->op.kleeneExp, b->op.kleeneExp);
+
+		case trie_exp:
+			return re_comp_equal(a->op.trieExp, b->op.trieExp);
+
+		default:
+			return true;
+	}
+}
+
+bool re_comp_equal(re_comp* a, re_comp* b)
+{
+	for (; a && b; a = a->next, b = b->next)
+		if (!re_exp_equal(a->elem, b->elem))
+			return false;
+	return a == b;
+}
+
+/**
+ * the shortest and longest input a tree can consume; max is -1 when
+ * unbounded. an element that fails at the end of the input counts as
+ * consuming a char, so min is the length below which nothing matches.
+ */
+void re_exp_len(re_exp* re, int* min, int* max)
+{
+	int lo, hi, l2, h2;
+	re_comp* iter;
+
+	switch (re->tag)
+	{
+		case char_exp:
+		case range_exp:
+		case select_exp:
+		case dot_exp:
+			*min = *max = 1;
+			break;
+
+		case str_exp:
+			*min = *max = re->op.strExp.len;
+			break;
+
+		case empty_exp:
+			*min = *max = 0;
+			break;
+
+		case plain_exp:
+			*min = *max = 0;
+			for (iter = re->op.plainExp; iter; iter = iter->next) {
+				re_exp_len(iter->elem, &lo, &hi);
+				*min += lo;
+				*max  = (*max == -1 || hi == -1) ? -1 : *max + hi;
+			}
+			break;
+
+		case bar_exp:
+			if (!(re->op.barExp.left && re->op.barExp.right)) {
+				re_exp_len(&(re_exp){ .tag = plain_exp, .op.plainExp = re->op.barExp.left ? re->op.barExp.left : re->op.barExp.right }, min, max);
+				break;
+			}
+			re_exp_len(&(re_exp){ .tag = plain_exp, .op.plainExp = re->op.barExp.left }, min, max);
+			for (; re_bar_chained(re->op.barExp.right); re = re->op.barExp.right->elem) {
+				re_exp_len(&(re_exp){ .tag = plain_exp, .op.plainExp = re->op.barExp.right->elem->op.barExp.left }, &lo, &hi);
+				*min = MIN(*min, lo);
+				*max = (*max == -1 || hi == -1) ? -1 : MAX(*max, hi);
+			}
+			re_exp_len(&(re_exp){ .tag = plain_exp, .op.plainExp = re->op.barExp.right }, &l2, &h2);
+			*min = MIN(*min, l2);
+			*max = (*max == -1 || h2 == -1) ? -1 : MAX(*max, h2);
+			break;
+
+		case kleene_exp:
+		case rep_exp:
+		case opt_exp:
+			re_exp_len(&(re_exp){ .tag = plain_exp, .op.plainExp = re->op.kleeneExp }, &lo, &hi);
+			*min = re->tag == rep_exp ? lo : 0;
+			*max = re->tag == opt_exp || hi == 0 ? hi : -1;
+			break;
+
+		case trie_exp:
+			*min = INT_MAX;
+			*max = 0;
+			for (iter = re->op.trieExp; iter; iter = iter->next) {
+				re_exp_len(iter->elem, &lo, &hi);
+				*min = MIN(*min, lo);
+				*max = MAX(*max, hi);
+			}
+			break;
+	}
+}
+
+/* append to a list kept as head and tail pointers */
+static void re_comp_append(re_comp** head, re_comp** tail, re_exp* re)
+{
+	re_comp* node = re_comp_new((re_comp) { .elem = re, .next = NULL });
+	if (*tail) (*tail)->next = node;
+	else *head = node;
+	*tail = node;
+}
+
+static re_exp* re_str_new(char* str, int len)
+{
+	if (len == 1)
+		return re_char_new(str[0]);
+	return re_exp_new((re_exp) { .tag = str_exp, .op.strExp.str = str, .op.strExp.len = len });
+}
+
+/* join neighbouring chars and literals of a sequence into one literal, in place */
+static re_comp* re_opt_literals(re_comp* comp)
+{
+	int len;
+	re_comp* at;
+	re_comp* run;
+
+	for (at = comp; at; at = run)
+	{
+		len = 0;
+		for (run = at; run && (run->elem->tag == char_exp || run->elem->tag == str_exp); run = run->next)
+			len += run->elem->tag == char_exp ? 1 : run->elem->op.strExp.len;
+
+		if (run == at || run == at->next) {
+			run = at->next;
+			continue;
+		}
+
+		/* the first step of the run takes the literal, and the rest are dropped */
+		char* str = (char*)m_arena_alloc(&re_arena, len);
+		len = 0;
+		for (re_comp* iter = at; iter != run; iter = iter->next) {
+			if (iter->elem->tag == char_exp) {
+				str[len++] = iter->elem->op.charExp;
+			} else {
+				memcpy(str + len, iter->elem->op.strExp.str, iter->elem->op.strExp.len);
+				len += iter->elem->op.strExp.len;
+			}
+		}
+		at->elem = re_str_new(str, len);
+		at->next = run;
+	}
+
+	return comp;
+}
+
+re_exp* re_optimize(re_exp* re);
+
+/**
+ * optimise every step of a sequence, splicing nested sequences in. the
+ * steps are relinked rather than copied, as every list belongs to the one
+ * node that holds it.
+ */
+static re_comp* re_opt_seq(re_comp* comp)
+{
+	re_exp* re;
+	re_comp* next;
+	re_comp* head = NULL;
+	re_comp* tail = NULL;
+
+	for (; comp; comp = next)
+	{
+		next = comp->next;
+		re   = re_optimize(comp->elem);
+
+		if (re->tag == plain_exp) {
+			if (tail) tail->next = re->op.plainExp;
+			else head = re->op.plainExp;
+			for (tail = re->op.plainExp; tail->next; tail = tail->next);
+		}
+		else if (re->tag != empty_exp) {
+			comp->elem = re;
+			if (tail) tail->next = comp;
+			else head = comp;
+			tail = comp;
+		}
+	}
+
+	if (head == NULL)
+		return re_comp_new((re_comp) { .elem = &re_empty, .next = NULL });
+	tail->next = NULL;
+
+	return re_opt_literals(head);
+}
+
+/* a sequence as a single tree, unwrapping it when it has one step */
+static re_exp* re_seq_exp(re_comp* comp)
+{
+	if (comp->next == NULL)
+		return comp->elem;
+	return re_exp_new((re_exp) { .tag = plain_exp, .op.plainExp = comp });
+}
+
+/* sort and merge the members of a class */
+static re_exp* re_opt_select(re_exp* re)
+{
+	int count;
+	bool any;
+	re_comp* iter;
+	re_comp* spare;
+	re_comp* head = NULL;
+	re_comp* tail = NULL;
+	unsigned char lo[256];
+	unsigned char hi[256];
+	bool in[256];
+
+	any = false;
+	memset(in, 0, sizeof(in));
+	for (iter = re->op.selectExp.select; iter; iter = iter->next) {
+		re_exp* m = iter->elem;
+		if (m->tag == dot_exp)
+			any = true;
+		else if (m->tag == char_exp)
+			in[(unsigned char)m->op.charExp] = true;
+		else if (m->tag == range_exp)
+			for (int c = (unsigned char)m->op.rangeExp.min; c <= (unsigned char)m->op.rangeExp.max; ++c)
+				in[c] = true;
+	}
+
+	/* a class with '.' in it takes any char, and one char is just that char */
+	if (any) {
+		if (re->op.selectExp.pos)
+			return re_exp_new((re_exp) { .tag = dot_exp, .op.dotExp = 0 });
+		re_comp_append(&head, &tail, re_exp_new((re_exp) { .tag = dot_exp, .op.dotExp = 0 }));
+		return re_exp_new((re_exp) { .tag = select_exp, .op.selectExp.pos = 0, .op.selectExp.select = head });
+	}
+
+	/* ranges never straddle 0x7f/0x80, so they compare right with a signed char */
+	count = 0;
+	for (int c = 1; c < 256; ++c) {
+		if (in[c] && (c == 0x80 || !in[c-1])) lo[count] = c;
+		if (in[c] && (c == 0x7f || c == 255 || !in[c+1])) hi[count++] = c;
+	}
+
+	if (re->op.selectExp.pos && count == 1 && lo[0] == hi[0])
+		return re_char_new(lo[0]);
+
+	/* the class is rebuilt in place, its old members' links taken for the new ones */
+	spare = re->op.selectExp.select;
+	for (int i = 0; i < count; ++i) {
+		re_exp* m = lo[i] == hi[i] ? re_char_new(lo[i]) : re_exp_new((re_exp) {
+			.tag             = range_exp,
+			.op.rangeExp.min = lo[i],
+			.op.rangeExp.max = hi[i]
+		});
+
+		if (spare == NULL) {
+			re_comp_append(&head, &tail, m);
+			continue;
+		}
+		iter        = spare;
+		spare       = spare->next;
+		iter->elem  = m;
+		iter->next  = NULL;
+		if (tail) tail->next = iter;
+		else head = iter;
+		tail = iter;
+	}
+
+	re->op.selectExp.select = head;
+	return re;
+}
+
+/* collect the alternatives of a chain of bar_exp nodes, optimised */
+static void re_opt_alts(re_exp* re, m_stack* alts)
+{
+	re_comp* seq;
+	re_comp* side;
+	m_stack todo = m_stack_init(re_comp*);
+
+	/* sides still to take apart, the leftmost on top */
+	m_stack_push(&todo, &re->op.barExp.right);
+	m_stack_push(&todo, &re->op.barExp.left);
+	while (todo.count > 0)
+	{
+		side = *(re_comp**)m_stack_pop(&todo);
+		if (side == NULL)
+			continue;
+
+		if (side->next == NULL && side->elem->tag == bar_exp)
+			re = side->elem;
+		else if ((seq = re_opt_seq(side))->next == NULL && seq->elem->tag == bar_exp)
+			re = seq->elem;
+		else {
+			m_stack_push(alts, &seq);
+			continue;
+		}
+		m_stack_push(&todo, &re->op.barExp.right);
+		m_stack_push(&todo, &re->op.barExp.left);
+	}
+
+	free(todo.content);
+}
+
+/* split the first char off a sequence, so literals can share prefixes */
+static re_exp* re_seq_head(re_comp* seq, re_comp** rest)
+{
+	re_exp* re = seq->elem;
+
+	if (re->tag == empty_exp) {
+		*rest = NULL;
+		return NULL;
+	}
+
+	if (re->tag == str_exp) {
+		*rest = re_comp_new((re_comp) {
+			.elem = re_str_new(re->op.strExp.str + 1, re->op.strExp.len - 1),
+			.next = seq->next
+		});
+		return re_char_new(re->op.strExp.str[0]);
+	}
+
+	*rest = seq->next;
+	return re;
+}
+
+static re_exp* re_opt_factor(re_comp** alts, int count);
+
+/* rebuild an ordered choice from a run of alternatives, last link first */
+static re_exp* re_bar_build(re_comp** alts, int count)
+{
+	int i;
+	re_exp* res;
+	re_comp* head = NULL;
+	re_comp* tail = NULL;
+
+	/* a choice between single chars ending the run is one bracket test */
+	for (i = count; i > 0; --i)
+		if (alts[i-1]->next || alts[i-1]->elem->tag != char_exp)
+			break;
+	if (count - i >= 2) {
+		for (int k = i; k < count; ++k)
+			re_comp_append(&head, &tail, alts[k]->elem);
+		res = re_opt_select(re_exp_new((re_exp) {
+			.tag                 = select_exp,
+			.op.selectExp.pos    = true,
+			.op.selectExp.select = head
+		}));
+	}
+	else res = re_seq_exp(alts[i = count - 1]);
+
+	while (i-- > 0) {
+		res = re_exp_new((re_exp) {
+			.tag             = bar_exp,
+			.op.barExp.left  = alts[i],
+			.op.barExp.right = re_comp_new((re_comp) { .elem = res, .next = NULL })
+		});
+	}
+	return res;
+}
+
+/**
+ * a|b is tried left to right, and every step is deterministic, so
+ * neighbouring alternatives that start with the same step can share it:
+ * xa|xb|c becomes x(a|b)|c without changing what matches.
+ */
+static re_exp* re_opt_factor(re_comp** alts, int count)
+{
+	int i, j, n;
+	re_exp* head;
+	re_comp* rest;
+	re_comp* other;
+	re_comp** out;
+	re_comp** rests;
+
+	out = (re_comp**)m_arena_alloc(&re_arena, count * sizeof(re_comp*));
+	n   = 0;
+
+	for (i = 0; i < count; i = j)
+	{
+		head = re_seq_head(alts[i], &rest);
+
+		for (j = i + 1; head && j < count; ++j) {
+			re_exp* h = re_seq_head(alts[j], &other);
+			if (h == NULL || !re_exp_equal(head, h))
+				break;
+		}
+
+		if (j - i < 2) {
+			out[n++] = alts[i];
+			j = i + 1;
+			continue;
+		}
+
+		rests = (re_comp**)m_arena_alloc(&re_arena, (j - i) * sizeof(re_comp*));
+		for (int k = i; k < j; ++k) {
+			re_seq_head(alts[k], &other);
+			rests[k - i] = other ? other : re_comp_new((re_comp) {
+				.elem = &re_empty,
+				.next = NULL
+			});
+		}
+
+		/* the shared step, then whatever is left of the choice */
+		re_exp* tailexp = re_opt_factor(rests, j - i);
+		re_comp* seq    = re_comp_new((re_comp) {
+			.elem = head,
+			.next = tailexp->tag == plain_exp ? tailexp->op.plainExp : re_comp_new((re_comp) {
+				.elem = tailexp,
+				.next = NULL
+			})
+		});
+		out[n++] = re_opt_literals(seq);
+	}
+
+	return re_bar_build(out, n);
+}
+
+/* a literal alternative: one string, one char or nothing at all */
+static bool re_alt_literal(re_comp* alt)
+{
+	return alt->next == NULL && (alt->elem->tag == str_exp || alt->elem->tag == char_exp || alt->elem->tag == empty_exp);
+}
+
+/**
+ * runs of neighbouring literal alternatives become one trie_exp, which
+ * re_conv turns into nested switches reading each input byte once. runs
+ * of single chars are left alone, as re_bar_build makes a bracket of them.
+ */
+static int re_opt_trie(re_comp** alts, int count)
+{
+	int i, j, n;
+	bool strs;
+	re_comp* head;
+	re_comp* tail;
+
+	for (i = n = 0; i < count; i = j)
+	{
+		strs = false;
+		for (j = i; j < count && re_alt_literal(alts[j]); ++j)
+			strs |= alts[j]->elem->tag == str_exp;
+
+		if (j - i < 2 || !strs) {
+			j = MAX(j, i + 1);
+			while (i < j)
+				alts[n++] = alts[i++];
+			continue;
+		}
+
+		head = tail = NULL;
+		for (; i < j; ++i)
+			re_comp_append(&head, &tail, alts[i]->elem);
+		alts[n++] = re_comp_new((re_comp) {
+			.elem = re_exp_new((re_exp) { .tag = trie_exp, .op.trieExp = head }),
+			.next = NULL
+		});
+	}
+
+	return n;
+}
+
+/* which single quantifier a quantified quantifier amounts to */
+static int re_opt_quant(int outer, int inner)
+{
+	return outer == inner ? outer : kleene_exp;
+}
+
+re_exp* re_optimize(re_exp* re)
+{
+	re_comp* body;
+	m_stack alts;
+	re_exp* res;
+
+	switch (re->tag)
+	{
+		case plain_exp:
+			return re_seq_exp(re_opt_seq(re->op.plainExp));
+
+		case kleene_exp:
+		case rep_exp:
+		case opt_exp:
+			body = re_opt_seq(re->op.kleeneExp);
+			res  = re;
+			res->op.kleeneExp = body;
+
+			while (body->next == NULL) {
+				re_exp* inner = body->elem;
+				if (inner->tag == empty_exp)
+					return inner;
+				if (inner->tag != kleene_exp && inner->tag != rep_exp && inner->tag != opt_exp)
+					break;
+				res->tag = re_opt_quant(res->tag, inner->tag);
+				body     = inner->op.kleeneExp;
+				res->op.kleeneExp = body;
+			}
+			return res;
+
+		case select_exp:
+			return re_opt_select(re);
+
+		case bar_exp:
+			alts = m_stack_init(re_comp*);
+			re_opt_alts(re, &alts);
+			alts.count = re_opt_trie((re_comp**)alts.content, alts.count);
+			res = re_opt_factor((re_comp**)alts.content, alts.count);
+			free(alts.content);
+			return res;
+
+		default:
+			return re;
+	}
+}
+
+/* run the whole front end over a pattern string */
+re_exp* re_read(char* regstr)
+{
+	re_exp* rexpr;
+	re_scan_t scptr;
+	re_parse_t psptr;
+
+	if (re_arena.block_size == 0)
+		re_arena = m_arena_init();
+
+	scptr = re_scan_init(regstr);
+	psptr = re_parse_init(&scptr);
+	rexpr = re_optimize(re_fold(re_compute(&psptr)));
+	re_parse_free(&psptr);
+
+	return rexpr;
+}
+
+#define PAD_COUNT 4
+#define re_write(f, str, space) do {\
+	m_buffer_pad((f), (space) * PAD_COUNT);\
+	m_buffer_puts((f), (str));\
+} while (0);
+
+#define ch_to_str(ch) ((ch) == '\n' ? "\\n" : ((ch) == '\t' ? "\\t" : ((ch) == '\r' ? "\\r" : ((ch) == '\"' ? "\\\"" : ((ch) == '\'' ? "\\\'" : ((ch) == '\\' ? "\\\\" : re_ch_str((ch), (char[5]){0})))))))
+
+/* a char as it goes between quotes; high bytes are written in octal */
+static char* re_ch_str(char ch, char* buf)
+{
+	if (isprint((unsigned char)ch))
+		buf[0] = ch, buf[1] = '\0';
+	else snprintf(buf, 5, "\\%03o", (unsigned char)ch);
+	return buf;
+}
+
+void re_write_string(m_buffer* out, char* str, size_t len);
+
+/* whether the matcher being written keeps the current char in ch */
+static bool re_conv_ch = true;
+
+/* whether a tree tests chars, so its matcher needs ch at all */
+static bool re_reads_ch(re_exp* re);
+
+static bool re_comp_reads_ch(re_comp* comp)
+{
+	for (; comp; comp = comp->next)
+		if (re_reads_ch(comp->elem))
+			return true;
+	return false;
+}
+
+static bool re_reads_ch(re_exp* re)
+{
+	switch (re->tag)
+	{
+		case char_exp:
+		case range_exp:
+		case select_exp:
+			return true;
+
+		case bar_exp:
+			/* down a chain of alternatives in a loop, as re_conv does */
+			for (;; re = re->op.barExp.right->elem) {
+				if (re_comp_reads_ch(re->op.barExp.left))
+					return true;
+				if (!re_bar_chained(re->op.barExp.right))
+					return re_comp_reads_ch(re->op.barExp.right);
+			}
+
+		case kleene_exp:
+		case rep_exp:
+		case opt_exp:
+		case plain_exp:
+			/* these all keep their body in the same place */
+			return re_comp_reads_ch(re->op.plainExp);
+
+		default:
+			return false;
+	}
+}
+
+/* ch follows the input, or the input just moves when nothing reads ch */
+static void re_conv_step(m_buffer* out, char* to, int space)
+{
+	m_buffer_pad(out, space * PAD_COUNT);
+	if (re_conv_ch)
+		m_buffer_printf(out, "ch = %s;\n", to);
+	else m_buffer_printf(out, "(void)%s;\n", to);
+}
+
+/**
+ * tests of ch. ranges reaching 0x7F and high bytes are compared as
+ * unsigned numbers, so they work whatever the signedness of char and no
+ * test is always true, and a range running up to 0xFF checks for the end
+ * first, where scan() leaves ch at -1.
+ */
+static void re_conv_is(m_buffer* out, char c)
+{
+	if ((unsigned char)c < 0x80)
+		m_buffer_printf(out, "ch == \'%s\'", ch_to_str(c));
+	else m_buffer_printf(out, "(unsigned char)ch == 0x%02X", (unsigned char)c);
+}
+
+static void re_conv_in(m_buffer* out, char min, char max)
+{
+	unsigned char lo = min;
+	unsigned char hi = max;
+
+	if (hi < 0x7F)
+		m_buffer_printf(out, "ch >= \'%s\' && ch <= \'%s\'", ch_to_str(min), ch_to_str(max));
+	else if (hi == 0xFF)
+		m_buffer_printf(out, "!at_end() && (unsigned char)ch >= 0x%02X", lo);
+	else if (lo == 0)
+		m_buffer_printf(out, "(unsigned char)ch <= 0x%02X", hi);
+	else m_buffer_printf(out, "(unsigned char)ch >= 0x%02X && (unsigned char)ch <= 0x%02X", lo, hi);
+}
+
+/**
+ * one node of a literal trie: alts holds the indices, in pattern order,
+ * of the alternatives that reach it. an alternative ending here beats
+ * every later one that goes deeper, so those are dropped; earlier ones
+ * still get their switch, and tlen falls back to this depth if they fail.
+ */
+static void re_conv_trie(char** strs, int* lens, int* alts, int count, int depth, m_buffer* out, int space)
+{
+	int i, j, n;
+	int end = -1;
+	int* live;
+	int* group;
+	int first[257];
+	char buf[64];
+
+	for (i = 0; i < count; ++i)
+		if (lens[alts[i]] == depth && (end == -1 || alts[i] < end))
+			end = alts[i];
+
+	live = (int*)m_arena_alloc(&re_arena, (count + 1) * sizeof(int));
+	for (i = n = 0; i < count; ++i)
+		if (lens[alts[i]] > depth && (end == -1 || alts[i] < end))
+			live[n++] = alts[i];
+
+	if (end != -1) {
+		snprintf(buf, sizeof(buf), "tlen = %d;\n", depth);
+		re_write(out, buf, space);
+	}
+	if (n == 0)
+		return;
+
+	/* a lone alternative has nothing left to share, so compare its tail */
+	if (n == 1 && lens[live[0]] - depth > 1) {
+		snprintf(buf, sizeof(buf), "if (!strncmp(re_strptr + %d, ", depth);
+		re_write(out, buf, space);
+		re_write_string(out, strs[live[0]] + depth, lens[live[0]] - depth);
+		snprintf(buf, sizeof(buf), ", %d))\n", lens[live[0]] - depth);
+		re_write(out, buf, 0);
+		snprintf(buf, sizeof(buf), "tlen = %d;\n", lens[live[0]]);
+		re_write(out, buf, space + 1);
+		return;
+	}
+
+	/**
+	 * one case per distinct next byte, in byte order. the sort is a stable
+	 * counting sort, so each byte's alternatives stay in pattern order and
+	 * ties are settled as the bar would, in time linear in the alternatives.
+	 */
+	memset(first, 0, sizeof(first));
+	for (i = 0; i < n; ++i)
+		first[(unsigned char)strs[live[i]][depth] + 1]++;
+	for (i = 0; i < 256; ++i)
+		first[i + 1] += first[i];
+	group = (int*)m_arena_alloc(&re_arena, n * sizeof(int));
+	for (i = 0; i < n; ++i)
+		group[first[(unsigned char)strs[live[i]][depth]]++] = live[i];
+
+	snprintf(buf, sizeof(buf), "switch (re_strptr[%d]) {\n", depth);
+	re_write(out, buf, space);
+	for (i = 0; i < n; i = j) {
+		char c = strs[group[i]][depth];
+		for (j = i; j < n && strs[group[j]][depth] == c; ++j);
+
+		re_write(out, "case \'", space + 1);
+		re_write(out, ch_to_str(c), 0);
+		re_write(out, "\':\n", 0);
+		re_conv_trie(strs, lens, group + i, j - i, depth + 1, out, space + 2);
+		re_write(out, "break;\n", space + 2);
+	}
+	re_write(out, "}\n", space);
+}
+
+/* get string form of regular expression */
+void re_conv(re_exp* re, m_buffer* out, int space)
+{
+	int k         = 0;
+	int curspace  = 0;
+	int depth     = 0;
+	int min, max;
+	re_exp* curr  = NULL;
+	bool pol      = false;
+	re_comp* iter = NULL;
+
+	switch (re->tag)
+	{
+		case char_exp:
+			re_write(out, "save_bool(", space);
+			re_conv_is(out, re->op.charExp);
+			re_write(out, ");\n", 0);
+			re_conv_step(out, "scan()", space);
+			break;
+
+		case dot_exp:
+			re_write(out, "save_bool(!at_end());\n", space);
+			re_conv_step(out, "scan()", space);
+			break;
+
+		case str_exp:
+			re_write(out, "save_bool(scan_str(", space);
+			re_write_string(out, re->op.strExp.str, re->op.strExp.len);
+			m_buffer_printf(out, ", %d));\n", re->op.strExp.len);
+			if (re_conv_ch)
+				re_write(out, "ch = *re_strptr;\n", space);
+			break;
+
+		case range_exp:
+			re_write(out, "save_bool(", space);
+			re_conv_in(out, re->op.rangeExp.min, re->op.rangeExp.max);
+			re_write(out, ");\n", 0);
+			re_conv_step(out, "scan()", space);
+			break;
+
+		case empty_exp:
+			re_write(out, "save_bool(true);\n", space);
+			break;
+
+		case kleene_exp:
+		case rep_exp:
+			/* a body that can match nothing must not spin in place */
+			re_exp_len(&(re_exp) {
+				.tag = plain_exp,
+				.op.plainExp = re->op.kleeneExp
+			}, &min, &max);
+
+			re_write(out, "save_pos();\n", space);
+			if (re->tag == rep_exp)
+				re_write(out, "new_counter();\n", space);
+			re_write(out, "while (true) {\n", space);
+			
+			re_conv(&(re_exp) {
+				.tag = plain_exp,
+				.op.plainExp = re->tag == kleene_exp ? re->op.kleeneExp : re->op.repExp
+			}, out, space + 1);
+
+			re_write(out, "if (!load_bool()) {\n", space + 1);
+			re_conv_step(out, "prev_pos()", space + 2);
+			re_write(out, "break;\n", space + 2);
+			re_write(out, "} else {\n", space + 1);
+			if (re->tag == rep_exp)
+				re_write(out, "inc_counter();\n", space + 2);
+			if (min == 0) {
+				re_write(out, "if (no_progress()) {\n", space + 2);
+				re_write(out, "drop_pos();\n", space + 3);
+				re_write(out, "break;\n", space + 3);
+				re_write(out, "}\n", space + 2);
+			}
+			re_write(out, "move_pos();\n", space + 2);
+			re_write(out, "}\n", space + 1);
+
+			re_write(out, re->tag == kleene_exp ? "} save_bool(true);\n" : "} save_bool(count() > 0);\n", space);
+
+			break;
+
+		case opt_exp:
+			re_write(out, "save_pos();\n", space);
+			
+			re_conv(&(re_exp) {
+				.tag = plain_exp,
+				.op.plainExp = re->op.optExp
+			}, out, space);
+
+			re_write(out, "if (!load_bool())\n", space);
+			re_conv_step(out, "prev_pos()", space + 1);
+			re_write(out, "else drop_pos();\n", space);
+			re_write(out, "save_bool(true);\n", space);
+			
+			break;
+
+		case select_exp:
+			/* one test of the current char against every member */
+			pol  = re->op.selectExp.pos;
+			iter = re->op.selectExp.select;
+
+			re_write(out, pol ? "save_bool(" : "save_bool(!at_end() && !(", space);
+			if (iter == NULL)
+				re_write(out, "false", 0);
+			for (; iter; iter = iter->next) {
+				curr = iter->elem;
+				if (curr->tag == char_exp)
+					re_conv_is(out, curr->op.charExp);
+				else if (curr->tag == range_exp) {
+					re_write(out, "(", 0);
+					re_conv_in(out, curr->op.rangeExp.min, curr->op.rangeExp.max);
+					re_write(out, ")", 0);
+				}
+				else re_write(out, pol ? "!at_end()" : "true", 0);
+				if (iter->next)
+					re_write(out, " || ", 0);
+			}
+			re_write(out, pol ? ");\n" : "));\n", 0);
+			re_conv_step(out, "scan()", space);
+
+			break;
+
+		case trie_exp:
+			/* gather the alternatives' text, then walk them byte by byte */
+			for (k = 0, iter = re->op.trieExp; iter; iter = iter->next) ++k;
+			{
+				char** strs = (char**)m_arena_alloc(&re_arena, k * sizeof(char*));
+				int* lens   = (int*)m_arena_alloc(&re_arena, k * sizeof(int));
+				int* alts   = (int*)m_arena_alloc(&re_arena, k * sizeof(int));
+
+				for (k = 0, iter = re->op.trieExp; iter; iter = iter->next, ++k) {
+					curr    = iter->elem;
+					alts[k] = k;
+					if (curr->tag == str_exp) {
+						strs[k] = curr->op.strExp.str;
+						lens[k] = curr->op.strExp.len;
+					} else if (curr->tag == char_exp) {
+						strs[k] = &(curr->op.charExp);
+						lens[k] = 1;
+					} else {
+						strs[k] = "";
+						lens[k] = 0;
+					}
+				}
+
+				re_write(out, "{\n", space);
+				re_write(out, "int tlen = -1;\n", space + 1);
+				re_conv_trie(strs, lens, alts, k, 0, out, space + 1);
+				re_write(out, "save_bool(tlen >= 0);\n", space + 1);
+				re_write(out, "if (tlen > 0)\n", space + 1);
+				re_write(out, "re_strptr += tlen;\n", space + 2);
+				if (re_conv_ch)
+					re_write(out, "ch = *re_strptr;\n", space + 1);
+				re_write(out, "}\n", space);
+			}
 			break;
 
-		case opt_exp:
-			re_write(fptr, "save_pos();\n", space);
-			
-			re_conv(re_exp_new((re_exp) {
-				.tag = plain_exp,
-				.op.plainExp = re->tag == kleene_exp ? re->op.kleeneExp : re->op.repExp
-			}), fptr, space);
+		case bar_exp:
+			if (re->op.barExp.left && re->op.barExp.right)
+			{
+				/* one block for the whole chain, left at the first alternative that matches */
+				re_write(out, "do {\n", space);
+				for (;; re = re->op.barExp.right->elem) {
+					re_write(out, "save_pos();\n", space + 1);
+					re_conv(&(re_exp) {
+						.tag = plain_exp,
+						.op.plainExp = re->op.barExp.left
+					}, out, space + 1);
+					re_write(out, "if (load_bool()) {\n", space + 1);
+					re_write(out, "drop_pos();\n", space + 2);
+					re_write(out, "save_bool(true);\n", space + 2);
+					re_write(out, "break;\n", space + 2);
+					re_write(out, "}\n", space + 1);
+					re_conv_step(out, "prev_pos()", space + 1);
+					if (!re_bar_chained(re->op.barExp.right))
+						break;
+				}
+				re_conv(&(re_exp) {
+					.tag = plain_exp,
+					.op.plainExp = re->op.barExp.right
+				}, out, space + 1);
+				re_write(out, "} while (0);\n", space);
+			}
+			else {
+				iter = re->op.barExp.left ? re->op.barExp.left : re->op.barExp.right;
+				re_conv(&(re_exp) {
+					.tag = plain_exp,
+					.op.plainExp = iter
+				}, out, space);
+			}
+			break;
+
+		case plain_exp:
+
+			iter = re->op.plainExp;
+
+			if (iter) {
+				if (iter->next) {
+					re_write(out, "do {\n", space);		
+					while (iter) {
+						re_conv(iter->elem, out, space + 1);
+						re_write(out, "if (!load_bool()) {\n", space + 1);
+						re_write(out, "save_bool(false);\n", space + 2);
+						re_write(out, "break;\n", space + 2);
+						re_write(out, "}\n", space + 1);
+						iter = iter->next;
+					}
+					re_write(out, "save_bool(true);\n", space + 1);
+					re_write(out, "} while (0);\n", space);
+				} else re_conv(iter->elem, out, space);
+			}
+
+			break;
+	}
+}
+
+/**
+ * the whole matcher: inputs shorter than any match are turned away first.
+ * ch is declared here, after the template has set the string up, and only
+ * when something reads it.
+ */
+void re_conv_main(re_exp* re, m_buffer* out, int space)
+{
+	int min, max;
+	char buf[64];
+
+	re_conv_ch = re_reads_ch(re);
+	if (re_conv_ch)
+		re_write(out, "char ch = *re_strptr;\n\n", space);
+
+	re_exp_len(re, &min, &max);
+	if (min == 0)
+		re_conv(re, out, space);
+	else {
+		snprintf(buf, sizeof(buf), "if (strnlen(re_string, %d) < %d) {\n", min, min);
+		re_write(out, buf, space);
+		re_write(out, "save_bool(false);\n", space + 1);
+		re_write(out, "} else {\n", space);
+		re_conv(re, out, space + 1);
+		re_write(out, "}\n", space);
+	}
+	re_conv_ch = true;
+}
+
+/* the matcher as a table-driven automaton, or as code when that is too big */
+void re_conv_tables(re_exp* re, m_buffer* out, int space)
+{
+	re_dfa* dfa = re_dfa_build(&re, 1, 0);
+
+	if (dfa == NULL || re_dfa_emit(dfa, out, space) != EXIT_SUCCESS) {
+		re_write(out, "/* too many states for tables */\n", space);
+		re_conv_main(re, out, space);
+	}
+	if (dfa)
+		re_dfa_free(dfa);
+}
+
+#undef re_write
+#undef ch_to_str
+
+/* write len chars of a string as a C string literal */
+void re_write_string(m_buffer* out, char* str, size_t len)
+{
+	m_buffer_putc(out, '\"');
+	for (size_t i = 0; i < len; ++i) {
+		unsigned char c = str[i];
+		switch (c) {
+			case '\n': m_buffer_puts(out, "\\n"); break;
+			case '\t': m_buffer_puts(out, "\\t"); break;
+			case '\r': m_buffer_puts(out, "\\r"); break;
+			case '\"': m_buffer_puts(out, "\\\""); break;
+			case '\\': m_buffer_puts(out, "\\\\"); break;
+			case '?': m_buffer_puts(out, i + 1 < len && str[i+1] == '?' ? "\\?" : "?"); break;
+			default:
+				if (isprint(c)) m_buffer_putc(out, c);
+				else m_buffer_printf(out, "\\%03o", c);
+		}
+	}
+	m_buffer_putc(out, '\"');
+}
+
+/* read a file, from its start up to where it is positioned, into memory */
+char* re_slurp(FILE* fptr, size_t* len)
+{
+	char* text;
+
+	*len = ftell(fptr);
+	text = (char*)malloc(*len + 1);
+	rewind(fptr);
+	if (fread(text, sizeof(char), *len, fptr) != *len) {
+		free(text);
+		return NULL;
+	}
+	text[*len] = '\0';
+
+	return text;
+}
+
+/**
+ * a template is split once at the lines that hold an input marker, each
+ * a hole that generated code fills. a hole takes the whole line it is on;
+ * pos, the column of its marker, sets the indentation of what goes in it.
+ * filling a template copies the text between holes in one go. the text
+ * is either read from a file, and owned, or built into regexer.
+ */
+typedef struct
+re_hole
+{
+	size_t line;
+	size_t end;
+	int    pos;
+}
+re_hole;
+
+typedef struct
+re_template
+{
+	const char*   text;
+	size_t        len;
+	bool          owned;
+	re_hole*      holes;
+	int           nholes;
+	unsigned long hash;
+}
+re_template;
+
+/* split a template's NUL terminated text into holes */
+re_template re_template_parse(const char* text, size_t len, bool owned)
+{
+	const char* at;
+	re_template t;
+	m_stack holes = m_stack_init(re_hole);
+
+	t.text  = text;
+	t.len   = len;
+	t.owned = owned;
+
+	/* djb2, so editing the template also invalidates cached output */
+	t.hash = 5381;
+	for (size_t i = 0; i < len; ++i)
+		t.hash = ((t.hash << 5) + t.hash) + (unsigned char)text[i];
+
+	for (at = text; (at = strstr(at, "/* input */")) != NULL; ) {
+		re_hole h;
+		const char* eol = strchr(at, '\n');
+
+		h.line = at - text;
+		while (h.line > 0 && text[h.line-1] != '\n')
+			h.line--;
+		h.pos = (int)(at - text - h.line);
+		h.end = eol ? (size_t)(eol - text) + 1 : len;
+		m_stack_push(&holes, &h);
+		at = text + h.end;
+	}
+
+	t.holes  = (re_hole*)holes.content;
+	t.nholes = holes.count;
+	return t;
+}
+
+/* read a template file; false, with errno set, if it cannot be read */
+bool re_template_load(char* path, re_template* t)
+{
+	size_t len;
+	char* text;
+	FILE* fptr = fopen(path, "rb");
+
+	if (fptr == NULL)
+		return false;
+	if (fseek(fptr, 0, SEEK_END) || (text = re_slurp(fptr, &len)) == NULL) {
+		fclose(fptr);
+		return false;
+	}
+	fclose(fptr);
+
+	*t = re_template_parse(text, len, true);
+	return true;
+}
+
+void re_template_free(re_template* t)
+{
+	if (t->owned)
+		free((char*)t->text);
+	free(t->holes);
+}
+
+/* copy the text before hole k, or after the last hole when k is nholes */
+static void re_template_copy(re_template* t, int k, m_buffer* out)
+{
+	size_t from = k > 0 ? t->holes[k-1].end : 0;
+	size_t to   = k < t->nholes ? t->holes[k].line : t->len;
+
+	m_buffer_put(out, t->text + from, to - from);
+}
+
+/**
+ * batch mode: the manifest holds one "name: pattern" pair per line
+ * (blank lines and lines starting with '#' are skipped), and every
+ * pattern becomes a re_match_<name> function in a single output file,
+ * alongside a re_matchers dispatch table sorted by name.
+ */
+typedef struct
+re_entry
+{
+	char* name;
+	char* regex;
+	int   line;
+}
+re_entry;
+
+static int re_entry_comp(const void* a, const void* b)
+{
+	return strcmp(((re_entry*)a)->name, ((re_entry*)b)->name);
+}
+
+m_stack
+re_manifest_load(char* mfname)
+{
+	long size;
+	char* buf;
+	char* line;
+	char* next;
+	int lineno;
+	FILE* mfptr;
+	re_entry ent;
+	m_stack entries;
+
+	mfptr = fopen(mfname, "rb");
+	if (mfptr == NULL) {
+		fprintf(stderr, "could not open manifest \"%s\": %s\n", mfname, strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	/* the manifest is read in one go, and entries point into the buffer */
+	fseek(mfptr, 0, SEEK_END);
+	size = ftell(mfptr);
+	fseek(mfptr, 0, SEEK_SET);
+	buf = (char*)malloc(size + 1);
+	if (fread(buf, sizeof(char), size, mfptr) != (size_t)size) {
+		fprintf(stderr, "could not read manifest \"%s\".\n", mfname);
+		exit(EXIT_FAILURE);
+	}
+	buf[size] = '\0';
+	fclose(mfptr);
+
+	entries = m_stack_init(re_entry);
+	lineno  = 0;
+
+	for (line = buf; line; line = next)
+	{
+		char* colon;
+		size_t len;
+
+		lineno++;
+		if ((next = strchr(line, '\n')) != NULL)
+			*next++ = '\0';
+		len = strlen(line);
+		if (len > 0 && line[len-1] == '\r')
+			line[--len] = '\0';
+		if (len == 0 || line[0] == '#')
+			continue;
+
+		if ((colon = strchr(line, ':')) == NULL) {
+			fprintf(stderr, "%s:%d: expected \"name: pattern\".\n", mfname, lineno);
+			exit(EXIT_FAILURE);
+		}
+
+		*colon = '\0';
+		if (!(isalpha((unsigned char)line[0]) || line[0] == '_')) {
+			fprintf(stderr, "%s:%d: invalid pattern name \"%s\".\n", mfname, lineno, line);
+			exit(EXIT_FAILURE);
+		}
+		for (char* c = line; *c; ++c) {
+			if (!(isalnum((unsigned char)*c) || *c == '_')) {
+				fprintf(stderr, "%s:%d: invalid pattern name \"%s\".\n", mfname, lineno, line);
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		ent.name  = line;
+		ent.regex = colon[1] == ' ' ? colon + 2 : colon + 1;
+		ent.line  = lineno;
+		m_stack_push(&entries, &ent);
+	}
+
+	if (entries.count == 0) {
+		fprintf(stderr, "manifest \"%s\" holds no patterns.\n", mfname);
+		exit(EXIT_FAILURE);
+	}
+
+	qsort(entries.content, entries.count, entries.size, re_entry_comp);
+	for (int i = 1; i < entries.count; ++i) {
+		re_entry* a = (re_entry*)entries.content + i - 1;
+		re_entry* b = (re_entry*)entries.content + i;
+		if (!strcmp(a->name, b->name)) {
+			fprintf(stderr, "%s:%d: pattern \"%s\" already defined on line %d.\n", mfname, b->line, b->name, a->line);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	return entries;
+}
+
+void re_batch(re_template* t, FILE* outf, char* mfname, bool tables)
+{
+	int pos;
+	re_exp* rexpr;
+	re_entry* ent;
+	re_scan_t scptr;
+	re_parse_t psptr;
+	m_stack entries;
+	m_buffer out;
+
+	out     = m_buffer_init();
+	entries = re_manifest_load(mfname);
+	ent     = (re_entry*)entries.content;
+
+	for (int k = 0; k <= t->nholes; ++k) {
+		re_template_copy(t, k, &out);
+		if (k == t->nholes)
+			break;
+
+		pos = t->holes[k].pos;
+		switch (k) {
+			case 0:
+				m_buffer_pad(&out, pos);
+				m_buffer_printf(&out, "// batch: %s, %d pattern%s\n", mfname, entries.count, entries.count == 1 ? "" : "s");
+				break;
+
+			case 1:
+				/* one matcher per pattern; the table and arena carry over */
+				for (int i = 0; i < entries.count; ++i) {
+					scptr = re_scan_init(ent[i].regex);
+					psptr = re_parse_init(&scptr);
+					rexpr = re_optimize(re_fold(re_compute(&psptr)));
+
+					m_buffer_printf(&out, "bool re_match_%s(char* instr)\n{\n", ent[i].name);
+					m_buffer_puts(&out, "    re_conv_init();\n    set_string(instr);\n\n");
+					if (tables)
+						re_conv_tables(rexpr, &out, 1);
+					else re_conv_main(rexpr, &out, 1);
+					m_buffer_puts(&out, "\n    return load_bool();\n}\n\n");
+
+					re_parse_free(&psptr);
+					m_arena_reset(&re_arena);
+				}
+				break;
+
+			case 2:
+				for (int i = 0; i < entries.count; ++i) {
+					m_buffer_pad(&out, pos);
+					m_buffer_printf(&out, "{ \"%s\", ", ent[i].name);
+					re_write_string(&out, ent[i].regex, strlen(ent[i].regex));
+					m_buffer_printf(&out, ", re_match_%s },\n", ent[i].name);
+				}
+				break;
+		}
+	}
+
+	m_buffer_write(&out, outf);
+	m_buffer_free(&out);
+}
+
+/* compile every pattern into one automaton, written as a rule database */
+void re_database(FILE* outf, char* mfname, char* regstr)
+{
+	re_dfa* dfa;
+	re_exp** pats;
+	char** names;
+	re_entry* ent;
+	m_stack entries;
+
+	if (mfname)
+		entries = re_manifest_load(mfname);
+	else {
+		entries = m_stack_init(re_entry);
+		m_stack_push(&entries, &(re_entry) { .name = "re", .regex = regstr, .line = 0 });
+	}
+
+	ent   = (re_entry*)entries.content;
+	pats  = (re_exp**)malloc(entries.count * sizeof(re_exp*));
+	names = (char**)malloc(entries.count * sizeof(char*));
+	for (int i = 0; i < entries.count; ++i) {
+		pats[i]  = re_read(ent[i].regex);
+		names[i] = ent[i].name;
+	}
+
+	if ((dfa = re_dfa_build(pats, entries.count, 0)) == NULL) {
+		fprintf(stderr, "patterns need more than %d automaton states.\n", RE_DFA_MAX_STATES);
+		exit(EXIT_FAILURE);
+	}
+	if (re_dfa_save(dfa, names, outf) != EXIT_SUCCESS) {
+		fprintf(stderr, "could not write rule database: %s\n", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+
+	re_dfa_free(dfa);
+	free(pats);
+	free(names);
+	free(entries.content);
+}
+
+/* the stem of a path, upper or lower cased, as a C identifier */
+static void re_ident(char* dst, size_t size, char* path, bool upper)
+{
+	char* base = path;
+	size_t n = 0;
+
+	for (char* p = path; *p; ++p)
+		if (*p == '/' || *p == '\\')
+			base = p + 1;
+	for (; *base && *base != '.' && n + 1 < size; ++base, ++n)
+		dst[n] = isalnum((unsigned char)*base) ? (upper ? toupper((unsigned char)*base) : *base) : '_';
+	dst[n] = '\0';
+}
+
+/**
+ * header mode: the matchers become static inline functions in a header
+ * guarded by the output's name, so callers can inline them. a manifest
+ * gives one re_match_<name> per pattern, a single regex re_match_<stem>.
+ */
+void re_header(re_template* t, FILE* outf, char* ofname, char* mfname, char* regstr, bool tables)
+{
+	char stem[64];
+	char guard[64];
+	re_exp* rexpr;
+	re_entry* ent;
+	m_stack entries;
+	m_buffer out;
+
+	re_ident(stem, sizeof(stem), ofname, false);
+	re_ident(guard, sizeof(guard), ofname, true);
+	if (mfname)
+		entries = re_manifest_load(mfname);
+	else {
+		entries = m_stack_init(re_entry);
+		m_stack_push(&entries, &(re_entry) { .name = stem, .regex = regstr, .line = 0 });
+	}
+
+	out = m_buffer_init();
+	ent = (re_entry*)entries.content;
+
+	for (int k = 0; k <= t->nholes; ++k) {
+		re_template_copy(t, k, &out);
+		if (k == t->nholes)
+			break;
+
+		switch (k) {
+			case 0:
+				m_buffer_printf(&out, "#ifndef RE_%s_H\n#define RE_%s_H\n#pragma once\n\n", guard, guard);
+				for (int i = 0; i < entries.count; ++i) {
+					m_buffer_printf(&out, "// %s: ", ent[i].name);
+					m_buffer_puts(&out, ent[i].regex);
+					m_buffer_putc(&out, '\n');
+				}
+				break;
+
+			case 1:
+				for (int i = 0; i < entries.count; ++i) {
+					rexpr = re_read(ent[i].regex);
+
+					m_buffer_printf(&out, "static inline bool re_match_%s(const char* instr)\n{\n", ent[i].name);
+					m_buffer_puts(&out, "    re_rt_init((char*)instr);\n\n");
+					if (tables)
+						re_conv_tables(rexpr, &out, 1);
+					else re_conv_main(rexpr, &out, 1);
+					m_buffer_printf(&out, "\n    return load_bool();\n}\n%s", i + 1 < entries.count ? "\n" : "");
+
+					m_arena_reset(&re_arena);
+				}
+				break;
+		}
+	}
+
+	m_buffer_write(&out, outf);
+	m_buffer_free(&out);
+	free(entries.content);
+}
 
-			re_write(fptr, "if (!load_bool())\n", space);
-			re_write(fptr, "ch = prev_pos();\n", space + 1);
-			re_write(fptr, "save_bool(true);\n", space);
-			
-			break;
+/**
+ * the matcher alone, indented for the template's second hole. this is
+ * what gets cached: it only depends on the canonical tree, where the
+ * file around it also names the pattern as it was spelled.
+ */
+void re_generate_body(re_template* t, m_buffer* out, re_exp* rexpr, bool tables)
+{
+	int pos = t->nholes > 1 ? t->holes[1].pos : 0;
 
-		case select_exp:
-			pol  = re->op.selectExp.pos;
-			iter = re->op.selectExp.select;
+	if (tables)
+		re_conv_tables(rexpr, out, pos / PAD_COUNT);
+	else re_conv_main(rexpr, out, pos / PAD_COUNT);
+}
 
-			if (iter) {
-				if (iter->next) {
-					re_write(fptr, "do {\n", space);		
-					while (iter) {
-						re_conv(iter->elem, fptr, space + 1);
-						re_write(fptr, "if (", space + 1);
-						re_write(fptr, pol ? "" : "!", 0);
-						re_write(fptr, "load_bool()) {\n", 0);
-						re_write(fptr, "save_bool(true);\n", space + 2);
-						re_write(fptr, "break;\n", space + 2);
-						re_write(fptr, "}\n", space + 1);
-						iter = iter->next;
-					}
-					re_write(fptr, "save_bool(false);\n", space + 1);
-					re_write(fptr, "} while (0);\n", space);
-				} else re_conv(iter->elem, fptr, space);
-			}
+/* fill in the program template for a single expression, around a body from re_generate_body */
+void re_generate(re_template* t, m_buffer* out, char* regstr, char* body, size_t len)
+{
+	int pos;
 
+	for (int k = 0; k <= t->nholes; ++k) {
+		re_template_copy(t, k, out);
+		if (k == t->nholes)
 			break;
 
-		case bar_exp:
-			if (re->op.barExp.left && re->op.barExp.right)
-			{
-				iter = re->op.barExp.left;
-				re_write(fptr, "save_pos();\n", space);
-				re_conv(re_exp_new((re_exp) {
-					.tag = plain_exp,
-					.op.plainExp = iter
-				}), fptr, space);
-				re_write(fptr, "if (!load_bool()) {\n", space);
-				iter = re->op.barExp.right;
-				re_write(fptr, "ch = prev_pos();\n", space + 1);
-				re_conv(re_exp_new((re_exp) {
-					.tag = plain_exp,
-					.op.plainExp = iter
-				}), fptr, space + 2);
-				re_write(fptr, "} else save_bool(true);\n", space);
-			}
-			else {
-				iter = re->op.barExp.left ? re->op.barExp.left : re->op.barExp.right;
-				re_conv(re_exp_new((re_exp) {
-					.tag = plain_exp,
-					.op.plainExp = iter
-				}), fptr, space);
-			}
-			break;
+		/* depends where you are, I guess... */
+		pos = t->holes[k].pos;
+		switch (k) {
+			case 0:
+				/* write expression */
+				m_buffer_pad(out, pos);
+				m_buffer_puts(out, "// regex: ");
+				m_buffer_puts(out, regstr);
+				m_buffer_putc(out, '\n');
+				break;
 
-		case plain_exp:
+			case 1:
+				m_buffer_put(out, body, len);
+				break;
+		}
+	}
+}
 
-			iter = re->op.plainExp;
+/**
+ * the cache key of a compile: generator version, template, output mode
+ * and the canonical tree. keys are plain strings; callers hash them.
+ */
+char* re_cache_key(unsigned long tmplhash, char* mode, re_exp* rexpr)
+{
+	char buf[64];
+	m_stack key;
+
+	key = m_stack_init(char);
+	snprintf(buf, sizeof(buf), "%s:%lx:", REGEXER_VERSION, tmplhash);
+	re_key_puts(&key, buf);
+	re_key_puts(&key, mode);
+	re_key_puts(&key, ":");
+	re_exp_key(rexpr, &key);
+	m_stack_push(&key, "");
+
+	return (char*)key.content;
+}
 
-			if (iter) {
-				if (iter->next) {
-					re_write(fptr, "do {\n", space);		
-					while (iter) {
-						re_conv(iter->elem, fptr, space + 1);
-						re_write(fptr, "if (!load_bool()) {\n", space + 1);
-						re_write(fptr, "save_bool(false);\n", space + 2);
-						re_write(fptr, "break;\n", space + 2);
-						re_write(fptr, "}\n", space + 1);
-						iter = iter->next;
-					}
-					re_write(fptr, "save_bool(true);\n", space + 1);
-					re_write(fptr, "} while (0);\n", space);
-				} else re_conv(iter->elem, fptr, space);
-			}
+/**
+ * on-disk cache: <dir>/<hash of key>.rxc holds a "regexer-cache body"
+ * line, the full key on a line of its own, then the generated matcher
+ * verbatim. the key is compared on lookup, so hash collisions and
+ * entries from other generator versions simply miss.
+ */
+static char* re_cache_path(char* dir, char* key)
+{
+	size_t len = strlen(dir) + 32;
+	char* path = (char*)malloc(len);
+
+	snprintf(path, len, "%s/%0*lx.rxc", dir, (int)(2 * sizeof(unsigned long)), m_hashmap_def_hashfunc((unsigned char*)key));
+	return path;
+}
+
+bool re_cache_fetch(char* dir, char* key, m_buffer* out)
+{
+	FILE* cf;
+	char* line;
+	size_t len;
+	size_t nread;
+	char buf[BUFSIZ];
+	char* path = re_cache_path(dir, key);
+	bool hit   = false;
+
+	line = NULL;
+	if ((cf = fopen(path, "rb")) != NULL) {
+		if (getline(&line, &len, cf) != -1 && !strcmp(line, "regexer-cache body\n")
+		&&  getline(&line, &len, cf) != -1 && !strncmp(line, key, strlen(key))
+		&&  !strcmp(line + strlen(key), "\n")) {
+			hit = true;
+			while ((nread = fread(buf, sizeof(char), sizeof(buf), cf)) > 0)
+				m_buffer_put(out, buf, nread);
+		}
+		fclose(cf);
+	}
+
+	free(line);
+	free(path);
+	return hit;
+}
+
+void re_cache_store(char* dir, char* key, char* text, size_t len)
+{
+	FILE* cf;
+	char* tmp;
+	size_t tlen;
+	char* path = re_cache_path(dir, key);
+
+	/* written aside and renamed in, so readers never see half an entry */
+	tlen = strlen(path) + 32;
+	tmp  = (char*)malloc(tlen);
+	snprintf(tmp, tlen, "%s.%d", path, (int)getpid());
+
+	/* a cache that can't be written to is skipped, not fatal */
+	if (mkdir(dir, 0777) != 0 && errno != EEXIST)
+		fprintf(stderr, "could not create cache directory %s: %s\n", dir, strerror(errno));
+	else if ((cf = fopen(tmp, "wb")) == NULL)
+		fprintf(stderr, "could not write to cache directory %s: %s\n", dir, strerror(errno));
+	else {
+		fprintf(cf, "regexer-cache body\n%s\n", key);
+		fwrite(text, sizeof(char), len, cf);
+		if (fclose(cf) == 0) {
+#ifdef _WIN32
+			/* only POSIX rename replaces what is there */
+			remove(path);
+#endif
+			rename(tmp, path);
+		}
+		remove(tmp);
+	}
+
+	free(tmp);
+	free(path);
+}
+
+/**
+ * server mode: requests are read one per line, and every reply starts
+ * with a status line.
+ *
+ *   compile <regex>   ->  "ok <length> hit|miss" then <length> bytes of C
+ *   stats             ->  "ok <requests> <hits> <entries>"
+ *   quit              ->  ends the session
+ *
+ * failures reply "error <message>". generated matchers are cached by the
+ * canonical form of their tree, so a recompile of a known pattern only
+ * costs a parse and filling in the template. the cache holds at most
+ * RE_SERVE_CACHE_BYTES of keys and matchers, dropping the oldest entries
+ * first, and <entries> counts what it holds now. with a cache directory,
+ * misses are looked up on disk before anything is generated.
+ */
+#define RE_SERVE_CACHE_BYTES (64 << 20)
+
+typedef struct
+re_cached
+{
+	char*  key;
+	char*  text;
+	size_t len;
+	struct re_cached* next;
+}
+re_cached;
+
+typedef struct
+re_server
+{
+	re_template tmpl;
+	char*      cachedir;
+	m_hashmap* cache;
+	re_scan_t  scanner;
+	re_parse_t parser;
+	re_cached* oldest;
+	re_cached* newest;
+	size_t     bytes;
+	size_t     dropped;
+	int        requests;
+	int        hits;
+	int        entries;
+}
+re_server;
+
+/* make room under RE_SERVE_CACHE_BYTES, oldest entries first */
+static void re_serve_evict(re_server* sv)
+{
+	re_cached* ent;
+
+	while (sv->bytes > RE_SERVE_CACHE_BYTES && sv->oldest != NULL) {
+		ent        = sv->oldest;
+		sv->oldest = ent->next;
+		if (sv->oldest == NULL)
+			sv->newest = NULL;
+
+		m_hashmap_remove(sv->cache, ent->key);
+		sv->bytes   -= strlen(ent->key) + ent->len;
+		sv->dropped += strlen(ent->key);
+		sv->entries--;
+
+		free(ent->key);
+		free(ent->text);
+		free(ent);
+	}
+
+	/* removed keys stay in the map's arena, so start a new map once they outweigh what is held */
+	if (sv->dropped > sv->bytes) {
+		m_hashmap_destroy(sv->cache);
+		sv->cache = m_hashmap_create(re_cached*, NULL);
+		for (ent = sv->oldest; ent != NULL; ent = ent->next)
+			m_hashmap_add_entry(sv->cache, ent->key, &ent);
+		sv->dropped = 0;
+	}
+}
+
+void re_serve_compile(re_server* sv, char* regstr, FILE* out)
+{
+	jmp_buf env;
+	re_exp* rexpr;
+	re_cached* ent;
+	re_cached** slot;
+	char* key;
+	m_buffer body;
+	m_buffer text;
+	bool ondisk;
+	bool hit;
+
+	sv->requests++;
+	sv->scanner = re_scan_init(regstr);
+	sv->parser  = re_parse_init(&(sv->scanner));
+
+	re_recover = &env;
+	if (setjmp(env)) {
+		size_t len = strlen(re_errmsg);
+		re_recover = NULL;
+		re_parse_free(&(sv->parser));
+		m_arena_reset(&re_arena);
+		if (len > 0 && re_errmsg[len-1] == '\n')
+			re_errmsg[len-1] = '\0';
+		fprintf(out, "error %s\n", re_errmsg);
+		return;
+	}
+	rexpr = re_optimize(re_fold(re_compute(&(sv->parser))));
+	re_recover = NULL;
+
+	key = re_cache_key(sv->tmpl.hash, "program", rexpr);
 
+	slot = (re_cached**)m_hashmap_get(sv->cache, key);
+	hit  = slot != NULL;
+
+	if (hit) {
+		ent = *slot;
+		free(key);
+		sv->hits++;
+	}
+	else {
+		ent       = (re_cached*)malloc(sizeof(re_cached));
+		ent->key  = key;
+		ent->next = NULL;
+
+		body   = m_buffer_init();
+		ondisk = sv->cachedir && re_cache_fetch(sv->cachedir, key, &body);
+		if (!ondisk)
+			re_generate_body(&(sv->tmpl), &body, rexpr, false);
+		if (sv->cachedir && !ondisk)
+			re_cache_store(sv->cachedir, key, body.content, body.length);
+		ent->text = m_buffer_take(&body, &(ent->len));
+
+		m_hashmap_add_entry(sv->cache, ent->key, &ent);
+		if (sv->newest != NULL)
+			sv->newest->next = ent;
+		else sv->oldest = ent;
+		sv->newest = ent;
+		sv->bytes += strlen(ent->key) + ent->len;
+		sv->entries++;
+	}
+
+	re_parse_free(&(sv->parser));
+	m_arena_reset(&re_arena);
+
+	/* the pattern is filled in as this request spelled it */
+	text = m_buffer_init();
+	re_generate(&(sv->tmpl), &text, regstr, ent->text, ent->len);
+	fprintf(out, "ok %lu %s\n", (unsigned long)text.length, hit ? "hit" : "miss");
+	m_buffer_write(&text, out);
+	m_buffer_free(&text);
+
+	if (!hit)
+		re_serve_evict(sv);
+}
+
+void re_serve(re_server* sv, FILE* in, FILE* out)
+{
+	char* line;
+	size_t len;
+	ssize_t nread;
+
+	line = NULL;
+	while ((nread = getline(&line, &len, in)) != -1) {
+		while (nread > 0 && (line[nread-1] == '\n' || line[nread-1] == '\r'))
+			line[--nread] = '\0';
+
+		if (!strncmp(line, "compile ", 8))
+			re_serve_compile(sv, line + 8, out);
+		else if (!strcmp(line, "stats"))
+			fprintf(out, "ok %d %d %d\n", sv->requests, sv->hits, sv->entries);
+		else if (!strcmp(line, "quit"))
 			break;
+		else if (nread > 0)
+			fprintf(out, "error unknown request \"%s\"\n", line);
+
+		fflush(out);
+	}
+
+	free(line);
+}
+
+int re_serve_socket(re_server* sv, char* path)
+{
+#ifdef _WIN32
+	fprintf(stderr, "serving on a socket is not supported on this platform.\n");
+	return EXIT_FAILURE;
+#else
+	int lfd;
+	int cfd;
+	struct sockaddr_un addr;
+
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "socket path \"%s\" is too long.\n", path);
+		return EXIT_FAILURE;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	if ((lfd = socket(AF_UNIX, SOCK_STREAM, 0)) == -1
+	||  bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) == -1
+	||  listen(lfd, 16) == -1) {
+		fprintf(stderr, "could not listen on \"%s\": %s\n", path, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	/* a client hanging up mid-reply must not take the server down */
+	signal(SIGPIPE, SIG_IGN);
+
+	/* sessions are served one after the other, sharing the cache */
+	while ((cfd = accept(lfd, NULL, NULL)) != -1) {
+		FILE* in  = fdopen(cfd, "r");
+		FILE* out = fdopen(dup(cfd), "w");
+		re_serve(sv, in, out);
+		fclose(in);
+		fclose(out);
 	}
+
+	fprintf(stderr, "accept failed: %s\n", strerror(errno));
+	close(lfd);
+	return EXIT_FAILURE;
+#endif
 }
 
-#undef re_write
-#undef ch_to_str
 #define BUFSIZE MAX_PATH
 
+#ifndef REGEXER_LIBRARY
+#include "res/templates.h"
+
+/**
+ * the templates regexer is built with, by name: base for a program that
+ * matches one pattern, batch for one that matches a manifest's, header
+ * for static inline matchers. when REGEXER_RES names a directory, the
+ * template is read from <name>.txt there instead, so it can be edited
+ * without a rebuild.
+ */
+static bool re_template_open(char* name, re_template* t)
+{
+	char path[4096];
+	char* dir = getenv("REGEXER_RES");
+
+	if (dir) {
+		snprintf(path, sizeof(path), "%s/%s.txt", dir, name);
+		return re_template_load(path, t);
+	}
+
+	for (size_t i = 0; i < sizeof(re_embedded) / sizeof(re_embedded[0]); ++i) {
+		if (!strcmp(re_embedded[i].name, name)) {
+			*t = re_template_parse(re_embedded[i].text, re_embedded[i].len, false);
+			return true;
+		}
+	}
+
+	errno = ENOENT;
+	return false;
+}
+
 int main(int argc, char** argv)
 {
 
-	FILE* tmpl;
+	re_template tmpl;
 	FILE* outf;
 
 	char* regstr = NULL;
 	char* ofname = NULL;
 	char* ifname = NULL;
+	char* bfname = NULL;
+	char* sockname = NULL;
+	char* matchstr = NULL;
+	char* searchstr = NULL;
+	char* scanfile = NULL;
+	char* linefile = NULL;
+	int nthreads = 0;
+	char* cachedir = getenv("REGEXER_CACHE");
+	bool serve = false;
+	bool database = false;
+	bool tables = false;
+	bool header = false;
 
 	for (int i = 1; i < argc; ++i)
 	{
 		char* arg = argv[i];
 		
+		/* --serve talks over stdin/stdout, --serve=PATH over a socket */
+		if (!strncmp(arg, "--serve", 7) && (arg[7] == '\0' || arg[7] == '=')) {
+			serve    = true;
+			sockname = arg[7] == '=' ? arg + 8 : NULL;
+			continue;
+		}
+
 		if (arg[0] == '-') {
 			if (strlen(arg) != 2) {
 				fprintf(stderr, "invalid flag \"%s\" argument given.\n", arg);
@@ -2001,6 +4253,79 @@ int main(int argc, char** argv)
 					ifname = argv[++i];
 					break;
 
+				case 'b':
+					if (i == argc - 1) {
+						fprintf(stderr, "no manifest file provided with \"b\" flag.\n");
+						exit(EXIT_FAILURE);
+					}
+					bfname = argv[++i];
+					break;
+
+				case 'c':
+					if (i == argc - 1) {
+						fprintf(stderr, "no cache directory provided with \"c\" flag.\n");
+						exit(EXIT_FAILURE);
+					}
+					cachedir = argv[++i];
+					break;
+
+				case 'd':
+					database = true;
+					break;
+
+				case 'h':
+					header = true;
+					break;
+
+				case 'i':
+					re_nocase = true;
+					break;
+
+				/* tables give patterns their regular meaning, as -d does */
+				case 't':
+					tables = true;
+					break;
+
+				case 'm':
+					if (i == argc - 1) {
+						fprintf(stderr, "no input string provided with \"m\" flag.\n");
+						exit(EXIT_FAILURE);
+					}
+					matchstr = argv[++i];
+					break;
+
+				case 's':
+					if (i == argc - 1) {
+						fprintf(stderr, "no input string provided with \"s\" flag.\n");
+						exit(EXIT_FAILURE);
+					}
+					searchstr = argv[++i];
+					break;
+
+				case 'p':
+					if (i == argc - 1) {
+						fprintf(stderr, "no input file provided with \"p\" flag.\n");
+						exit(EXIT_FAILURE);
+					}
+					scanfile = argv[++i];
+					break;
+
+				case 'l':
+					if (i == argc - 1) {
+						fprintf(stderr, "no input file provided with \"l\" flag.\n");
+						exit(EXIT_FAILURE);
+					}
+					linefile = argv[++i];
+					break;
+
+				case 'j':
+					if (i == argc - 1 || (nthreads = atoi(argv[i+1])) <= 0) {
+						fprintf(stderr, "no thread count provided with \"j\" flag.\n");
+						exit(EXIT_FAILURE);
+					}
+					++i;
+					break;
+
 				default:
 					fprintf(stderr, "invalid flag \"%s\" argument given.\n", arg);
 					exit(EXIT_FAILURE);
@@ -2020,89 +4345,265 @@ int main(int argc, char** argv)
 		}
 	}
 
+	if (serve) {
+		re_server sv;
+
+		if (ofname || regstr || bfname || ifname) {
+			fprintf(stderr, "server mode takes no other arguments.\n");
+			exit(EXIT_FAILURE);
+		}
+
+		if (!re_template_open("base", &sv.tmpl)) {
+			fprintf(stderr, "could not open template: %s\n", strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		sv.cachedir = cachedir;
+		sv.cache    = m_hashmap_create(re_cached*, NULL);
+		sv.oldest   = NULL;
+		sv.newest   = NULL;
+		sv.bytes    = 0;
+		sv.dropped  = 0;
+		sv.requests = 0;
+		sv.hits     = 0;
+		sv.entries  = 0;
+		re_arena    = m_arena_init();
+
+		if (sockname)
+			return re_serve_socket(&sv, sockname);
+
+		re_serve(&sv, stdin, stdout);
+		return EXIT_SUCCESS;
+	}
+
+	/* -m runs the pattern in process, with no C to generate or compile */
+	if (matchstr) {
+		re_prog* prog;
+		re_jit* jit;
+		bool res;
+
+		if (!ofname || regstr || bfname || ifname) {
+			fprintf(stderr, "usage: %s -m string regex\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+
+		prog = re_prog_compile(re_read(ofname));
+		jit  = re_jit_compile(prog);
+		res  = re_jit_match(jit, matchstr);
+
+		printf("%s evaluates as %s\n", matchstr, res ? "true" : "false");
+		re_jit_free(jit);
+		re_prog_free(prog);
+		return res ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	/* -s finds the leftmost longest match anywhere in the string */
+	if (searchstr) {
+		re_search* sr;
+		size_t start, end;
+		bool res;
+
+		if (!ofname || regstr || bfname || ifname) {
+			fprintf(stderr, "usage: %s -s string regex\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+
+		if ((sr = re_search_build(re_read(ofname), 0)) == NULL) {
+			fprintf(stderr, "pattern needs more than %d automaton states.\n", RE_DFA_MAX_STATES);
+			exit(EXIT_FAILURE);
+		}
+
+		if ((res = re_search_find(sr, searchstr, strlen(searchstr), &start, &end)))
+			printf("%s matches at [%zu, %zu): \"%.*s\"\n", searchstr, start, end, (int)(end - start), searchstr + start);
+		else printf("%s has no match\n", searchstr);
+		re_search_free(sr);
+		return res ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	/* -p counts the places matches end in a file, splitting it across threads */
+	if (scanfile) {
+		re_dfa* dfa;
+		re_exp* re;
+		re_par_result pr;
+		const char* text;
+		size_t len;
+
+		if (!ofname || regstr || bfname || ifname) {
+			fprintf(stderr, "usage: %s -p file [-j threads] regex\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+
+		re = re_read(ofname);
+		if ((dfa = re_dfa_compile(&re, 1, 0, RE_DFA_ANYWHERE)) == NULL) {
+			fprintf(stderr, "pattern needs more than %d automaton states.\n", RE_DFA_MAX_STATES);
+			exit(EXIT_FAILURE);
+		}
+		if ((text = re_par_map(scanfile, &len)) == NULL) {
+			fprintf(stderr, "could not read \"%s\": %s\n", scanfile, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+
+		re_par_run(dfa, text, len, nthreads, false, &pr);
+		printf("%s: %zu match end%s\n", scanfile, pr.count, pr.count == 1 ? "" : "s");
+		re_par_unmap(text, len);
+		re_dfa_free(dfa);
+		return pr.any ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	/* -l prints the lines of a file the pattern matches, matching them on a pool of threads */
+	if (linefile) {
+		re_prog* prog;
+		FILE* lfptr;
+		m_stack lines;
+		bool* res;
+		char* text;
+		size_t len, hits = 0;
+
+		if (!ofname || regstr || bfname || ifname) {
+			fprintf(stderr, "usage: %s -l file [-j threads] regex\n", argv[0]);
+			exit(EXIT_FAILURE);
+		}
+
+		if ((lfptr = fopen(linefile, "rb")) == NULL || fseek(lfptr, 0, SEEK_END) || (text = re_slurp(lfptr, &len)) == NULL) {
+			fprintf(stderr, "could not read \"%s\": %s\n", linefile, strerror(errno));
+			exit(EXIT_FAILURE);
+		}
+		fclose(lfptr);
+
+		/* each line becomes a string of its own, without its line ending */
+		lines = m_stack_init(char*);
+		for (char* at = text; at < text + len; ) {
+			char* nl = memchr(at, '\n', text + len - at);
+			char* eol = nl ? nl : text + len;
+			m_stack_push(&lines, &at);
+			if (eol > at && eol[-1] == '\r')
+				eol[-1] = '\0';
+			*eol = '\0';
+			at = eol + 1;
+		}
+
+		prog = re_prog_compile(re_read(ofname));
+		res  = (bool*)malloc(lines.count * sizeof(bool) + 1);
+		re_pool_match(prog, (const char**)lines.content, lines.count, nthreads, res);
+
+		for (int k = 0; k < lines.count; ++k) {
+			if (res[k]) {
+				puts(((char**)lines.content)[k]);
+				hits++;
+			}
+		}
+
+		re_prog_free(prog);
+		free(lines.content);
+		free(text);
+		free(res);
+		return hits ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
 	if (!ofname) {
 		fprintf(stderr, "no output filename provided.\n");
 		exit(EXIT_FAILURE);
 	}
 
-	if (!ifname && !regstr) {
+	if (bfname && (ifname || regstr)) {
+		fprintf(stderr, "a manifest cannot be combined with an input file or regex argument.\n");
+		exit(EXIT_FAILURE);
+	}
+
+	if (!ifname && !regstr && !bfname) {
 		fprintf(stderr, "no input file or regex argument provided.\n");
 		exit(EXIT_FAILURE);
 	}
 
-	/* open template file ptr */
-	tmpl = fopen("./res/base.txt", "r");
-	if (tmpl == NULL) {
-		strerror(errno);
+	/* the template follows the output; a database needs none */
+	if (!database && !re_template_open(header ? "header" : bfname ? "batch" : "base", &tmpl)) {
+		fprintf(stderr, "could not open template: %s\n", strerror(errno));
 		exit(EXIT_FAILURE);
 	}
 
 	/* open output file ptr */
-	outf = fopen(ofname, "w");
+	outf = fopen(ofname, database ? "wb" : "w");
 	if (outf == NULL) {
 		strerror(errno);
 		exit(EXIT_FAILURE);
 	}
 
+	re_arena = m_arena_init();
+
+	if (database && bfname) {
+		re_database(outf, bfname, NULL);
+		fclose(outf);
+		return EXIT_SUCCESS;
+	}
+
+	if (header && bfname) {
+		re_header(&tmpl, outf, ofname, bfname, NULL, tables);
+		re_template_free(&tmpl);
+		fclose(outf);
+		return EXIT_SUCCESS;
+	}
+
+	if (bfname) {
+		re_batch(&tmpl, outf, bfname, tables);
+		re_template_free(&tmpl);
+		fclose(outf);
+		return EXIT_SUCCESS;
+	}
+
 	if (ifname) {
-		int g;
-		FILE* ifptr = fopen(ifname, "r");
-		if (outf == NULL) {
-			strerror(errno);
+		size_t len;
+		FILE* ifptr = fopen(ifname, "rb");
+
+		/* the whole pattern in one read, however large */
+		if (ifptr == NULL || fseek(ifptr, 0, SEEK_END) || (regstr = re_slurp(ifptr, &len)) == NULL) {
+			fprintf(stderr, "could not read \"%s\".\n", ifname);
 			exit(EXIT_FAILURE);
 		}
-		m_stack stk = m_stack_init(char);
-		while ((g = fgetc(ifptr)) != EOF)
-			m_stack_push(&stk, &g);
-		m_stack_push(&stk, (char[]){'\0'});
-		regstr = (char*)stk.content;
+		fclose(ifptr);
+	}
+
+	if (database) {
+		re_database(outf, NULL, regstr);
+		fclose(outf);
+		return EXIT_SUCCESS;
+	}
+
+	if (header) {
+		re_header(&tmpl, outf, ofname, NULL, regstr, tables);
+		re_template_free(&tmpl);
+		fclose(outf);
+		return EXIT_SUCCESS;
 	}
 	
-	int pos;
-	int stat;
-	char* line;
-	size_t len;
 	re_exp* rexpr;
-	ssize_t nread;
 	re_scan_t scptr;
 	re_parse_t psptr;
 	
 	/* prepare variables */
-	stat  = 0;
-	line  = NULL;
 	scptr = re_scan_init(regstr);
 	psptr = re_parse_init(&scptr);
-	rexpr = re_compute(&psptr);
-
-	/* line by line, read input and compare */
-	while ((nread = getline(&line, &len, tmpl)) != -1) {
-		/* check if the subtree doesn't exist */
-		if ((pos = issubstr(line, "/* input */")) == -1) {
-			/* write line to output file */
-			fwrite(line, sizeof(char), strlen(line), outf);
-		} 
-		else {
-			/* depends where you are, I guess... */
-			switch (stat) {
-				case 0:
-					/* write expression */
-					for (int i = 0; i < pos; ++i) fputc(' ', outf);
-					fwrite("// regex: ", sizeof(char), 10, outf);
-					fwrite(regstr, sizeof(char), strlen(regstr), outf);
-					fputc('\n', outf);
-					break;
+	rexpr = re_optimize(re_fold(re_compute(&psptr)));
 
-				case 1:
-					/* write info, depending on place */
-					re_conv(rexpr, outf, pos / PAD_COUNT);
-					break;
-			}
+	/* the code is built in memory and written out in one go */
+	m_buffer body = m_buffer_init();
+	m_buffer text = m_buffer_init();
 
-			/* increase state */
-			stat++;
+	if (cachedir) {
+		char* key  = re_cache_key(tmpl.hash, tables ? "tables" : "program", rexpr);
+
+		if (!re_cache_fetch(cachedir, key, &body)) {
+			re_generate_body(&tmpl, &body, rexpr, tables);
+			re_cache_store(cachedir, key, body.content, body.length);
 		}
+		free(key);
 	}
+	else re_generate_body(&tmpl, &body, rexpr, tables);
+	re_generate(&tmpl, &text, regstr, body.content, body.length);
 
-	fclose(tmpl);
+	m_buffer_write(&text, outf);
+	m_buffer_free(&body);
+	m_buffer_free(&text);
+	re_template_free(&tmpl);
 	fclose(outf);
-}
\ No newline at end of file
+}
+#endif
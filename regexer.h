@@ -0,0 +1,70 @@
+#ifndef REGEXER_H
+#define REGEXER_H
+#pragma once
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <setjmp.h>
+
+#include "types/arena/arena.h"
+#include "types/buffer/buffer.h"
+
+/* the parsed pattern, shared by every backend */
+typedef struct re_exp {
+    enum { char_exp, empty_exp,
+		   dot_exp, rep_exp, bar_exp, 
+		   plain_exp, opt_exp, range_exp, 
+		   select_exp, kleene_exp, str_exp,
+		   trie_exp }                         tag;
+    int                                        ucs; // while parsing, 1 + where its code points are in the parser, or 0
+    union { char                               charExp;
+			char                               emptyExp;
+            struct { char* str; int len; }     strExp;
+			char						       dotExp;
+            struct re_comp*                    repExp;
+            struct re_comp*                    plainExp;
+            struct { struct re_comp* left;
+                     struct re_comp* right; }  barExp;
+            struct re_comp*                    optExp;
+			struct { char min; char max; }     rangeExp;
+            struct { int pos;
+			         struct re_comp* select; } selectExp;
+            struct re_comp*                    kleeneExp;
+            struct re_comp*                    trieExp; } op;
+} re_exp;
+
+typedef struct re_comp {
+    re_exp*         elem;
+    struct re_comp* next;
+} re_comp;
+
+/*
+ * a|b|c is a bar_exp whose right side is a sequence of one step, the
+ * bar_exp for b|c. walks go down that chain in a loop, so a pattern of a
+ * million alternatives needs no more stack than one of two.
+ */
+#define re_bar_chained(comp) ((comp) && (comp)->next == NULL && (comp)->elem->tag == bar_exp \
+    && (comp)->elem->op.barExp.left && (comp)->elem->op.barExp.right)
+
+/*
+ * every tree node lives here, so a whole tree can be dropped at once,
+ * but for single chars and the empty step, which all trees share
+ */
+extern m_arena re_arena;
+
+/* when set, parse errors unwind here instead of ending the process */
+extern jmp_buf* re_recover;
+extern char re_errmsg[256];
+
+/* fold case at compile time, as -i asks */
+extern bool re_nocase;
+
+re_exp* re_exp_new(re_exp re);
+re_comp* re_comp_new(re_comp re);
+void re_exp_len(re_exp* re, int* min, int* max);
+re_exp* re_fold(re_exp* re);
+re_exp* re_optimize(re_exp* re);
+re_exp* re_read(char* regstr);
+void re_conv(re_exp* re, m_buffer* out, int space);
+
+#endif
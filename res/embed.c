@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Turns the templates into a header of string literals, run by make so
+ * regexer carries them inside the binary:
+ *
+ *   embed templates.h base.txt batch.txt header.txt
+ *
+ * Each template is named after its file, without the directory or the
+ * extension, and every line becomes a literal of its own so the header
+ * reads like the template did.
+ */
+
+static void
+embed_name(FILE* out, const char* path)
+{
+    const char* base = path;
+
+    for (const char* p = path; *p; ++p)
+        if (*p == '/' || *p == '\\')
+            base = p + 1;
+    for (; *base && *base != '.'; ++base)
+        fputc(*base, out);
+}
+
+static int
+embed_file(FILE* out, const char* path)
+{
+    int c, col = 0;
+    long len = 0;
+    FILE* in = fopen(path, "rb");
+
+    if (in == NULL) {
+        perror(path);
+        return EXIT_FAILURE;
+    }
+
+    fputs("    { \"", out);
+    embed_name(out, path);
+    fputs("\",\n", out);
+    while ((c = fgetc(in)) != EOF)
+    {
+        if (col == 0)
+            fputs("      \"", out);
+        switch (c)
+        {
+            case '\n': fputs("\\n\"\n", out); break;
+            case '\t': fputs("\\t", out); break;
+            case '\r': fputs("\\r", out); break;
+            case '\"': fputs("\\\"", out); break;
+            case '\\': fputs("\\\\", out); break;
+            case '?':  fputs("\\?", out); break;
+            default:
+                if (c >= ' ' && c < 0x7F)
+                    fputc(c, out);
+                else fprintf(out, "\\%03o", c);
+        }
+        col = c == '\n' ? 0 : col + 1;
+        len++;
+    }
+    if (len == 0)
+        fputs("      \"\"\n", out);
+    else if (col > 0)
+        fputs("\"\n", out);
+    fprintf(out, "      , %ld },\n", len);
+
+    fclose(in);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+    FILE* out;
+    int stat = EXIT_SUCCESS;
+
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s output template...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    if ((out = fopen(argv[1], "w")) == NULL) {
+        perror(argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    fputs("/* generated by res/embed.c from the templates in res/; do not edit */\n\n", out);
+    fputs("static const struct { const char* name; const char* text; size_t len; } re_embedded[] = {\n", out);
+    for (int i = 2; i < argc && stat == EXIT_SUCCESS; ++i)
+        stat = embed_file(out, argv[i]);
+    fputs("};\n", out);
+
+    if (fclose(out) != 0 || stat != EXIT_SUCCESS) {
+        remove(argv[1]);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "../backend/db/db.h"
+
+/* from the batch output of dbcases.mf, built with RE_NO_MAIN */
+typedef struct
+re_matcher
+{
+    const char* name;
+    const char* regex;
+    bool (*match)(char*);
+}
+re_matcher;
+
+extern re_matcher re_matchers[];
+extern const int re_matcher_count;
+
+#define MAX_INPUT 4
+
+static const char alphabet[] = "~abcdx0XFGETPOSU";
+
+/**
+ * @brief Check every string over the alphabet up to a length, comparing
+ * the patterns the database reports with the re_conv matchers.
+ * 
+ * @param db Database built from the same manifest.
+ * @param buf Input being built.
+ * @param len Length of buf so far.
+ * @return Number of disagreements found.
+ */
+int db_check(re_db* db, char* buf, int len)
+{
+    int bad = 0, count, n = 0;
+    uint32_t ids[64];
+
+    buf[len] = '\0';
+    count = re_db_match(db, buf, ids, 64);
+
+    for (int i = 0; i < re_matcher_count; ++i) {
+        bool want = re_matchers[i].match(buf);
+        bool got  = n < count && ids[n] == (uint32_t)i;
+
+        if (got) n++;
+        if (got != want) {
+            printf("%s: /%s/ on \"%s\": re_conv %d, database %d\n", re_matchers[i].name, re_matchers[i].regex, buf, want, got);
+            bad++;
+        }
+    }
+
+    if (len < MAX_INPUT) {
+        for (int i = 0; alphabet[i]; ++i) {
+            buf[len] = alphabet[i];
+            bad += db_check(db, buf, len + 1);
+        }
+    }
+
+    return bad;
+}
+
+int main(void)
+{
+    int bad = 0;
+    re_db db;
+    char buf[MAX_INPUT + 1];
+
+    if (re_db_open(&db, "dbcases.rxdb") != EXIT_SUCCESS) {
+        printf("could not open dbcases.rxdb\n");
+        return EXIT_FAILURE;
+    }
+
+    if ((int)db.hdr->npatterns != re_matcher_count) {
+        printf("database holds %u patterns, manifest %d\n", db.hdr->npatterns, re_matcher_count);
+        return EXIT_FAILURE;
+    }
+    for (int i = 0; i < re_matcher_count; ++i) {
+        if (strcmp(re_db_name(&db, i), re_matchers[i].name)) {
+            printf("pattern %d is %s in the database, %s in the manifest\n", i, re_db_name(&db, i), re_matchers[i].name);
+            bad++;
+        }
+    }
+
+    bad += db_check(&db, buf, 0);
+    re_db_close(&db);
+
+    printf("%d pattern%s checked against re_conv, %d mismatch%s\n",
+        re_matcher_count, re_matcher_count == 1 ? "" : "s", bad, bad == 1 ? "" : "es");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "../regexer.h"
+#include "../backend/dfa/dfa.h"
+
+#define LINE_COUNT 200000
+#define ROUNDS 5
+
+/* enough overlapping patterns to give a table well past the first-level cache */
+static const char* patterns[] = {
+    "[a-z]*(error|fail)[a-z]*[0-9]{2}", "[a-z]*warn[a-z0-9]*x", "([a-f][0-9])*[g-z]{3}q",
+    "[a-z]*(get|put|post)[a-z]*[0-9]{3}z", "[0-9a-z]*id[0-9]{4}", "(ab|cd|ef)*[a-z]{4}k",
+    "[a-m]*[n-z]{2}[0-9]+[a-z]*j",
+};
+
+#define PATTERN_COUNT ((int)(sizeof(patterns) / sizeof(patterns[0])))
+
+static double
+bench_now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void)
+{
+    re_exp* pats[PATTERN_COUNT];
+    char** lines = (char**)malloc(LINE_COUNT * sizeof(char*));
+    bool* want = (bool*)malloc(LINE_COUNT * sizeof(bool));
+    bool* got = (bool*)malloc(LINE_COUNT * sizeof(bool));
+    size_t bytes = 0;
+    double t, best;
+    re_dfa* dfa;
+    int bad = 0;
+
+    for (int i = 0; i < PATTERN_COUNT; ++i)
+        pats[i] = re_read((char*)patterns[i]);
+    dfa = re_dfa_build(pats, PATTERN_COUNT, 0);
+
+    /* short log-like lines, most of which run to their end */
+    srand(42);
+    for (int i = 0; i < LINE_COUNT; ++i) {
+        int len = 16 + rand() % 64;
+        lines[i] = (char*)malloc(len + 1);
+        for (int k = 0; k < len; ++k)
+            lines[i][k] = rand() % 5 ? 'a' + rand() % 26 : '0' + rand() % 10;
+        lines[i][len] = '\0';
+        bytes += len;
+    }
+
+    printf("%d states, %d classes, %d lines, %zu bytes\n", dfa->nstates, dfa->nclasses, LINE_COUNT, bytes);
+
+    best = 1e9;
+    for (int r = 0; r < ROUNDS; ++r) {
+        t = bench_now();
+        for (int i = 0; i < LINE_COUNT; ++i)
+            want[i] = re_dfa_match(dfa, lines[i]);
+        t = bench_now() - t;
+        best = t < best ? t : best;
+    }
+    printf("re_dfa_match      %8.1f MB/s\n", bytes / best / 1e6);
+
+    for (int lanes = 1; lanes <= RE_DFA_MAX_LANES; lanes *= 2) {
+        best = 1e9;
+        for (int r = 0; r < ROUNDS; ++r) {
+            t = bench_now();
+            re_dfa_match_many(dfa, (const char**)lines, LINE_COUNT, got, lanes);
+            t = bench_now() - t;
+            best = t < best ? t : best;
+        }
+        for (int i = 0; i < LINE_COUNT; ++i)
+            bad += got[i] != want[i];
+        printf("%d stream%s         %8.1f MB/s\n", lanes, lanes == 1 ? " " : "s", bytes / best / 1e6);
+    }
+
+    /* fewer strings than lanes leaves some idle from the start */
+    for (int n = 0; n < 2 * RE_DFA_MAX_LANES; ++n) {
+        memset(got, 0, n * sizeof(bool));
+        re_dfa_match_many(dfa, (const char**)lines, n, got, RE_DFA_MAX_LANES);
+        for (int i = 0; i < n; ++i)
+            bad += got[i] != want[i];
+    }
+
+    printf("%d mismatch%s\n", bad, bad == 1 ? "" : "es");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
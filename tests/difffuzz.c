@@ -0,0 +1,589 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include <regex.h>
+#include <time.h>
+#include <dlfcn.h>
+
+#include "../regexer.h"
+#include "../backend/prog/prog.h"
+#include "../backend/vm/vm.h"
+#include "../backend/jit/jit.h"
+#include "../backend/dfa/dfa.h"
+#include "../backend/search/search.h"
+#include "../backend/par/par.h"
+
+#define MAX_PATTERN 256
+#define MAX_INPUT 12
+#define INPUTS 64
+#define SPEED_INPUT 4096
+#define SPEED_ROUNDS 8
+
+/* slower than the record by more than this fraction counts as a regression */
+#define SLACK 0.25
+
+/* one pattern in this many also goes through re_conv and gcc, up to CONV_SAMPLES */
+#define CONV_EVERY 10
+#define CONV_SAMPLES 200
+
+#ifndef FUZZ_REGEXER
+#define FUZZ_REGEXER "../regexer"
+#endif
+
+/**
+ * Every backend, and what it is held to. Those with regular semantics
+ * must agree with regexec: the anchored ones with ^(p), the searcher on
+ * the leftmost longest span of (p), the parallel scan on whether (p)
+ * occurs at all. The backends sharing re_conv's meaning commit to their
+ * first choice. The interpreter must agree with a matcher read straight
+ * off the tree, and may only match where regexec finds a match from the
+ * start; the vm, the jit and the C that re_conv writes must agree with
+ * the interpreter. With -t re_conv writes an automaton instead, which
+ * must agree with regexec like the dfa.
+ */
+enum { FUZZ_POSIX, FUZZ_SEARCH, FUZZ_PAR, FUZZ_DFA, FUZZ_LANES, FUZZ_PROG, FUZZ_VM, FUZZ_JIT, FUZZ_CONV, FUZZ_TABLES, FUZZ_BACKENDS };
+
+/* the backends before this one are timed */
+#define FUZZ_TIMED FUZZ_DFA
+
+static const char* backends[FUZZ_BACKENDS] = {
+    "regexec", "search", "par", "dfa", "dfa lanes", "interpreter", "vm", "jit", "re_conv", "re_conv -t"
+};
+
+typedef struct
+fuzz_stats
+{
+    long checks;                                // Inputs compared
+    long bad;                                   // Disagreements
+    double secs;                                // Time spent matching speed inputs
+    double bytes;                               // Text searched through in that time
+}
+fuzz_stats;
+
+/* from the batch output, built with RE_NO_MAIN */
+typedef struct
+re_matcher
+{
+    const char* name;
+    const char* regex;
+    bool (*match)(char*);
+}
+re_matcher;
+
+/* a pattern kept for re_conv, with its inputs and what regexec and the interpreter said of each */
+typedef struct
+fuzz_sample
+{
+    char pat[MAX_PATTERN];
+    char inputs[INPUTS][MAX_INPUT + 1];
+    bool want[INPUTS];
+    bool peg[INPUTS];
+}
+fuzz_sample;
+
+static fuzz_stats stats[FUZZ_BACKENDS];
+static unsigned long long fuzz_seed;
+static fuzz_sample samples[CONV_SAMPLES];
+static int nsamples;
+static int fuzzed;
+
+/* xorshift, so a seed gives the same run everywhere */
+static unsigned
+fuzz_rand(void)
+{
+    fuzz_seed ^= fuzz_seed << 13;
+    fuzz_seed ^= fuzz_seed >> 7;
+    fuzz_seed ^= fuzz_seed << 17;
+    return (unsigned)(fuzz_seed >> 16);
+}
+
+static double
+fuzz_now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Write a random pattern both grammars read the same way: one
+ * string serves for both, since the syntax used is common to regexer and
+ * POSIX extended expressions.
+ *
+ * @param out Where the pattern goes.
+ * @param at Length of out so far.
+ * @param depth Nesting left.
+ * @return Length of out.
+ */
+int fuzz_alt(char* out, int at, int depth);
+
+int fuzz_atom(char* out, int at, int depth)
+{
+    static const char* classes[] = { "[ab]", "[^a]", "[a-c]", "[^bc]", "[b]" };
+
+    switch (fuzz_rand() % (depth > 0 ? 6 : 5))
+    {
+        case 0:
+        case 1:
+            out[at++] = "abc"[fuzz_rand() % 3];
+            break;
+        case 2:
+            out[at++] = '.';
+            break;
+        case 3:
+        case 4: {
+            const char* cls = classes[fuzz_rand() % 5];
+            memcpy(out + at, cls, strlen(cls));
+            at += strlen(cls);
+            break;
+        }
+        default:
+            out[at++] = '(';
+            at = fuzz_alt(out, at, depth - 1);
+            out[at++] = ')';
+            break;
+    }
+
+    /* one quantifier at most, since POSIX leaves a** undefined */
+    if (fuzz_rand() % 3 == 0)
+        out[at++] = "*+?"[fuzz_rand() % 3];
+    return at;
+}
+
+int fuzz_alt(char* out, int at, int depth)
+{
+    int branches = 1 + (fuzz_rand() % 4 == 0) + (fuzz_rand() % 8 == 0);
+
+    for (int b = 0; b < branches; ++b) {
+        int atoms = 1 + fuzz_rand() % 3;
+        if (b > 0)
+            out[at++] = '|';
+        for (int k = 0; k < atoms && at < MAX_PATTERN - 64; ++k)
+            at = fuzz_atom(out, at, depth);
+    }
+    return at;
+}
+
+/* a random input, mostly over the letters patterns use */
+static int
+fuzz_input(char* buf, int max)
+{
+    int len = fuzz_rand() % (max + 1);
+
+    for (int i = 0; i < len; ++i)
+        buf[i] = "abcabcd"[fuzz_rand() % 7];
+    buf[len] = '\0';
+    return len;
+}
+
+static long fuzz_peg_seq(re_comp* comp, const char* in, long at);
+
+/**
+ * @brief Match a tree the way re_conv does, read straight off the tree:
+ * every step commits to what it first matches, choices are taken in
+ * order, and loops are greedy and never give anything back.
+ *
+ * @param re Tree to match.
+ * @param in Input.
+ * @param at Where in the input to start.
+ * @return Where the match ends, or -1 if there is none.
+ */
+static long
+fuzz_peg(re_exp* re, const char* in, long at)
+{
+    long next;
+    int count;
+    bool hit;
+
+    switch (re->tag)
+    {
+        case char_exp:
+            return in[at] && in[at] == re->op.charExp ? at + 1 : -1;
+
+        case dot_exp:
+            return in[at] ? at + 1 : -1;
+
+        case str_exp:
+            return strncmp(in + at, re->op.strExp.str, re->op.strExp.len) ? -1 : at + re->op.strExp.len;
+
+        case empty_exp:
+            return at;
+
+        case select_exp:
+            if (!in[at])
+                return -1;
+            hit = false;
+            for (re_comp* iter = re->op.selectExp.select; iter; iter = iter->next) {
+                re_exp* m = iter->elem;
+                hit |= m->tag == dot_exp
+                    || (m->tag == char_exp && in[at] == m->op.charExp)
+                    || (m->tag == range_exp && (unsigned char)in[at] >= (unsigned char)m->op.rangeExp.min
+                                            && (unsigned char)in[at] <= (unsigned char)m->op.rangeExp.max);
+            }
+            return hit == (bool)re->op.selectExp.pos ? at + 1 : -1;
+
+        case plain_exp:
+            return fuzz_peg_seq(re->op.plainExp, in, at);
+
+        case opt_exp:
+            next = fuzz_peg_seq(re->op.optExp, in, at);
+            return next < 0 ? at : next;
+
+        case kleene_exp:
+        case rep_exp:
+            for (count = 0; (next = fuzz_peg_seq(re->op.kleeneExp, in, at)) >= 0; at = next) {
+                count++;
+                if (next == at)
+                    break;
+            }
+            return re->tag == rep_exp && count == 0 ? -1 : at;
+
+        case bar_exp:
+            if (!(re->op.barExp.left && re->op.barExp.right))
+                return fuzz_peg_seq(re->op.barExp.left ? re->op.barExp.left : re->op.barExp.right, in, at);
+            for (;; re = re->op.barExp.right->elem) {
+                if ((next = fuzz_peg_seq(re->op.barExp.left, in, at)) >= 0)
+                    return next;
+                if (!re_bar_chained(re->op.barExp.right))
+                    return fuzz_peg_seq(re->op.barExp.right, in, at);
+            }
+
+        case trie_exp:
+            for (re_comp* iter = re->op.trieExp; iter; iter = iter->next)
+                if ((next = fuzz_peg(iter->elem, in, at)) >= 0)
+                    return next;
+            return -1;
+
+        default:
+            return -1;
+    }
+}
+
+static long
+fuzz_peg_seq(re_comp* comp, const char* in, long at)
+{
+    for (; comp && at >= 0; comp = comp->next)
+        at = fuzz_peg(comp->elem, in, at);
+    return at;
+}
+
+static void
+fuzz_report(const char* pat, const char* input, int backend, const char* want, const char* got)
+{
+    stats[backend].bad++;
+    if (stats[backend].bad <= 10)
+        printf("%s: /%s/ on \"%s\": regexec %s, got %s\n", backends[backend], pat, input, want, got);
+}
+
+/**
+ * @brief Compile a pattern through every backend and compare them all on
+ * random inputs, then time each on one long input.
+ *
+ * @param pat Pattern to check.
+ * @return false if regexer rejected the pattern.
+ */
+bool fuzz_pattern(char* pat)
+{
+    jmp_buf env;
+    re_exp* re;
+    regex_t anchored, anywhere;
+    char text[SPEED_INPUT + 1];
+    char buf[2 * MAX_INPUT + 1];
+    char posix[MAX_PATTERN + 8];
+    const char* strs[INPUTS];
+    char inputs[INPUTS][MAX_INPUT + 1];
+    bool many[INPUTS];
+    bool wants[INPUTS];
+    bool pegs[INPUTS];
+    re_prog* prog;
+    re_vm* vm;
+    re_jit* jit;
+    re_dfa* dfa;
+    re_dfa* scan;
+    re_search* sr;
+
+    re_recover = &env;
+    if (setjmp(env)) {
+        re_recover = NULL;
+        m_arena_reset(&re_arena);
+        return false;
+    }
+    re = re_read(pat);
+    re_recover = NULL;
+
+    snprintf(posix, sizeof(posix), "^(%s)", pat);
+    if (regcomp(&anchored, posix, REG_EXTENDED | REG_NOSUB) || regcomp(&anywhere, posix + 1, REG_EXTENDED)) {
+        printf("regcomp rejected /%s/\n", pat);
+        exit(EXIT_FAILURE);
+    }
+
+    prog = re_prog_compile(re);
+    vm   = re_vm_compile(prog);
+    jit  = re_jit_compile(prog);
+    dfa  = re_dfa_build(&re, 1, 0);
+    scan = re_dfa_compile(&re, 1, 0, RE_DFA_ANYWHERE);
+    sr   = re_search_build(re, 0);
+
+    for (int i = 0; i < INPUTS; ++i) {
+        fuzz_input(inputs[i], MAX_INPUT);
+        strs[i] = inputs[i];
+    }
+    re_dfa_match_many(dfa, strs, INPUTS, many, RE_DFA_MAX_LANES);
+
+    for (int i = 0; i < INPUTS; ++i)
+    {
+        char* in = inputs[i];
+        bool want = regexec(&anchored, in, 0, NULL, 0) == 0;
+        bool peg  = re_prog_run(prog, in);
+        bool ref  = fuzz_peg(re, in, 0) >= 0;
+        bool vms  = re_vm_run(vm, in);
+        bool jits = re_jit_match(jit, in);
+        size_t s, e;
+        bool found;
+        regmatch_t pm[1];
+        re_par_result pr;
+
+        for (int b = 0; b < FUZZ_CONV; ++b)
+            stats[b].checks++;
+
+        if (re_dfa_match(dfa, in) != want)
+            fuzz_report(pat, in, FUZZ_DFA, want ? "matches" : "does not", want ? "no match" : "a match");
+        if (many[i] != want)
+            fuzz_report(pat, in, FUZZ_LANES, want ? "matches" : "does not", want ? "no match" : "a match");
+        if (peg && !want)
+            fuzz_report(pat, in, FUZZ_PROG, "does not match", "a match");
+        if (peg != ref)
+            fuzz_report(pat, in, FUZZ_PROG, ref ? "reference matches" : "reference does not", peg ? "a match" : "no match");
+        wants[i] = want;
+        pegs[i]  = peg;
+        if (vms != peg)
+            fuzz_report(pat, in, FUZZ_VM, peg ? "interpreter matches" : "interpreter does not", vms ? "a match" : "no match");
+        if (jits != peg)
+            fuzz_report(pat, in, FUZZ_JIT, peg ? "interpreter matches" : "interpreter does not", jits ? "a match" : "no match");
+
+        /* searches get longer inputs, so matches are found away from the start */
+        int len = fuzz_input(buf, 2 * MAX_INPUT);
+        bool any = regexec(&anywhere, buf, 1, pm, 0) == 0;
+        found = re_search_find(sr, buf, len, &s, &e);
+        if (found != any || (any && ((regoff_t)s != pm[0].rm_so || (regoff_t)e != pm[0].rm_eo))) {
+            char want_s[48], got_s[48];
+            snprintf(want_s, sizeof(want_s), any ? "[%d, %d)" : "no match", (int)pm[0].rm_so, (int)pm[0].rm_eo);
+            snprintf(got_s, sizeof(got_s), found ? "[%zu, %zu)" : "no match", s, e);
+            fuzz_report(pat, buf, FUZZ_SEARCH, want_s, got_s);
+        }
+        re_par_run(scan, buf, len, 2, false, &pr);
+        if (pr.any != any)
+            fuzz_report(pat, buf, FUZZ_PAR, any ? "matches" : "does not", pr.any ? "a match" : "no match");
+    }
+
+    /* a sample is kept to be written out as C once every pattern is done */
+    if (fuzzed++ % CONV_EVERY == 0 && nsamples < CONV_SAMPLES) {
+        fuzz_sample* smp = &samples[nsamples++];
+        strcpy(smp->pat, pat);
+        memcpy(smp->inputs, inputs, sizeof(inputs));
+        memcpy(smp->want, wants, sizeof(wants));
+        memcpy(smp->peg, pegs, sizeof(pegs));
+    }
+
+    /**
+     * speed: the searching backends over the same long input, each
+     * credited with the text it had to get through, up to the end of the
+     * match it found or the whole of it. the anchored backends mostly
+     * stop a few bytes in, so there is nothing to time them on.
+     */
+    for (int i = 0; i < SPEED_INPUT; ++i)
+        text[i] = "abcabcd"[fuzz_rand() % 7];
+    text[SPEED_INPUT] = '\0';
+
+    for (int b = 0; b < FUZZ_TIMED; ++b)
+    {
+        double t = fuzz_now();
+        size_t s, e, got = 0;
+        regmatch_t pm[1];
+        re_par_result pr;
+
+        for (int r = 0; r < SPEED_ROUNDS; ++r)
+        {
+            switch (b)
+            {
+                case FUZZ_POSIX:
+                    got += regexec(&anywhere, text, 1, pm, 0) == 0 ? (size_t)pm[0].rm_eo : SPEED_INPUT;
+                    break;
+                case FUZZ_SEARCH:
+                    got += re_search_find(sr, text, SPEED_INPUT, &s, &e) ? e : SPEED_INPUT;
+                    break;
+                case FUZZ_PAR:
+                    /* every match end is counted, so the scan never stops early */
+                    re_par_run(scan, text, SPEED_INPUT, 1, false, &pr);
+                    got += SPEED_INPUT;
+                    break;
+            }
+        }
+        stats[b].secs  += fuzz_now() - t;
+        stats[b].bytes += (double)got;
+    }
+
+    regfree(&anchored);
+    regfree(&anywhere);
+    re_search_free(sr);
+    re_dfa_free(scan);
+    re_dfa_free(dfa);
+    re_jit_free(jit);
+    re_vm_free(vm);
+    re_prog_free(prog);
+    m_arena_reset(&re_arena);
+    return true;
+}
+
+/**
+ * @brief Write the kept patterns out as one batch, through re_conv and
+ * gcc, and check what the matchers it built say of every input against
+ * the interpreter, or against regexec for the tables.
+ *
+ * @param backend FUZZ_CONV, or FUZZ_TABLES for -t.
+ * @return false if the matchers could not be built.
+ */
+bool fuzz_conv(int backend)
+{
+    char cmd[256];
+    void* lib;
+    re_matcher* (*find)(const char*);
+    FILE* fptr = fopen("fuzzconv.mf", "w");
+
+    if (fptr == NULL)
+        return false;
+    for (int k = 0; k < nsamples; ++k)
+        fprintf(fptr, "p%d: %s\n", k, samples[k].pat);
+    fclose(fptr);
+
+    snprintf(cmd, sizeof(cmd), "%s%s fuzzconv.c -b fuzzconv.mf && gcc -O1 -shared -fPIC -DRE_NO_MAIN fuzzconv.c -o fuzzconv.so",
+        FUZZ_REGEXER, backend == FUZZ_TABLES ? " -t" : "");
+    lib = system(cmd) == 0 ? dlopen("./fuzzconv.so", RTLD_NOW) : NULL;
+    remove("fuzzconv.mf");
+    remove("fuzzconv.c");
+    if (lib == NULL) {
+        remove("fuzzconv.so");
+        return false;
+    }
+
+    find = (re_matcher* (*)(const char*))dlsym(lib, "re_find");
+    for (int k = 0; find && k < nsamples; ++k)
+    {
+        char name[16];
+        re_matcher* m;
+
+        snprintf(name, sizeof(name), "p%d", k);
+        if ((m = find(name)) == NULL)
+            continue;
+        for (int i = 0; i < INPUTS; ++i) {
+            bool got = m->match(samples[k].inputs[i]);
+            stats[backend].checks++;
+            if (backend == FUZZ_TABLES && got != samples[k].want[i])
+                fuzz_report(samples[k].pat, samples[k].inputs[i], backend, got ? "does not" : "matches", got ? "a match" : "no match");
+            else if (backend == FUZZ_CONV && got != samples[k].peg[i])
+                fuzz_report(samples[k].pat, samples[k].inputs[i], backend, got ? "interpreter does not" : "interpreter matches", got ? "a match" : "no match");
+        }
+    }
+
+    dlclose(lib);
+    remove("fuzzconv.so");
+    return find != NULL;
+}
+
+/**
+ * @brief Compare throughput with a record of an earlier run, one
+ * "backend MB/s" line per backend.
+ *
+ * @param path Record to read.
+ * @return Number of backends slower than the record by more than SLACK.
+ */
+int fuzz_compare(const char* path)
+{
+    int slow = 0;
+    char line[128];
+    FILE* fptr = fopen(path, "r");
+
+    if (fptr == NULL) {
+        printf("no record at \"%s\" to compare with\n", path);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), fptr)) {
+        double rate;
+        char* tab = strchr(line, '\t');
+        if (tab == NULL || sscanf(tab + 1, "%lf", &rate) != 1)
+            continue;
+        *tab = '\0';
+        for (int b = 0; b < FUZZ_TIMED; ++b) {
+            double now = stats[b].bytes / stats[b].secs / 1e6;
+            if (!strcmp(line, backends[b]) && now < rate * (1 - SLACK)) {
+                printf("%s: %.1f MB/s, down from %.1f\n", backends[b], now, rate);
+                slow++;
+            }
+        }
+    }
+
+    fclose(fptr);
+    return slow;
+}
+
+int main(int argc, char** argv)
+{
+    int count = 2000, rejected = 0, bad = 0;
+    char* record = NULL;
+    bool save = false;
+    char pat[MAX_PATTERN];
+
+    fuzz_seed = (unsigned long long)time(NULL);
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            count = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            fuzz_seed = strtoull(argv[++i], NULL, 10);
+        else if ((!strcmp(argv[i], "-r") || !strcmp(argv[i], "-w")) && i + 1 < argc) {
+            save   = argv[i][1] == 'w';
+            record = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-n patterns] [-s seed] [-r record | -w record]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("seed %llu\n", fuzz_seed);
+    if (fuzz_seed == 0)
+        fuzz_seed = 1;
+
+    for (int i = 0; i < count; ++i) {
+        int len = fuzz_alt(pat, 0, 2);
+        pat[len] = '\0';
+        rejected += !fuzz_pattern(pat);
+    }
+    for (int b = FUZZ_CONV; b <= FUZZ_TABLES; ++b) {
+        if (!fuzz_conv(b)) {
+            printf("%s: could not build the matchers for %d patterns\n", backends[b], nsamples);
+            bad++;
+        }
+    }
+
+    printf("%-12s %8s %6s %10s\n", "backend", "checks", "bad", "MB/s");
+    for (int b = 0; b < FUZZ_BACKENDS; ++b) {
+        if (b < FUZZ_TIMED)
+            printf("%-12s %8ld %6ld %10.1f\n", backends[b], stats[b].checks, stats[b].bad, stats[b].bytes / stats[b].secs / 1e6);
+        else printf("%-12s %8ld %6ld %10s\n", backends[b], stats[b].checks, stats[b].bad, "-");
+        bad += stats[b].bad;
+    }
+    printf("%d patterns, %d rejected by regexer\n", count, rejected);
+
+    if (record && save) {
+        FILE* fptr = fopen(record, "w");
+        for (int b = 0; fptr && b < FUZZ_TIMED; ++b)
+            fprintf(fptr, "%s\t%.1f\n", backends[b], stats[b].bytes / stats[b].secs / 1e6);
+        if (fptr)
+            fclose(fptr);
+    } else if (record)
+        bad += fuzz_compare(record);
+
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
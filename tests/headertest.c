@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+/* header output of jitcases.mf, next to its batch output in jitcases.c */
+#include "jitheader.h"
+
+typedef struct
+re_matcher
+{
+    const char* name;
+    const char* regex;
+    bool (*match)(char*);
+}
+re_matcher;
+
+extern re_matcher* re_find(const char* name);
+
+typedef struct
+re_inline
+{
+    const char* name;
+    bool (*match)(const char*);
+}
+re_inline;
+
+#define ENTRY(n) { #n, re_match_##n }
+
+static const re_inline inlines[] = {
+    ENTRY(atom), ENTRY(twatom), ENTRY(klsimp), ENTRY(klwpref), ENTRY(klwsuf),
+    ENTRY(klwprsuf), ENTRY(rpsimp), ENTRY(rpwsuf), ENTRY(optsimp), ENTRY(optgroup),
+    ENTRY(barsimp), ENTRY(barseq), ENTRY(barkleene), ENTRY(nested), ENTRY(nullable),
+    ENTRY(nullrep), ENTRY(dot), ENTRY(select), ENTRY(negselect), ENTRY(hex),
+    ENTRY(trie), ENTRY(trieprefix), ENTRY(trieshadow), ENTRY(triemixed),
+};
+
+#define INLINE_COUNT ((int)(sizeof(inlines) / sizeof(inlines[0])))
+#define MAX_INPUT 4
+
+static const char alphabet[] = "~abcd0xXF9GE";
+
+/**
+ * @brief Check every string over the alphabet up to a length, comparing an
+ * inline matcher with the batch one for the same pattern.
+ * 
+ * @param in Inline matcher from the header.
+ * @param m Batch matcher.
+ * @param buf Input being built.
+ * @param len Length of buf so far.
+ * @return Number of disagreements found.
+ */
+int header_check(const re_inline* in, re_matcher* m, char* buf, int len)
+{
+    int bad = 0;
+    bool want, got;
+
+    buf[len] = '\0';
+    want = m->match(buf);
+    got  = in->match(buf);
+    if (got != want) {
+        printf("%s: /%s/ on \"%s\": batch %d, header %d\n", m->name, m->regex, buf, want, got);
+        bad++;
+    }
+
+    if (len < MAX_INPUT) {
+        for (int i = 0; alphabet[i]; ++i) {
+            buf[len] = alphabet[i];
+            bad += header_check(in, m, buf, len + 1);
+        }
+    }
+
+    return bad;
+}
+
+int main(void)
+{
+    int bad = 0;
+    char buf[MAX_INPUT + 1];
+
+    for (int i = 0; i < INLINE_COUNT; ++i) {
+        re_matcher* m = re_find(inlines[i].name);
+
+        if (m == NULL) {
+            printf("%s is in the header but not the batch\n", inlines[i].name);
+            bad++;
+            continue;
+        }
+        bad += header_check(&inlines[i], m, buf, 0);
+    }
+
+    printf("%d pattern%s checked against the batch, %d mismatch%s\n",
+        INLINE_COUNT, INLINE_COUNT == 1 ? "" : "s", bad, bad == 1 ? "" : "es");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
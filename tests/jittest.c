@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../regexer.h"
+#include "../backend/prog/prog.h"
+#include "../backend/vm/vm.h"
+#include "../backend/jit/jit.h"
+
+/* from the batch output of jitcases.mf, built with RE_NO_MAIN */
+typedef struct
+re_matcher
+{
+    const char* name;
+    const char* regex;
+    bool (*match)(char*);
+}
+re_matcher;
+
+extern re_matcher re_matchers[];
+extern const int re_matcher_count;
+
+#define MAX_INPUT 5
+
+/**
+ * @brief Collect a byte no pattern mentions, then the ones a pattern does.
+ * 
+ * @param regex Pattern text.
+ * @param alpha Buffer of at least 256 bytes for the alphabet.
+ * @return Length of the alphabet.
+ */
+int jit_alphabet(const char* regex, char* alpha)
+{
+    int n = 0;
+    bool seen[256] = { false };
+
+    alpha[n++] = '~';
+    for (; *regex; ++regex) {
+        unsigned char c = *regex;
+        if (strchr("()[]|*+?^-\\", c) || seen[c])
+            continue;
+        seen[c] = true;
+        alpha[n++] = c;
+    }
+    return n;
+}
+
+/**
+ * @brief Check every string over an alphabet up to a length, comparing the
+ * re_conv matcher with the interpreter, the bytecode vm and the jit.
+ * 
+ * @param m Matcher generated by re_conv.
+ * @param prog Program compiled from the same pattern.
+ * @param vm Bytecode encoded from prog.
+ * @param jit Jit compiled from prog.
+ * @param alpha Alphabet to draw from.
+ * @param n Alphabet size.
+ * @param buf Input being built.
+ * @param len Length of buf so far.
+ * @return Number of disagreements found.
+ */
+int jit_check(re_matcher* m, re_prog* prog, re_vm* vm, re_jit* jit, char* alpha, int n, char* buf, int len)
+{
+    int bad = 0;
+    bool want, run, byte, got;
+
+    buf[len] = '\0';
+    want = m->match(buf);
+    run  = re_prog_run(prog, buf);
+    byte = re_vm_run(vm, buf);
+    got  = re_jit_match(jit, buf);
+
+    if (run != want || byte != want || got != want) {
+        printf("%s: /%s/ on \"%s\": re_conv %d, interpreter %d, vm %d, jit %d\n", m->name, m->regex, buf, want, run, byte, got);
+        bad++;
+    }
+
+    if (len < MAX_INPUT) {
+        for (int i = 0; i < n; ++i) {
+            buf[len] = alpha[i];
+            bad += jit_check(m, prog, vm, jit, alpha, n, buf, len + 1);
+        }
+    }
+
+    return bad;
+}
+
+int main(void)
+{
+    int bad = 0;
+    char alpha[256];
+    char buf[MAX_INPUT + 1];
+
+    for (int i = 0; i < re_matcher_count; ++i) {
+        re_matcher* m = &re_matchers[i];
+        re_prog* prog = re_prog_compile(re_read((char*)m->regex));
+        re_vm* vm     = re_vm_compile(prog);
+        re_jit* jit   = re_jit_compile(prog);
+        int n         = jit_alphabet(m->regex, alpha);
+
+        /* long alphabets would make the search explode */
+        if (n > 6) n = 6;
+        bad += jit_check(m, prog, vm, jit, alpha, n, buf, 0);
+
+        re_jit_free(jit);
+        re_vm_free(vm);
+        re_prog_free(prog);
+    }
+
+    printf("%d pattern%s checked against re_conv (%s), %d mismatch%s\n",
+        re_matcher_count, re_matcher_count == 1 ? "" : "s",
+        RE_JIT_NATIVE ? "native" : "interpreted", bad, bad == 1 ? "" : "es");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "../types/bstree/bstree.h"
+#include "../types/map/maps.h"
+
+/* longest key made, in bytes */
+#define MAP_MAX_KEY 40
+
+/**
+ * The map as it was before it was made flat: one AVL tree ordered by
+ * hash and then by key, each node and each value a malloc of its own.
+ * Keys are NUL terminated, as that map needed. The tree is also timed
+ * built in one go from sorted entries, and checked to keep a snapshot
+ * whole while the tree it was taken from changes.
+ */
+typedef struct
+tree_entry
+{
+    uint64_t hash;                              // Hash of the key
+    char* key;                                  // The key itself
+    void* value;                                // Value, allocated on its own
+}
+tree_entry;
+
+typedef struct
+map_key
+{
+    char bytes[MAP_MAX_KEY + 1];                // Key, NUL terminated for the tree
+    int len;                                    // Its length
+}
+map_key;
+
+static unsigned long long map_seed = 1;
+
+static unsigned
+map_rand(void)
+{
+    map_seed ^= map_seed << 13;
+    map_seed ^= map_seed >> 7;
+    map_seed ^= map_seed << 17;
+    return (unsigned)(map_seed >> 16);
+}
+
+static double
+map_now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int
+tree_comp(const void* a, const void* b)
+{
+    const tree_entry* x = (const tree_entry*)a;
+    const tree_entry* y = (const tree_entry*)b;
+
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return strcmp(x->key, y->key);
+}
+
+static int
+tree_check(void* item, void* arg)
+{
+    tree_entry** last = (tree_entry**)arg;
+    int bad = *last != NULL && tree_comp(*last, item) >= 0;
+
+    *last = (tree_entry*)item;
+    return bad;
+}
+
+static int
+tree_free(void* item, void* arg)
+{
+    free(((tree_entry*)item)->value);
+    return 0;
+}
+
+/* keys like a determiniser's: a state number, then a run of random bytes with no NULs */
+static void
+map_make_key(map_key* k, int i)
+{
+    int len = snprintf(k->bytes, sizeof(k->bytes), "%d:", i);
+    int more = map_rand() % (MAP_MAX_KEY - len);
+
+    for (int j = 0; j < more; ++j)
+        k->bytes[len++] = 1 + map_rand() % 255;
+    k->bytes[len] = '\0';
+    k->len = len;
+}
+
+int main(int argc, char** argv)
+{
+    int n = 200000, bad = 0;
+    double t0, t[12];
+    map_key* keys;
+    map_key* misses;
+    tree_entry* sorted;
+    tree_entry* last;
+    m_hashmap* map;
+    m_bstree* tree;
+    m_bstree* snap;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            n = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            map_seed = strtoull(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "usage: %s [-n keys] [-s seed]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (n < 1 || map_seed == 0) {
+        fprintf(stderr, "need at least one key and a nonzero seed.\n");
+        return EXIT_FAILURE;
+    }
+
+    keys   = (map_key*)malloc(n * sizeof(map_key));
+    misses = (map_key*)malloc(n * sizeof(map_key));
+    for (int i = 0; i < n; ++i) {
+        map_make_key(&keys[i], i);
+        map_make_key(&misses[i], n + i);
+    }
+
+    /* the flat map: values are the key's index, kept in place */
+    map = m_hashmap_create(int, NULL);
+    t0 = map_now();
+    for (int i = 0; i < n; ++i)
+        m_hashmap_insert(map, keys[i].bytes, keys[i].len, &i);
+    t[0] = map_now();
+    for (int i = 0; i < n; ++i) {
+        int* v = (int*)m_hashmap_find(map, keys[i].bytes, keys[i].len);
+        bad += v == NULL || *v != i;
+    }
+    t[1] = map_now();
+    for (int i = 0; i < n; ++i)
+        bad += m_hashmap_find(map, misses[i].bytes, misses[i].len) != NULL;
+    t[2] = map_now();
+    for (int i = 0; i < n; i += 2)
+        bad += m_hashmap_erase(map, keys[i].bytes, keys[i].len) != EXIT_SUCCESS;
+    t[3] = map_now();
+    for (int i = 0; i < n; ++i) {
+        int* v = (int*)m_hashmap_find(map, keys[i].bytes, keys[i].len);
+        bad += i % 2 ? v == NULL || *v != i : v != NULL;
+    }
+    bad += m_hashmap_count(map) != (size_t)n / 2;
+    m_hashmap_destroy(map);
+
+    /* the tree, as the map used to be */
+    tree = m_bstree_create(tree_entry, tree_comp);
+    t[4] = map_now();
+    for (int i = 0; i < n; ++i) {
+        tree_entry e = { .hash = m_hashmap_def_hashfunc((unsigned char*)keys[i].bytes), .key = keys[i].bytes };
+        e.value = malloc(sizeof(int));
+        *(int*)e.value = i;
+        m_bstree_add(tree, &e);
+    }
+    t[5] = map_now();
+    for (int i = 0; i < n; ++i) {
+        tree_entry e = { .hash = m_hashmap_def_hashfunc((unsigned char*)keys[i].bytes), .key = keys[i].bytes };
+        tree_entry* f = (tree_entry*)m_bstree_find(tree, &e);
+        bad += f == NULL || *(int*)f->value != i;
+    }
+    t[6] = map_now();
+    for (int i = 0; i < n; ++i) {
+        tree_entry e = { .hash = m_hashmap_def_hashfunc((unsigned char*)misses[i].bytes), .key = misses[i].bytes };
+        bad += m_bstree_find(tree, &e) != NULL;
+    }
+    t[7] = map_now();
+    for (int i = 0; i < n; i += 2) {
+        tree_entry e = { .hash = m_hashmap_def_hashfunc((unsigned char*)keys[i].bytes), .key = keys[i].bytes };
+        tree_entry* f = (tree_entry*)m_bstree_find(tree, &e);
+        if (f != NULL)
+            free(f->value);
+        bad += m_bstree_remove(tree, &e) != 0;
+    }
+    t[8] = map_now();
+    for (int i = 0; i < n; ++i) {
+        tree_entry e = { .hash = m_hashmap_def_hashfunc((unsigned char*)keys[i].bytes), .key = keys[i].bytes };
+        tree_entry* f = (tree_entry*)m_bstree_find(tree, &e);
+        bad += i % 2 ? f == NULL || *(int*)f->value != i : f != NULL;
+    }
+    last = NULL;
+    bad += m_bstree_size(tree) != n / 2 || m_bstree_walk(tree, tree_check, &last) != 0;
+    m_bstree_walk(tree, tree_free, NULL);
+    m_bstree_destroy(tree);
+
+    /* the tree again, built from sorted entries whose values point into the keys */
+    sorted = (tree_entry*)malloc(n * sizeof(tree_entry));
+    for (int i = 0; i < n; ++i) {
+        sorted[i].hash  = m_hashmap_def_hashfunc((unsigned char*)keys[i].bytes);
+        sorted[i].key   = keys[i].bytes;
+        sorted[i].value = &keys[i].len;
+    }
+    qsort(sorted, n, sizeof(tree_entry), tree_comp);
+    t[9] = map_now();
+    tree = m_bstree_build(sizeof(tree_entry), tree_comp, sorted, n);
+    t[10] = map_now();
+    if (tree == NULL) {
+        fprintf(stderr, "sorted entries were not taken as sorted.\n");
+        return EXIT_FAILURE;
+    }
+    if (n > 1) {
+        tree_entry swapped[2] = { sorted[1], sorted[0] };
+        bad += m_bstree_build(sizeof(tree_entry), tree_comp, swapped, 2) != NULL;
+    }
+
+    /* a snapshot must not see the tree it came from lose half its keys */
+    snap = m_bstree_copy(tree);
+    for (int i = 0; i < n; i += 2)
+        bad += m_bstree_remove(tree, &sorted[i]) != 0;
+    t[11] = map_now();
+    for (int i = 0; i < n; ++i) {
+        tree_entry* f = (tree_entry*)m_bstree_find(snap, &sorted[i]);
+        tree_entry* g = (tree_entry*)m_bstree_find(tree, &sorted[i]);
+        bad += f == NULL || f->value != sorted[i].value;
+        bad += i % 2 ? g == NULL : g != NULL;
+    }
+    last = NULL;
+    bad += m_bstree_size(snap) != n || m_bstree_walk(snap, tree_check, &last) != 0;
+    last = NULL;
+    bad += m_bstree_size(tree) != n / 2 || m_bstree_walk(tree, tree_check, &last) != 0;
+    m_bstree_destroy(snap);
+    m_bstree_destroy(tree);
+
+    printf("%d keys\n", n);
+    printf("%-8s %12s %12s %8s\n", "ns/op", "flat map", "tree", "speedup");
+    printf("%-8s %12.1f %12.1f %7.1fx\n", "insert", (t[0] - t0) / n * 1e9, (t[5] - t[4]) / n * 1e9, (t[5] - t[4]) / (t[0] - t0));
+    printf("%-8s %12.1f %12.1f %7.1fx\n", "hit", (t[1] - t[0]) / n * 1e9, (t[6] - t[5]) / n * 1e9, (t[6] - t[5]) / (t[1] - t[0]));
+    printf("%-8s %12.1f %12.1f %7.1fx\n", "miss", (t[2] - t[1]) / n * 1e9, (t[7] - t[6]) / n * 1e9, (t[7] - t[6]) / (t[2] - t[1]));
+    printf("%-8s %12.1f %12.1f %7.1fx\n", "erase", (t[3] - t[2]) / ((n + 1) / 2) * 1e9, (t[8] - t[7]) / ((n + 1) / 2) * 1e9, (t[8] - t[7]) / (t[3] - t[2]));
+    printf("tree built from sorted entries: %.1f ns/key, %.1fx faster than adding them\n", (t[10] - t[9]) / n * 1e9, (t[5] - t[4]) / (t[10] - t[9]));
+    printf("tree erase beside a snapshot: %.1f ns/op\n", (t[11] - t[10]) / ((n + 1) / 2) * 1e9);
+    printf("%d wrong result%s\n", bad, bad == 1 ? "" : "s");
+
+    free(sorted);
+    free(keys);
+    free(misses);
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../regexer.h"
+#include "../backend/dfa/dfa.h"
+#include "../backend/par/par.h"
+
+#define TEXT_SIZE (9 * RE_PAR_MIN_CHUNK + 123)
+
+static const char* patterns[] = {
+    "abc", "a(b|c)*x", "x[^a]*x", "(ab)+", "a.{3}b", "cccccccc", "[ax]+b?", "b*",
+};
+
+static const char alphabet[] = "abcx";
+
+#define PATTERN_COUNT ((int)(sizeof(patterns) / sizeof(patterns[0])))
+
+/**
+ * @brief Run an automaton over a text on one thread, the plain way.
+ * 
+ * @param dfa Automaton to run.
+ * @param text Text to run over.
+ * @param len Length of text.
+ * @param state Where the final state goes.
+ * @return Offsets at which the automaton accepted.
+ */
+size_t par_plain(re_dfa* dfa, const char* text, size_t len, int* state)
+{
+    int s = dfa->start;
+    size_t count = dfa->accepts[s + 1] > dfa->accepts[s];
+
+    for (size_t i = 0; i < len; ++i) {
+        s = dfa->trans[s * dfa->nclasses + dfa->classes[(unsigned char)text[i]]];
+        count += dfa->accepts[s + 1] > dfa->accepts[s];
+    }
+    *state = s;
+    return count;
+}
+
+/**
+ * @brief Compare every thread count with the plain run, counting and
+ * stopping at the first accept.
+ * 
+ * @param name What is being run, for the report.
+ * @param dfa Automaton to run.
+ * @param text Text to run over.
+ * @param len Length of text.
+ * @return Number of disagreements found.
+ */
+int par_check(const char* name, re_dfa* dfa, const char* text, size_t len)
+{
+    int bad = 0, state;
+    size_t want = par_plain(dfa, text, len, &state);
+    re_par_result res;
+
+    for (int t = 1; t <= 12; ++t) {
+        re_par_run(dfa, text, len, t, false, &res);
+        if (res.count != want || res.state != state || res.any != (want > 0)) {
+            printf("%s, %d threads: want %zu ending in %d, got %zu ending in %d\n", name, t, want, state, res.count, res.state);
+            bad++;
+        }
+        re_par_run(dfa, text, len, t, true, &res);
+        if (res.any != (want > 0)) {
+            printf("%s, %d threads: want %s, got %s\n", name, t, want ? "a match" : "none", res.any ? "a match" : "none");
+            bad++;
+        }
+    }
+
+    return bad;
+}
+
+int main(void)
+{
+    int bad = 0;
+    char* text = (char*)malloc(TEXT_SIZE);
+    char* quiet = (char*)malloc(TEXT_SIZE);
+
+    srand(39);
+    for (int i = 0; i < TEXT_SIZE; ++i) {
+        text[i]  = alphabet[rand() % 4];
+        quiet[i] = 'c';
+    }
+    /* one match, late in a text that has none before it */
+    memcpy(quiet + TEXT_SIZE - 100, "abcabxaxxbcc", 12);
+
+    for (int i = 0; i < PATTERN_COUNT; ++i) {
+        re_exp* re = re_read((char*)patterns[i]);
+        re_dfa* anywhere = re_dfa_compile(&re, 1, 0, RE_DFA_ANYWHERE);
+        re_dfa* anchored = re_dfa_build(&re, 1, 0);
+
+        bad += par_check(patterns[i], anywhere, text, TEXT_SIZE);
+        bad += par_check(patterns[i], anywhere, quiet, TEXT_SIZE);
+        bad += par_check(patterns[i], anywhere, text, 1000);
+        bad += par_check(patterns[i], anchored, text, TEXT_SIZE);
+
+        re_dfa_free(anywhere);
+        re_dfa_free(anchored);
+    }
+
+    free(text);
+    free(quiet);
+    printf("%d pattern%s run in parallel, %d mismatch%s\n",
+        PATTERN_COUNT, PATTERN_COUNT == 1 ? "" : "s", bad, bad == 1 ? "" : "es");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
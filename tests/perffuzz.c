@@ -0,0 +1,596 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include <math.h>
+#include <time.h>
+#include <dirent.h>
+
+#include "../regexer.h"
+#include "../backend/prog/prog.h"
+#include "../backend/vm/vm.h"
+#include "../backend/jit/jit.h"
+#include "../backend/dfa/dfa.h"
+#include "../backend/search/search.h"
+
+/*
+ * Built with RE_COUNT_WORK this fuzzes; built without, only -b works, so
+ * the fixtures are timed without the counters slowing the matchers.
+ */
+
+#define CORPUS_MAX 512
+#define ALPHABET_MAX 64
+#define BENCH_BYTES (1 << 22)
+
+static double
+perf_now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+#ifdef RE_COUNT_WORK
+/* work a byte that any of the matchers may do without being suspect */
+#define PERF_LINEAR 8
+
+/* patterns known to make matchers work hard, tried when none are given */
+static const char* patterns[] = {
+    "(a|aa)*b", "(a|ab)*c", "(a+)+b", "(ab|a)(bc|c)*d", ".*.*=.*", "x[ab]*a",
+    "[ab]*b[ab]*c", ".*a.*a.*a", "(a|b)*abb", "(.*,)*x",
+};
+
+#define PATTERN_COUNT ((int)(sizeof(patterns) / sizeof(patterns[0])))
+
+/**
+ * What an input is scored on. The first three are work the matchers do;
+ * the last is how many automaton states the input walks through, which
+ * costs no more per byte but is where a lazily built automaton would
+ * spend its time building.
+ */
+enum { PERF_STEPS, PERF_BACKTRACKS, PERF_SEARCH, PERF_STATES, PERF_METRICS };
+
+static const char* metrics[PERF_METRICS] = { "steps", "backtracks", "search", "states" };
+
+typedef struct
+perf_input
+{
+    char* text;                                 // NUL terminated input
+    int len;                                    // Its length
+}
+perf_input;
+
+typedef struct
+perf_target
+{
+    const char* pat;                            // Pattern being fuzzed
+    re_prog* prog;                              // Its program, counting work
+    re_dfa* dfa;                                // Its anchored automaton
+    re_search* sr;                              // Its searcher, or NULL if too large
+    unsigned* hits;                             // Runs per instruction on the last input
+    unsigned char* seen;                        // Hit count buckets seen per instruction
+    unsigned char* states;                      // Automaton states ever visited
+    unsigned searched;                          // Search work buckets seen
+    char alphabet[ALPHABET_MAX];                // Bytes worth trying
+    int nalpha;                                 // Length of alphabet
+    perf_input corpus[CORPUS_MAX];              // Inputs that found something new
+    int ncorpus;                                // Length of corpus
+    perf_input worst[PERF_METRICS];             // Highest scoring input per metric
+    size_t score[PERF_METRICS];                 // Its score
+}
+perf_target;
+
+static unsigned long long perf_seed;
+
+static unsigned
+perf_rand(void)
+{
+    perf_seed ^= perf_seed << 13;
+    perf_seed ^= perf_seed >> 7;
+    perf_seed ^= perf_seed << 17;
+    return (unsigned)(perf_seed >> 16);
+}
+
+/* bucket a count the way coverage fuzzers do, so 3 and 4 differ but 40 and 41 do not */
+static unsigned
+perf_bucket(size_t n)
+{
+    int b = 0;
+
+    if (n == 0)
+        return 0;
+    while (n > 1 && b < 7)
+        n >>= 1, b++;
+    return 1u << b;
+}
+
+static perf_input
+perf_copy(const char* text, int len)
+{
+    perf_input in = { (char*)malloc(len + 1), len };
+
+    memcpy(in.text, text, len);
+    in.text[len] = '\0';
+    return in;
+}
+
+/**
+ * @brief Run every counting matcher over an input, scoring it and noting
+ * whether it reached anything no earlier input did.
+ *
+ * @param t Target to run.
+ * @param text Input, NUL terminated.
+ * @param len Length of text.
+ * @param score Where the score for each metric goes.
+ * @return Whether the input covered something new.
+ */
+bool perf_run(perf_target* t, const char* text, int len, size_t* score)
+{
+    bool fresh = false;
+    int state = t->dfa->start;
+    size_t s, e, visited = 0;
+
+    memset(t->hits, 0, t->prog->count * sizeof(unsigned));
+    memset(&re_prog_counters, 0, sizeof(re_prog_counters));
+    re_prog_counters.hits = t->hits;
+    re_prog_run(t->prog, (char*)text);
+    re_prog_counters.hits = NULL;
+    score[PERF_STEPS]      = re_prog_counters.steps;
+    score[PERF_BACKTRACKS] = re_prog_counters.backtracks;
+
+    for (int pc = 0; pc < t->prog->count; ++pc) {
+        unsigned b = perf_bucket(t->hits[pc]);
+        if (b & ~t->seen[pc]) {
+            t->seen[pc] |= b;
+            fresh = true;
+        }
+    }
+
+    memset(&re_search_counters, 0, sizeof(re_search_counters));
+    if (t->sr)
+        re_search_find(t->sr, text, len, &s, &e);
+    score[PERF_SEARCH] = re_search_counters.steps + re_search_counters.candidates;
+    if (perf_bucket(score[PERF_SEARCH] / (len + 1)) & ~t->searched) {
+        t->searched |= perf_bucket(score[PERF_SEARCH] / (len + 1));
+        fresh = true;
+    }
+
+    /* the states walked through, stepping the table the way re_dfa_match does */
+    for (int i = 0; i <= len && state != 0; ++i) {
+        if (!(t->states[state] & 2)) {
+            t->states[state] |= 2;
+            visited++;
+        }
+        if (!(t->states[state] & 1)) {
+            t->states[state] |= 1;
+            fresh = true;
+        }
+        if (i < len)
+            state = t->dfa->trans[state * t->dfa->nclasses + t->dfa->classes[(unsigned char)text[i]]];
+    }
+    for (int q = 0; q < t->dfa->nstates; ++q)
+        t->states[q] &= 1;
+    score[PERF_STATES] = visited;
+
+    return fresh;
+}
+
+/**
+ * @brief Change an input in one to four random ways. Copying a slice of
+ * the input back into it is what builds the long runs of one structure
+ * that superlinear matching needs.
+ *
+ * @param t Target, for its alphabet and corpus.
+ * @param buf Input to change, with room for max bytes and a NUL.
+ * @param len Length of buf.
+ * @param max Longest an input may grow.
+ * @return New length of buf.
+ */
+int perf_mutate(perf_target* t, char* buf, int len, int max)
+{
+    int rounds = 1 + perf_rand() % 4;
+
+    while (rounds--)
+    {
+        int at = len ? perf_rand() % len : 0;
+        char c = t->alphabet[perf_rand() % t->nalpha];
+
+        switch (perf_rand() % 7)
+        {
+            case 0:
+                if (len)
+                    buf[at] = c;
+                break;
+
+            case 1:
+                if (len < max) {
+                    memmove(buf + at + 1, buf + at, len - at);
+                    buf[at] = c;
+                    len++;
+                }
+                break;
+
+            case 2:
+                if (len) {
+                    memmove(buf + at, buf + at + 1, len - at - 1);
+                    len--;
+                }
+                break;
+
+            case 3: {
+                /* copy a slice in after itself */
+                int n = len - at < 16 ? len - at : 1 + (int)(perf_rand() % 16);
+                if (len + n > max)
+                    n = max - len;
+                memmove(buf + at + 2 * n, buf + at + n, len - at - n);
+                memcpy(buf + at + n, buf + at, n);
+                len += n;
+                break;
+            }
+
+            case 4: {
+                /* double the whole input, as far as it fits */
+                int n = len < max - len ? len : max - len;
+                memcpy(buf + len, buf, n);
+                len += n;
+                break;
+            }
+
+            case 5: {
+                /* splice in the end of another input */
+                perf_input* o = &t->corpus[perf_rand() % t->ncorpus];
+                int from = o->len ? perf_rand() % o->len : 0;
+                int n = o->len - from < max - at ? o->len - from : max - at;
+                memcpy(buf + at, o->text + from, n);
+                len = at + n;
+                break;
+            }
+
+            default:
+                if (len < max)
+                    buf[len++] = c;
+                break;
+        }
+    }
+
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * @brief Bytes of a pattern that are not its syntax, plus a few it never
+ * uses, as the alphabet inputs are drawn from.
+ *
+ * @param t Target whose alphabet is filled.
+ */
+void perf_alphabet(perf_target* t)
+{
+    bool have[256] = { 0 };
+
+    have[0] = true;
+    for (const char* p = t->pat; *p; ++p) {
+        unsigned char c = (unsigned char)*p;
+        if (!have[c] && !strchr("()|*+?[]^\\-", c) && t->nalpha < ALPHABET_MAX - 4) {
+            have[c] = true;
+            t->alphabet[t->nalpha++] = c == '.' ? 'z' : (char)c;
+        }
+    }
+    for (const char* p = "xy,\n"; *p; ++p)
+        if (!have[(unsigned char)*p])
+            t->alphabet[t->nalpha++] = *p;
+}
+
+/**
+ * @brief How work grows with input length: the exponent k for which a
+ * worst input of length n costs about n^k, from running it and its first
+ * half. Inputs built from one repeated slice halve cleanly; others give a
+ * rough figure, so work of under PERF_LINEAR a byte is not estimated.
+ *
+ * @param t Target.
+ * @param m Metric.
+ * @return Estimated exponent, 0 when the work is too small to tell.
+ */
+double perf_growth(perf_target* t, int m)
+{
+    size_t full[PERF_METRICS], half[PERF_METRICS];
+    perf_input* in = &t->worst[m];
+    int n = in->len / 2;
+    char c;
+
+    if (in->len < 16 || t->score[m] < (size_t)in->len * PERF_LINEAR)
+        return 0;
+
+    perf_run(t, in->text, in->len, full);
+    c = in->text[n];
+    in->text[n] = '\0';
+    perf_run(t, in->text, n, half);
+    in->text[n] = c;
+
+    return half[m] ? log((double)full[m] / half[m]) / log(2.0) : 0;
+}
+
+/**
+ * @brief Write the worst input for each metric as a fixture: the pattern
+ * on the first line, the metric and its score on the second, the input
+ * after that.
+ *
+ * @param t Target.
+ * @param index Number of the pattern, for the file names.
+ * @param dir Directory to write into.
+ */
+void perf_fixture(perf_target* t, int index, const char* dir)
+{
+    char path[512];
+
+    for (int m = 0; m < PERF_METRICS; ++m) {
+        FILE* fptr;
+        if (t->worst[m].text == NULL || t->worst[m].len == 0 || t->score[m] == 0)
+            continue;
+        snprintf(path, sizeof(path), "%s/perf%02d-%s.fix", dir, index, metrics[m]);
+        if ((fptr = fopen(path, "wb")) == NULL) {
+            fprintf(stderr, "could not write \"%s\"\n", path);
+            continue;
+        }
+        fprintf(fptr, "%s\n%s %zu\n", t->pat, metrics[m], t->score[m]);
+        fwrite(t->worst[m].text, 1, t->worst[m].len, fptr);
+        fclose(fptr);
+    }
+}
+
+/**
+ * @brief Search for the inputs that make one pattern's matchers work
+ * hardest, reporting each metric's worst and how it grows.
+ *
+ * @param pat Pattern to fuzz.
+ * @param index Number of the pattern.
+ * @param execs Inputs to try.
+ * @param max Longest input.
+ * @param dir Where fixtures go, or NULL.
+ * @return Largest growth exponent seen, or -1 if the pattern was rejected.
+ */
+double perf_pattern(const char* pat, int index, int execs, int max, const char* dir)
+{
+    jmp_buf env;
+    re_exp* re;
+    perf_target t = { .pat = pat };
+    size_t score[PERF_METRICS];
+    char* buf = (char*)malloc(max + 1);
+    double worst = 0;
+
+    re_recover = &env;
+    if (setjmp(env)) {
+        re_recover = NULL;
+        m_arena_reset(&re_arena);
+        printf("/%s/: %.*s\n", pat, (int)strcspn(re_errmsg, "\n"), re_errmsg);
+        free(buf);
+        return -1;
+    }
+    re = re_read((char*)pat);
+    re_recover = NULL;
+
+    t.prog   = re_prog_compile(re);
+    t.dfa    = re_dfa_build(&re, 1, 0);
+    t.sr     = re_search_build(re, 0);
+    t.hits   = (unsigned*)malloc(t.prog->count * sizeof(unsigned));
+    t.seen   = (unsigned char*)calloc(t.prog->count, 1);
+    t.states = (unsigned char*)calloc(t.dfa->nstates, 1);
+    perf_alphabet(&t);
+
+    t.corpus[t.ncorpus++] = perf_copy("", 0);
+    for (int i = 0; i < t.nalpha; ++i)
+        t.corpus[t.ncorpus++] = perf_copy(&t.alphabet[i], 1);
+    for (int i = 0; i < t.ncorpus; ++i)
+        perf_run(&t, t.corpus[i].text, t.corpus[i].len, score);
+
+    for (int x = 0; x < execs; ++x)
+    {
+        /* work from the worst inputs half the time, so they keep growing */
+        perf_input* from = perf_rand() % 2 && t.worst[perf_rand() % PERF_METRICS].text
+            ? &t.worst[perf_rand() % PERF_METRICS] : &t.corpus[perf_rand() % t.ncorpus];
+        int len;
+
+        if (from->text == NULL)
+            from = &t.corpus[0];
+        memcpy(buf, from->text, from->len);
+        len = perf_mutate(&t, buf, from->len, max);
+
+        if (perf_run(&t, buf, len, score))
+        {
+            if (t.ncorpus < CORPUS_MAX)
+                t.corpus[t.ncorpus++] = perf_copy(buf, len);
+            else {
+                int k = perf_rand() % CORPUS_MAX;
+                free(t.corpus[k].text);
+                t.corpus[k] = perf_copy(buf, len);
+            }
+        }
+        for (int m = 0; m < PERF_METRICS; ++m) {
+            if (score[m] > t.score[m] || (score[m] == t.score[m] && t.worst[m].text && len < t.worst[m].len)) {
+                free(t.worst[m].text);
+                t.worst[m] = perf_copy(buf, len);
+                t.score[m] = score[m];
+            }
+        }
+    }
+
+    printf("/%s/: %d instructions, %d states, %d inputs kept\n", pat, t.prog->count, t.dfa->nstates, t.ncorpus);
+    for (int m = 0; m < PERF_METRICS; ++m) {
+        double k = perf_growth(&t, m);
+        int len = t.worst[m].text ? t.worst[m].len : 0;
+        printf("  %-11s %10zu over %4d bytes, %7.2f a byte", metrics[m], t.score[m], len, len ? (double)t.score[m] / len : 0.0);
+        if (m != PERF_STATES && k > 0)
+            printf(", grows as n^%.1f%s", k, k > 1.5 ? "  <- superlinear" : "");
+        printf("\n");
+        if (m != PERF_STATES && k > worst)
+            worst = k;
+    }
+    if (dir)
+        perf_fixture(&t, index, dir);
+
+    for (int i = 0; i < t.ncorpus; ++i)
+        free(t.corpus[i].text);
+    for (int m = 0; m < PERF_METRICS; ++m)
+        free(t.worst[m].text);
+    free(t.hits);
+    free(t.seen);
+    free(t.states);
+    if (t.sr)
+        re_search_free(t.sr);
+    re_dfa_free(t.dfa);
+    re_prog_free(t.prog);
+    m_arena_reset(&re_arena);
+    free(buf);
+    return worst;
+}
+
+#endif
+
+/**
+ * @brief Time every backend on each fixture in a directory, repeating the
+ * input until about BENCH_BYTES have been matched.
+ *
+ * @param dir Directory of fixtures from -o.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the directory cannot be read.
+ */
+int perf_bench(const char* dir)
+{
+    DIR* d = opendir(dir);
+    struct dirent* ent;
+
+    if (d == NULL) {
+        fprintf(stderr, "could not open \"%s\"\n", dir);
+        return EXIT_FAILURE;
+    }
+
+    printf("%-24s %-18s %6s %9s %9s %9s %9s %9s\n", "fixture", "pattern", "bytes", "interp", "vm", "jit", "dfa", "search");
+    while ((ent = readdir(d)) != NULL)
+    {
+        char path[512], pat[256], *text;
+        long size;
+        int len, rounds;
+        FILE* fptr;
+        re_exp* re;
+        re_prog* prog;
+        re_vm* vm;
+        re_jit* jit;
+        re_dfa* dfa;
+        re_search* sr;
+        double ns[5];
+
+        if (strlen(ent->d_name) < 5 || strcmp(ent->d_name + strlen(ent->d_name) - 4, ".fix"))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if ((fptr = fopen(path, "rb")) == NULL)
+            continue;
+
+        fseek(fptr, 0, SEEK_END);
+        size = ftell(fptr);
+        rewind(fptr);
+        text = (char*)malloc(size + 1);
+        if (!fgets(pat, sizeof(pat), fptr) || !fgets(text, size + 1, fptr)) {
+            fclose(fptr);
+            free(text);
+            continue;
+        }
+        pat[strcspn(pat, "\n")] = '\0';
+        len = (int)fread(text, 1, size, fptr);
+        text[len] = '\0';
+        fclose(fptr);
+
+        re     = re_read(pat);
+        prog   = re_prog_compile(re);
+        vm     = re_vm_compile(prog);
+        jit    = re_jit_compile(prog);
+        dfa    = re_dfa_build(&re, 1, 0);
+        sr     = re_search_build(re, 0);
+        rounds = BENCH_BYTES / (len + 1) + 1;
+
+        for (int b = 0; b < 5; ++b) {
+            double t0 = perf_now();
+            size_t s, e;
+            for (int r = 0; r < rounds; ++r) {
+                switch (b) {
+                    case 0: re_prog_run(prog, text); break;
+                    case 1: re_vm_run(vm, text); break;
+                    case 2: re_jit_match(jit, text); break;
+                    case 3: re_dfa_match(dfa, text); break;
+                    case 4: if (sr) re_search_find(sr, text, len, &s, &e); break;
+                }
+            }
+            ns[b] = (perf_now() - t0) * 1e9 / ((double)rounds * (len + 1));
+        }
+        printf("%-24s %-18s %6d %6.2f ns %6.2f ns %6.2f ns %6.2f ns %6.2f ns\n",
+            ent->d_name, pat, len, ns[0], ns[1], ns[2], ns[3], ns[4]);
+
+        if (sr)
+            re_search_free(sr);
+        re_dfa_free(dfa);
+        re_jit_free(jit);
+        re_vm_free(vm);
+        re_prog_free(prog);
+        m_arena_reset(&re_arena);
+        free(text);
+    }
+
+    closedir(d);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv)
+{
+#ifndef RE_COUNT_WORK
+    if (argc == 3 && !strcmp(argv[1], "-b"))
+        return perf_bench(argv[2]);
+    fprintf(stderr, "%s: built without RE_COUNT_WORK, so only -b works\n", argv[0]);
+    return EXIT_FAILURE;
+#else
+    int execs = 20000, max = 256, npats = 0;
+    double limit = 0, worst = 0;
+    const char* dir = NULL;
+    const char** pats = (const char**)malloc((argc + PATTERN_COUNT) * sizeof(char*));
+
+    perf_seed = (unsigned long long)time(NULL);
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc)
+            execs = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            max = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-s") && i + 1 < argc)
+            perf_seed = strtoull(argv[++i], NULL, 10);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            dir = argv[++i];
+        else if (!strcmp(argv[i], "-g") && i + 1 < argc)
+            limit = atof(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && i + 1 < argc)
+            return perf_bench(argv[++i]);
+        else if (argv[i][0] != '-')
+            pats[npats++] = argv[i];
+        else {
+            fprintf(stderr, "usage: %s [-n inputs] [-m max length] [-s seed] [-o fixture dir] [-g growth limit] [pattern ...]\n"
+                            "       %s -b fixture dir\n", argv[0], argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (npats == 0)
+        for (; npats < PATTERN_COUNT; ++npats)
+            pats[npats] = patterns[npats];
+
+    printf("seed %llu\n", perf_seed);
+    if (perf_seed == 0)
+        perf_seed = 1;
+
+    for (int i = 0; i < npats; ++i) {
+        double k = perf_pattern(pats[i], i, execs, max, dir);
+        if (k > worst)
+            worst = k;
+    }
+
+    free(pats);
+    if (limit > 0 && worst > limit) {
+        printf("work grows as n^%.1f, past the limit of n^%.1f\n", worst, limit);
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+#endif
+}
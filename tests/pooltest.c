@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../regexer.h"
+#include "../backend/prog/prog.h"
+#include "../backend/pool/pool.h"
+
+#define STRING_COUNT 20000
+
+static const char* patterns[] = {
+    "abc", "a(b|c)*x", "x[^a]*x", "(ab)+c", "[ax]+b?c", "b*", "(a|ab)(c|bcd)x",
+};
+
+static const char alphabet[] = "abcdx";
+
+#define PATTERN_COUNT ((int)(sizeof(patterns) / sizeof(patterns[0])))
+
+/* a task that marks each item it is given and spends longer on some */
+static void
+pool_mark(void* ctx, size_t lo, size_t hi)
+{
+    volatile unsigned spin = 0;
+    int* seen = (int*)ctx;
+
+    for (size_t i = lo; i < hi; ++i) {
+        seen[i]++;
+        for (unsigned k = 0; k < (i < STRING_COUNT / 8 ? 20000u : 10u); ++k)
+            spin += k;
+    }
+}
+
+/**
+ * @brief Check that every item is handed out once, however many threads
+ * and whatever the batch size, when the work is lopsided enough to make
+ * the workers steal.
+ * 
+ * @return Number of disagreements found.
+ */
+int pool_check_items(void)
+{
+    int bad = 0;
+    int* seen = (int*)malloc(STRING_COUNT * sizeof(int));
+    re_pool_task task = { .run = pool_mark };
+    size_t grains[] = { 1, 7, 64, STRING_COUNT * 2 };
+
+    task.arg = seen;
+    for (int t = 1; t <= 12; t += 3) {
+        for (int g = 0; g < 4; ++g) {
+            memset(seen, 0, STRING_COUNT * sizeof(int));
+            re_pool_run(&task, STRING_COUNT, grains[g], t);
+            for (int i = 0; i < STRING_COUNT; ++i) {
+                if (seen[i] != 1) {
+                    printf("%d threads, grain %zu: item %d handed out %d times\n", t, grains[g], i, seen[i]);
+                    bad++;
+                    break;
+                }
+            }
+        }
+    }
+
+    free(seen);
+    return bad;
+}
+
+int main(void)
+{
+    int bad = 0;
+    char** strs = (char**)malloc(STRING_COUNT * sizeof(char*));
+    bool* want = (bool*)malloc(STRING_COUNT * sizeof(bool));
+    bool* got = (bool*)malloc(STRING_COUNT * sizeof(bool));
+
+    srand(40);
+    for (int i = 0; i < STRING_COUNT; ++i) {
+        int len = rand() % 12;
+        strs[i] = (char*)malloc(len + 1);
+        for (int k = 0; k < len; ++k)
+            strs[i][k] = alphabet[rand() % 5];
+        strs[i][len] = '\0';
+    }
+
+    for (int p = 0; p < PATTERN_COUNT; ++p) {
+        re_prog* prog = re_prog_compile(re_read((char*)patterns[p]));
+
+        for (int i = 0; i < STRING_COUNT; ++i)
+            want[i] = re_prog_run(prog, strs[i]);
+
+        for (int t = 1; t <= 8; ++t) {
+            memset(got, 0, STRING_COUNT * sizeof(bool));
+            re_pool_match(prog, (const char**)strs, STRING_COUNT, t, got);
+            for (int i = 0; i < STRING_COUNT; ++i) {
+                if (got[i] != want[i]) {
+                    printf("/%s/ on \"%s\", %d threads: want %s, got %s\n", patterns[p], strs[i], t,
+                        want[i] ? "true" : "false", got[i] ? "true" : "false");
+                    bad++;
+                    break;
+                }
+            }
+        }
+
+        re_prog_free(prog);
+    }
+
+    bad += pool_check_items();
+
+    for (int i = 0; i < STRING_COUNT; ++i)
+        free(strs[i]);
+    free(strs);
+    free(want);
+    free(got);
+
+    printf("%d pattern%s matched on the pool, %d mismatch%s\n",
+        PATTERN_COUNT, PATTERN_COUNT == 1 ? "" : "s", bad, bad == 1 ? "" : "es");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "../regexer.h"
+#include "../backend/prog/prog.h"
+
+/* smallest pattern timed; each after is twice the one before */
+#define SCALE_FIRST (1 << 18)
+
+/* letters in every word, enough for distinct words past 100 MB */
+#define SCALE_WORD_LEN 6
+
+/* time or arena a pattern may take per megabyte beyond that of a small one */
+#define SCALE_GROWTH 3.0
+
+/* runs too quick to time well are not compared */
+#define SCALE_MIN_SECS 0.05
+
+/**
+ * Shapes of huge pattern, each stressing a different part of the front
+ * end: long chains of literal alternatives, which become tries; chains of
+ * alternatives that cannot; long plain sequences; many small groups; and
+ * multibyte chars and classes among plain ones.
+ */
+enum { SCALE_WORDS, SCALE_ALTS, SCALE_SEQUENCE, SCALE_GROUPS, SCALE_UTF8, SCALE_SHAPES };
+
+static const char* shapes[SCALE_SHAPES] = { "words", "alts", "sequence", "groups", "utf8" };
+
+static double
+scale_now(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* n written as a lowercase word; all are one length, so none is a prefix of another */
+static int
+scale_word(char* out, size_t n)
+{
+    for (int i = 0; i < SCALE_WORD_LEN; ++i, n /= 26)
+        out[i] = 'a' + n % 26;
+    return SCALE_WORD_LEN;
+}
+
+/**
+ * @brief Write a pattern of one shape, close to len bytes long.
+ *
+ * @param shape Which shape.
+ * @param len Length wanted.
+ * @return The pattern, to be freed.
+ */
+static char*
+scale_pattern(int shape, size_t len)
+{
+    char* pat = (char*)malloc(len + 64);
+    size_t at = 0;
+
+    for (size_t n = 0; at < len; ++n)
+    {
+        switch (shape)
+        {
+            case SCALE_WORDS:
+                if (n) pat[at++] = '|';
+                at += scale_word(pat + at, n);
+                break;
+
+            case SCALE_ALTS:
+                if (n) pat[at++] = '|';
+                at += scale_word(pat + at, n);
+                memcpy(pat + at, "[0-9]+x?", 8);
+                at += 8;
+                break;
+
+            case SCALE_SEQUENCE:
+                memcpy(pat + at, "ab[cd]e?f*", 10);
+                at += 10;
+                break;
+
+            case SCALE_GROUPS:
+                memcpy(pat + at, "(ab|c)*d(e|f+)?", 15);
+                at += 15;
+                break;
+
+            case SCALE_UTF8:
+                /* éa[α-ωx]ü? */
+                memcpy(pat + at, "\xc3\xa9" "a[\xce\xb1-\xcf\x89x]\xc3\xbc?", 14);
+                at += 14;
+                break;
+        }
+    }
+    pat[at] = '\0';
+    return pat;
+}
+
+/* bytes the arena holds, used or not */
+static size_t
+scale_arena(void)
+{
+    size_t bytes = 0;
+
+    for (m_arena_block* b = re_arena.head; b; b = b->next)
+        bytes += b->capacity;
+    return bytes;
+}
+
+static long
+scale_peak(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/**
+ * @brief Compile a pattern of one shape at doubling sizes, timing the
+ * front end, the generated C and the program, and check the time and
+ * arena per megabyte stay level.
+ *
+ * @param shape Which shape.
+ * @param max Largest pattern, in bytes.
+ * @param code Where generated code goes.
+ * @return Whether the time or arena grew faster than the pattern.
+ */
+static bool
+scale_shape(int shape, size_t max, m_buffer* code)
+{
+    double base = 0.0;
+    double abase = 0.0;
+    bool slow = false;
+
+    for (size_t len = SCALE_FIRST; len <= max; len *= 2)
+    {
+        char* pat = scale_pattern(shape, len);
+        double mb = strlen(pat) / 1e6;
+        double t0, t1, t2, t3, per, aper;
+        bool grew;
+        size_t arena;
+        re_exp* re;
+        re_prog* prog;
+
+        t0 = scale_now();
+        re = re_read(pat);
+        t1 = scale_now();
+        code->length = 0;
+        re_conv(re, code, 0);
+        t2 = scale_now();
+        prog = re_prog_compile(re);
+        t3 = scale_now();
+
+        arena = scale_arena();
+        per   = (t3 - t0) / mb;
+        aper  = arena / 1e6 / mb;
+        if (base == 0.0 && t3 - t0 >= SCALE_MIN_SECS)
+            base = per;
+        if (abase == 0.0)
+            abase = aper;
+
+        grew = (base > 0.0 && per > base * SCALE_GROWTH) || aper > abase * SCALE_GROWTH;
+        printf("%-9s %8.2f %8.3f %8.3f %8.1f %8.3f %8.3f %10.1f %10.1f%s\n", shapes[shape], mb,
+            t1 - t0, t2 - t1, code->length / 1e6, t3 - t2, per, aper, scale_peak() / 1e3,
+            grew ? "  superlinear" : "");
+        slow |= grew;
+
+        if (prog)
+            re_prog_free(prog);
+        m_arena_reset(&re_arena);
+        free(pat);
+    }
+    return slow;
+}
+
+int main(int argc, char** argv)
+{
+    size_t max = 4;
+    int slow = 0;
+    m_buffer code = m_buffer_init();
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "-m") && i + 1 < argc)
+            max = strtoul(argv[++i], NULL, 10);
+        else {
+            fprintf(stderr, "usage: %s [-m megabytes]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    re_arena = m_arena_init();
+    printf("%-9s %8s %8s %8s %8s %8s %8s %10s %10s\n", "shape", "MB", "read s", "conv s", "code MB", "prog s", "s/MB", "arena/MB", "peak MB");
+    for (int s = 0; s < SCALE_SHAPES; ++s)
+        slow += scale_shape(s, max << 20, &code);
+
+    m_buffer_free(&code);
+    return slow ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "../regexer.h"
+#include "../backend/dfa/dfa.h"
+#include "../backend/search/search.h"
+
+#define MAX_INPUT 7
+
+static const char* patterns[] = {
+    "abcd|bc", "ab|bcde", "a.*b", "[0-9]+ms", "foo", "(ab)+c", "x*", "a?b?c",
+    "(a|b)*abb", "ba+", "(ab|a)(bc|c)", "c(a|b)*c", "GET|POST|PUT",
+};
+
+static const char alphabet[] = "abcx";
+
+#define PATTERN_COUNT ((int)(sizeof(patterns) / sizeof(patterns[0])))
+
+/**
+ * @brief Whether a whole span is in the language, by the anchored automaton.
+ * 
+ * @param dfa Automaton from re_dfa_build.
+ * @param text Text holding the span.
+ * @param s Start of the span.
+ * @param e End of the span.
+ * @return Whether the automaton accepts right at e.
+ */
+bool search_whole(re_dfa* dfa, const char* text, int s, int e)
+{
+    int state = dfa->start;
+
+    for (int i = s; i < e && state != 0; ++i)
+        state = dfa->trans[state * dfa->nclasses + dfa->classes[(unsigned char)text[i]]];
+    return dfa->accepts[state + 1] > dfa->accepts[state];
+}
+
+/**
+ * @brief Check every text over the alphabet up to a length, comparing the
+ * searcher with the leftmost longest span found by trying them all.
+ * 
+ * @param pat Pattern text.
+ * @param sr Searcher for the pattern.
+ * @param dfa Anchored automaton for the same pattern.
+ * @param buf Text being built.
+ * @param len Length of buf so far.
+ * @return Number of disagreements found.
+ */
+int search_check(const char* pat, re_search* sr, re_dfa* dfa, char* buf, int len)
+{
+    int bad = 0, ws = -1, we = -1;
+    size_t gs = 0, ge = 0;
+    bool got;
+
+    buf[len] = '\0';
+    for (int s = 0; s <= len && ws < 0; ++s)
+        for (int e = len; e >= s && ws < 0; --e)
+            if (search_whole(dfa, buf, s, e))
+                ws = s, we = e;
+
+    got = re_search_find(sr, buf, len, &gs, &ge);
+    if (got != (ws >= 0) || (got && ((int)gs != ws || (int)ge != we))) {
+        printf("/%s/ on \"%s\": want [%d, %d), got %s[%zu, %zu)\n", pat, buf, ws, we, got ? "" : "none ", gs, ge);
+        bad++;
+    }
+
+    if (len < MAX_INPUT) {
+        for (int i = 0; alphabet[i]; ++i) {
+            buf[len] = alphabet[i];
+            bad += search_check(pat, sr, dfa, buf, len + 1);
+        }
+    }
+
+    return bad;
+}
+
+int main(void)
+{
+    int bad = 0;
+    char buf[MAX_INPUT + 1];
+
+    for (int i = 0; i < PATTERN_COUNT; ++i) {
+        re_exp* re     = re_read((char*)patterns[i]);
+        re_search* sr  = re_search_build(re, 0);
+        re_dfa* dfa    = re_dfa_build(&re, 1, 0);
+
+        bad += search_check(patterns[i], sr, dfa, buf, 0);
+
+        re_dfa_free(dfa);
+        re_search_free(sr);
+    }
+
+    printf("%d pattern%s searched, %d mismatch%s\n",
+        PATTERN_COUNT, PATTERN_COUNT == 1 ? "" : "s", bad, bad == 1 ? "" : "es");
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "../regexer.h"
+#include "../backend/prog/prog.h"
+#include "../backend/vm/vm.h"
+#include "../backend/jit/jit.h"
+#include "../backend/pool/pool.h"
+
+/* from the batch output of suites.mf, built with RE_NO_MAIN */
+typedef struct
+re_matcher
+{
+    const char* name;
+    const char* regex;
+    bool (*match)(char*);
+}
+re_matcher;
+
+re_matcher* re_find(const char* name);
+
+/**
+ * @brief A single testcase: a string and whether the pattern of its suite
+ * should match it.
+ * 
+ */
+typedef struct
+m_testcase {
+    const char* suite;
+    const char* str;
+    bool exp;
+} m_testcase;
+
+/**
+ * @brief A suite's pattern, compiled for every backend.
+ * 
+ */
+typedef struct
+m_testsuite {
+    re_matcher* conv;
+    re_prog* prog;
+    re_vm* vm;
+    re_jit* jit;
+} m_testsuite;
+
+enum { TEST_CONV, TEST_PROG, TEST_VM, TEST_JIT, TEST_BACKENDS };
+
+static const char* backends[TEST_BACKENDS] = { "re_conv", "interpreter", "vm", "jit" };
+
+static const m_testcase cases[] = {
+    // Testing a single atom
+    { "atom", "A", true },
+    { "atom", "B", false },
+    { "atom", "a", false },
+    { "atom", "AB", true },
+    { "atom", "AAA", true },
+    { "atom", "BA", false },
+
+    // Testing two characters
+    { "twatom", "b", false },
+    { "twatom", "e", false },
+    { "twatom", "be", true },
+    { "twatom", "bee", true },
+    { "twatom", "babe", false },
+    { "twatom", "best", true },
+
+    // Testing seven characters
+    { "seven", "seven", true },
+    { "seven", "seventy", true },
+    { "seven", "sev", false },
+    { "seven", "four score and seven years ago", false },
+    { "seven", "seven sons of sceva", true },
+
+    // Testing simple kleene-star
+    { "klsimp", "", true },
+    { "klsimp", "a", true },
+    { "klsimp", "aaaa", true },
+    { "klsimp", "random", true },
+    { "klsimp", "coyote", true },
+
+    // Testing kleene start with prefix
+    { "klwpref", "a", true },
+    { "klwpref", "add", true },
+    { "klwpref", "bark", false },
+    { "klwpref", "abababa", true },
+    { "klwpref", "baba", false },
+    { "klwpref", "academic", true },
+
+    // Testing kleene star with suffix
+    { "klwsuf", "a", true },
+    { "klwsuf", "b", false },
+    { "klwsuf", "ba", false },
+    { "klwsuf", "baa", true },
+    { "klwsuf", "add", true },
+    { "klwsuf", "baaa", true },
+    { "klwsuf", "baaaa", true },
+    { "klwsuf", "baaaakery", true },
+    { "klwsuf", "academic", true },
+
+    // Testing kleene star with prefix and suffix
+    { "klwprsuf", "9", false },
+    { "klwprsuf", "1", false },
+    { "klwprsuf", "91", false },
+    { "klwprsuf", "94", true },
+    { "klwprsuf", "914", true },
+    { "klwprsuf", "9124", false },
+    { "klwprsuf", "91411", true },
+    { "klwprsuf", "911111114ab", true },
+
+    // Testing simple repetition
+    { "rpsimp", "", false },
+    { "rpsimp", "b", false },
+    { "rpsimp", "c", true },
+    { "rpsimp", "catholic", true },
+    { "rpsimp", "ccc", true },
+
+    // Testing repetition with prefix
+    { "rpwpref", "b", false },
+    { "rpwpref", "a", false },
+    { "rpwpref", "ba", true },
+    { "rpwpref", "baa", true },
+    { "rpwpref", "baathwater", true },
+
+    // Testing repetition with suffix
+    { "rpwsuf", "a", false },
+    { "rpwsuf", "b", false },
+    { "rpwsuf", "ba", true },
+    { "rpwsuf", "bbq meetup", false },
+    { "rpwsuf", "bbbbbakar", true },
+    { "rpwsuf", "qardzhabba", false },
+
+    // Testing repetition with prefix and suffix
+    { "rpwprsuf", "b", false },
+    { "rpwprsuf", "bi", false },
+    { "rpwprsuf", "i", false },
+    { "rpwprsuf", "ig", false },
+    { "rpwprsuf", "iiiiig", false },
+    { "rpwprsuf", "bg", false },
+    { "rpwprsuf", "big", true },
+    { "rpwprsuf", "bigger people", true },
+    { "rpwprsuf", "biiiiig", true },
+    { "rpwprsuf", "biiIiig", false },
+    { "rpwprsuf", "biig natiion", true },
+
+    // Testing simple alternates
+    { "altsimp", "a", true },
+    { "altsimp", "e", true },
+    { "altsimp", "k", false },
+    { "altsimp", "ae", true },
+    { "altsimp", "addition", true },
+    { "altsimp", "evil people", true },
+
+    // Testing multiple alternates
+    { "altmult", "a", true },
+    { "altmult", "e", true },
+    { "altmult", "i", true },
+    { "altmult", "o", true },
+    { "altmult", "u", true },
+    { "altmult", "eager", true },
+    { "altmult", "best", false },
+    { "altmult", "hate", false },
+    { "altmult", "aeiou", true },
+
+    // Testing alternates with prefix
+    { "altwpref", "b", false },
+    { "altwpref", "y", false },
+    { "altwpref", "e", false },
+    { "altwpref", "by", true },
+    { "altwpref", "be", true },
+    { "altwpref", "bk", false },
+    { "altwpref", "k", false },
+    { "altwpref", "bey", true },
+    { "altwpref", "bye\\-bye, dear friend\\.", true },
+
+    // Testing alternates with suffix
+    { "altwprsuf", "l", false },
+    { "altwprsuf", "b", false },
+    { "altwprsuf", "ba", false },
+    { "altwprsuf", "la", false },
+    { "altwprsuf", "bad", true },
+    { "altwprsuf", "lad", true },
+    { "altwprsuf", "blad", false },
+    { "altwprsuf", "bad things that lad did", true },
+    { "altwprsuf", "lads doing bad things", true },
+
+    // C's binary number implementation
+    { "binimpl", "0", false },
+    { "binimpl", "b", false },
+    { "binimpl", "0B", false },
+    { "binimpl", "0b0", true },
+    { "binimpl", "0B001", true },
+    { "binimpl", "0b2", false },
+    { "binimpl", "0B0101", true },
+    { "binimpl", "0B111", true },
+
+    // A common string implementation
+    { "strimpl", "\\\"", false },
+    { "strimpl", "string", false },
+    { "strimpl", "\"\"", true },
+    { "strimpl", "\"string\"", true },
+    { "strimpl", "\"\\t\"", true },
+    { "strimpl", "\"\\k\"", false },
+    { "strimpl", "\"boast\"", true },
+    { "strimpl", "\"string\"", true },
+    { "strimpl", "\"\\\"\\\"", false },
+
+    // C's hexadecimal number implementation
+    { "heximpl", "0", false },
+    { "heximpl", "x", false },
+    { "heximpl", "0x", false },
+    { "heximpl", "0x0", true },
+    { "heximpl", "0XA", true },
+    { "heximpl", "0xFg", true },
+    { "heximpl", "0XACC", true },
+    { "heximpl", "0X100", true },
+
+    // UTF-8 classes, written in octal: [α-ω]+x and [^é]
+    { "utf8impl", "\316\261\316\262x", true },
+    { "utf8impl", "\317\211x", true },
+    { "utf8impl", "ax", false },
+    { "utf8impl", "x", false },
+    { "utf8impl", "\316x", false },
+    { "utf8neg", "\303\251", false },
+    { "utf8neg", "e", true },
+    { "utf8neg", "\303\274", true },
+    { "utf8neg", "", false },
+};
+
+#define CASE_COUNT ((int)(sizeof(cases) / sizeof(cases[0])))
+
+typedef struct
+m_testrun {
+    m_testsuite** suites;
+    bool (*got)[TEST_BACKENDS];
+} m_testrun;
+
+/**
+ * @brief Run a batch of cases through every backend.
+ * 
+ * @param ctx The m_testrun being filled in.
+ * @param lo First case of the batch.
+ * @param hi One past the last case.
+ */
+void m_testrun_batch(void* ctx, size_t lo, size_t hi)
+{
+    m_testrun* run = (m_testrun*)ctx;
+
+    for (size_t i = lo; i < hi; ++i) {
+        m_testsuite* s = run->suites[i];
+        char* str = (char*)cases[i].str;
+
+        if (s == NULL)
+            continue;
+        run->got[i][TEST_CONV] = s->conv->match(str);
+        run->got[i][TEST_PROG] = re_prog_run(s->prog, str);
+        run->got[i][TEST_VM]   = re_vm_run(s->vm, str);
+        run->got[i][TEST_JIT]  = re_jit_match(s->jit, str);
+    }
+}
+
+/**
+ * @brief Compile the pattern of every suite once, for every case in it.
+ * 
+ * @param suites Where each case's suite goes, NULL when it has no matcher.
+ * @return Number of cases whose suite has no matcher.
+ */
+int m_testsuites_build(m_testsuite** suites)
+{
+    int missing = 0;
+
+    for (int i = 0; i < CASE_COUNT; ++i)
+    {
+        re_matcher* m;
+
+        /* cases of a suite are kept together */
+        if (i > 0 && !strcmp(cases[i].suite, cases[i-1].suite)) {
+            suites[i] = suites[i-1];
+            continue;
+        }
+
+        if ((m = re_find(cases[i].suite)) == NULL) {
+            printf("%s: no such suite in suites.mf\n", cases[i].suite);
+            suites[i] = NULL;
+            missing++;
+            continue;
+        }
+
+        suites[i] = (m_testsuite*)malloc(sizeof(m_testsuite));
+        suites[i]->conv = m;
+        suites[i]->prog = re_prog_compile(re_read((char*)m->regex));
+        suites[i]->vm   = re_vm_compile(suites[i]->prog);
+        suites[i]->jit  = re_jit_compile(suites[i]->prog);
+    }
+
+    return missing;
+}
+
+int main(void)
+{
+    int missing, bad, failed[TEST_BACKENDS] = { 0 };
+    struct timespec t0, t1;
+    m_testsuite* suites[CASE_COUNT];
+    bool got[CASE_COUNT][TEST_BACKENDS];
+    m_testrun run = { .suites = suites, .got = got };
+    re_pool_task task = { .run = m_testrun_batch, .arg = &run };
+
+    timespec_get(&t0, TIME_UTC);
+    missing = m_testsuites_build(suites);
+    re_pool_run(&task, CASE_COUNT, 8, 0);
+    timespec_get(&t1, TIME_UTC);
+
+    for (int b = 0; b < TEST_BACKENDS; ++b) {
+        for (int i = 0; i < CASE_COUNT; ++i) {
+            if (suites[i] && got[i][b] != cases[i].exp) {
+                printf("%s: %s: /%s/ on \"%s\" unexpectedly %s\n", backends[b], cases[i].suite,
+                    suites[i]->conv->regex, cases[i].str, cases[i].exp ? "failed" : "passed");
+                failed[b]++;
+            }
+        }
+    }
+
+    bad = missing;
+    for (int b = 0; b < TEST_BACKENDS; ++b) {
+        printf("%-12s %d/%d passed\n", backends[b], CASE_COUNT - missing - failed[b], CASE_COUNT);
+        bad += failed[b];
+    }
+    printf("%d cases over %d backends (%s jit) in %.1f ms\n", CASE_COUNT, TEST_BACKENDS,
+        RE_JIT_NATIVE ? "native" : "interpreted", (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+
+    for (int i = 0; i < CASE_COUNT; ++i) {
+        if (suites[i] && (i == CASE_COUNT - 1 || suites[i] != suites[i+1])) {
+            re_jit_free(suites[i]->jit);
+            re_vm_free(suites[i]->vm);
+            re_prog_free(suites[i]->prog);
+            free(suites[i]);
+        }
+    }
+
+    return bad ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include "arena.h"
+
+#define M_ARENA_ALIGN (sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double))
+#define M_ARENA_ROUND(n) (((n) + M_ARENA_ALIGN - 1) & ~(M_ARENA_ALIGN - 1))
+#define M_ARENA_DATA(b) ((char*)(b) + M_ARENA_ROUND(sizeof(m_arena_block)))
+
+/**
+ * @brief Initialize an arena.
+ * 
+ * @param block_size Size of each block the arena carves allocations from.
+ * @return An empty arena; no memory is reserved until the first allocation.
+ */
+m_arena _m_arena_init(size_t block_size)
+{
+    m_arena a;
+
+    a.block_size = block_size;
+    a.head       = NULL;
+    a.spare      = NULL;
+
+    return a;
+}
+
+static m_arena_block*
+m_arena_block_get(m_arena* a, size_t size)
+{
+    m_arena_block* b;
+    size_t cap = size > a->block_size ? size : a->block_size;
+
+    /* reuse a block left over from a reset if it is big enough */
+    if (a->spare != NULL && a->spare->capacity >= cap) {
+        b        = a->spare;
+        a->spare = b->next;
+    } else {
+        b = (m_arena_block*)malloc(M_ARENA_ROUND(sizeof(m_arena_block)) + cap);
+        if (b == NULL) return NULL;
+        b->capacity = cap;
+    }
+
+    b->used = 0;
+    b->next = a->head;
+    a->head = b;
+
+    return b;
+}
+
+/**
+ * @brief Allocate memory from an arena.
+ * 
+ * @param a Arena to allocate from.
+ * @param size Number of bytes needed.
+ * @return Pointer to suitably aligned memory, or NULL if out of memory.
+ */
+void* m_arena_alloc(m_arena* a, size_t size)
+{
+    void* ptr;
+    m_arena_block* b = a->head;
+
+    size = M_ARENA_ROUND(size);
+    if (b == NULL || b->capacity - b->used < size) {
+        b = m_arena_block_get(a, size);
+        if (b == NULL) return NULL;
+    }
+
+    ptr      = M_ARENA_DATA(b) + b->used;
+    b->used += size;
+
+    return ptr;
+}
+
+/**
+ * @brief Release every allocation at once, keeping the blocks for reuse.
+ * 
+ * @param a Arena to reset.
+ */
+void m_arena_reset(m_arena* a)
+{
+    m_arena_block* b = a->head;
+
+    while (b != NULL) {
+        m_arena_block* next = b->next;
+        b->next  = a->spare;
+        a->spare = b;
+        b        = next;
+    }
+
+    a->head = NULL;
+}
+
+/**
+ * @brief Free all memory held by an arena.
+ * 
+ * @param a Arena to destroy.
+ */
+void m_arena_destroy(m_arena* a)
+{
+    m_arena_reset(a);
+    while (a->spare != NULL) {
+        m_arena_block* next = a->spare->next;
+        free(a->spare);
+        a->spare = next;
+    }
+}
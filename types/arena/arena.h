@@ -0,0 +1,34 @@
+#ifndef ARENA_H
+#define ARENA_H
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct
+m_arena_block
+{
+    size_t used;                                // Bytes handed out from this block
+    size_t capacity;                            // Usable bytes in this block
+    struct m_arena_block* next;                 // Next (older) block in the chain
+}
+m_arena_block;
+
+typedef struct
+m_arena
+{
+    size_t block_size;                          // Default size of a new block
+    m_arena_block* head;                        // Block currently being carved up
+    m_arena_block* spare;                       // Blocks kept around after a reset
+}
+m_arena;
+
+m_arena _m_arena_init(size_t block_size);
+void* m_arena_alloc(m_arena* a, size_t size);
+void m_arena_reset(m_arena* a);
+void m_arena_destroy(m_arena* a);
+#define m_arena_init() (_m_arena_init(64 * 1024))
+#define m_arena_new(a, t) ((t*)m_arena_alloc((a), sizeof(t)))
+
+#endif
@@ -1,267 +1,424 @@
 #include "bstree.h"
 
-static inline int
-m_bstree_entry_size(m_bstree_entry* t)
+/* nodes a new pool has room for, the null node among them */
+#define M_BSTREE_POOL_MIN 16
+
+/* deepest an AVL tree of INT_MAX nodes can be */
+#define M_BSTREE_MAX_DEPTH 48
+
+#define NODE(t, i) ((t)->pool->nodes[(i)])
+#define ITEM(t, i) ((t)->pool->items + (size_t)(i) * (t)->size)
+#define HEIGHT(t, i) (NODE(t, i).height)
+
+static m_bstree_pool*
+m_bstree_pool_init(size_t size, int capacity)
 {
-    if (t != NULL) {
-        int s = 1;
-        if (t->left != NULL)
-            s += m_bstree_entry_size(t->left);
-        if (t->right != NULL)
-            s += m_bstree_entry_size(t->right);
-        return s;
-    } else return 0;
+    m_bstree_pool* p = (m_bstree_pool*)malloc(sizeof(m_bstree_pool));
+
+    capacity    = MAX(capacity, M_BSTREE_POOL_MIN);
+    p->size     = size;
+    p->count    = 1;
+    p->capacity = capacity;
+    p->free     = M_BSTREE_NIL;
+    p->refs     = 1;
+    p->nodes    = (m_bstree_node*)malloc(capacity * sizeof(m_bstree_node));
+    p->items    = (char*)malloc(capacity * size);
+
+    /* the null node: no children, no height, never freed */
+    memset(&p->nodes[M_BSTREE_NIL], 0, sizeof(m_bstree_node));
+    return p;
 }
 
-static inline m_bstree_entry* 
-m_bstree_get_max(m_bstree_entry* t)
+/**
+ * @brief Hands out a node holding a copy of m, or nothing yet if m is
+ * NULL, with no children. May move the pool's arrays, so nothing taken
+ * from them before is valid after, m included.
+ */
+static int
+m_bstree_node_new(m_bstree* t, const void* m)
 {
-    if (t != NULL) {
-        m_bstree_entry* old = t;
-        m_bstree_entry* max = t;
-        while (max->right != NULL) {
-            old = max;
-            max = max->right;
+    m_bstree_pool* p = t->pool;
+    int i;
+
+    if (p->free != M_BSTREE_NIL) {
+        i       = p->free;
+        p->free = p->nodes[i].left;
+    } else {
+        if (p->count == p->capacity) {
+            p->capacity *= 2;
+            p->nodes = (m_bstree_node*)realloc(p->nodes, p->capacity * sizeof(m_bstree_node));
+            p->items = (char*)realloc(p->items, p->capacity * p->size);
         }
-        if (old != max)
-            old->right = NULL;
-        return max;
-    } return NULL;
+        i = p->count++;
+    }
+
+    p->nodes[i] = (m_bstree_node){ .left = M_BSTREE_NIL, .right = M_BSTREE_NIL, .height = 1, .refs = 1 };
+    if (m != NULL)
+        memcpy(ITEM(t, i), m, t->size);
+    return i;
 }
 
-static inline m_bstree_entry* 
-m_bstree_get_min(m_bstree_entry* t)
+/**
+ * @brief Drops one reference to node i, freeing it and whatever under it
+ * nothing else points at. Nodes waiting to be looked at are chained
+ * through their height, which no longer matters, so this takes no stack.
+ */
+static void
+m_bstree_node_release(m_bstree* t, int i)
 {
-    if (t != NULL) {
-        m_bstree_entry* old = t;
-        m_bstree_entry* min = t;
-        while (min->left != NULL) {
-            old = min;
-            min = min->left;
+    m_bstree_pool* p = t->pool;
+    int todo = M_BSTREE_NIL;
+
+    if (i == M_BSTREE_NIL || --p->nodes[i].refs > 0)
+        return;
+
+    p->nodes[i].height = M_BSTREE_NIL;
+    todo = i;
+    while (todo != M_BSTREE_NIL)
+    {
+        m_bstree_node* n = &p->nodes[todo];
+        int kids[2] = { n->left, n->right };
+
+        i       = todo;
+        todo    = n->height;
+        n->left = p->free;
+        p->free = i;
+
+        for (int k = 0; k < 2; ++k) {
+            if (kids[k] != M_BSTREE_NIL && --p->nodes[kids[k]].refs == 0) {
+                p->nodes[kids[k]].height = todo;
+                todo = kids[k];
+            }
         }
-        if (old != min)
-            old->right = NULL;
-        return min;
-    } return NULL;
+    }
+}
+
+/**
+ * @brief Makes node i safe to change for the link that points at it,
+ * copying it if anything else points at it too. The link must be set
+ * to what this returns.
+ */
+static int
+m_bstree_node_own(m_bstree* t, int i)
+{
+    int j;
+
+    if (i == M_BSTREE_NIL || NODE(t, i).refs == 1)
+        return i;
+
+    j = m_bstree_node_new(t, NULL);
+    memcpy(ITEM(t, j), ITEM(t, i), t->size);
+    NODE(t, j).left   = NODE(t, i).left;
+    NODE(t, j).right  = NODE(t, i).right;
+    NODE(t, j).height = NODE(t, i).height;
+    NODE(t, NODE(t, j).left).refs++;
+    NODE(t, NODE(t, j).right).refs++;
+    NODE(t, i).refs--;
+    return j;
 }
 
-static inline m_bstree_entry*
-m_bstree_right_rotate(m_bstree_entry* y)
+static inline void
+m_bstree_node_height(m_bstree* t, int i)
 {
-    m_bstree_entry* x   = y->left;
-    m_bstree_entry* tmp = x->right;
+    NODE(t, i).height = 1 + MAX(HEIGHT(t, NODE(t, i).left), HEIGHT(t, NODE(t, i).right));
+}
 
-    x->right  = y;
-    y->left   = tmp;
-    x->height = TREEHEIGHT(x);
-    y->height = TREEHEIGHT(y);
+/* both rotations expect y (or x) to be owned already, and own the child they lift */
+static int
+m_bstree_right_rotate(m_bstree* t, int y)
+{
+    int x = m_bstree_node_own(t, NODE(t, y).left);
 
+    NODE(t, y).left  = NODE(t, x).right;
+    NODE(t, x).right = y;
+    m_bstree_node_height(t, y);
+    m_bstree_node_height(t, x);
     return x;
 }
 
-static inline m_bstree_entry*
-m_bstree_left_rotate(m_bstree_entry* x)
+static int
+m_bstree_left_rotate(m_bstree* t, int x)
 {
-    m_bstree_entry* y   = x->right;
-    m_bstree_entry* tmp = y->left;
-
-    y->left   = x;
-    x->right  = tmp;
-    x->height = TREEHEIGHT(x);
-    y->height = TREEHEIGHT(y);
+    int y = m_bstree_node_own(t, NODE(t, x).right);
 
+    NODE(t, x).right = NODE(t, y).left;
+    NODE(t, y).left  = x;
+    m_bstree_node_height(t, x);
+    m_bstree_node_height(t, y);
     return y;
 }
 
-int m_bstree_size(m_bstree* t)
+static int
+m_bstree_node_balance(m_bstree* t, int i)
+{
+    int bal;
+
+    m_bstree_node_height(t, i);
+    bal = HEIGHT(t, NODE(t, i).left) - HEIGHT(t, NODE(t, i).right);
+
+    if (bal > 1) {
+        int l = NODE(t, i).left;
+        if (HEIGHT(t, NODE(t, l).left) < HEIGHT(t, NODE(t, l).right)) {
+            l = m_bstree_node_own(t, l);
+            l = m_bstree_left_rotate(t, l);
+            NODE(t, i).left = l;
+        }
+        return m_bstree_right_rotate(t, i);
+    }
+    if (bal < -1) {
+        int r = NODE(t, i).right;
+        if (HEIGHT(t, NODE(t, r).right) < HEIGHT(t, NODE(t, r).left)) {
+            r = m_bstree_node_own(t, r);
+            r = m_bstree_right_rotate(t, r);
+            NODE(t, i).right = r;
+        }
+        return m_bstree_left_rotate(t, i);
+    }
+    return i;
+}
+
+static int
+m_bstree_node_add(m_bstree* t, int i, void* m, int* added)
 {
-    int s = 0;
-    m_bstree_entry *k = t->troot;
-    return m_bstree_entry_size(k);
+    int cmp, k;
+
+    if (i == M_BSTREE_NIL) {
+        *added = 1;
+        return m_bstree_node_new(t, m);
+    }
+
+    i   = m_bstree_node_own(t, i);
+    cmp = t->compare(m, ITEM(t, i));
+    if (cmp == 0)
+        return i;
+
+    if (cmp < 0) {
+        k = m_bstree_node_add(t, NODE(t, i).left, m, added);
+        NODE(t, i).left = k;
+    } else {
+        k = m_bstree_node_add(t, NODE(t, i).right, m, added);
+        NODE(t, i).right = k;
+    }
+
+    return *added ? m_bstree_node_balance(t, i) : i;
 }
 
-static inline m_bstree_entry*
-m_bstree_entry_init(m_bstree* t, void* m)
+/* takes the least node out of subtree i, leaving its item in dst */
+static int
+m_bstree_node_take_min(m_bstree* t, int i, int dst)
 {
-    m_bstree_entry* n = malloc(sizeof(m_bstree_entry));
-    n->data = malloc(t->size);
-    memcpy(n->data, m, t->size);
-    n->left = NULL;
-    n->right = NULL;
-    n->height = 1;
-    return n;
+    int k;
+
+    i = m_bstree_node_own(t, i);
+    if (NODE(t, i).left == M_BSTREE_NIL) {
+        k = NODE(t, i).right;
+        memcpy(ITEM(t, dst), ITEM(t, i), t->size);
+        NODE(t, i).right = M_BSTREE_NIL;
+        m_bstree_node_release(t, i);
+        return k;
+    }
+
+    k = m_bstree_node_take_min(t, NODE(t, i).left, dst);
+    NODE(t, i).left = k;
+    return m_bstree_node_balance(t, i);
 }
 
-static m_bstree_entry*
-m_bstree_entry_add(m_bstree* t, m_bstree_entry* k, void* m)
+static int
+m_bstree_node_remove(m_bstree* t, int i, void* m, int* removed)
 {
-    int cmp, bal;
+    int cmp, k;
 
-    if (k == NULL) return m_bstree_entry_init(t, m);
+    if (i == M_BSTREE_NIL)
+        return i;
+
+    i   = m_bstree_node_own(t, i);
+    cmp = t->compare(m, ITEM(t, i));
 
-    cmp = t->compare(m, k->data);
     if (cmp < 0) {
-        k->left = m_bstree_entry_add(t, k->left, m);
-        if (k->left == NULL) return NULL;
+        k = m_bstree_node_remove(t, NODE(t, i).left, m, removed);
+        NODE(t, i).left = k;
     }
     else if (cmp > 0) {
-        k->right = m_bstree_entry_add(t, k->right, m);
-        if (k->right == NULL) return NULL;
-    }
-    else return NULL;
-
-    bal       = TREEBALANCE(k);
-    k->height = TREEHEIGHT(k);
-
-    if (bal > 1 && t->compare(m, k->left->data) < 0)
-        return m_bstree_right_rotate(k);
-    if (bal < -1 && t->compare(m, k->right->data) > 0)
-        return m_bstree_left_rotate(k);
-    if (bal > 1 && t->compare(m, k->left->data) > 0) {
-        k->left = m_bstree_left_rotate(k->left);
-        return m_bstree_right_rotate(k);
+        k = m_bstree_node_remove(t, NODE(t, i).right, m, removed);
+        NODE(t, i).right = k;
     }
-    if (bal < -1 && t->compare(m, k->right->data) < 0) {
-        k->right = m_bstree_right_rotate(k->right);
-        return m_bstree_left_rotate(k);
+    else {
+        *removed = 1;
+        if (NODE(t, i).left == M_BSTREE_NIL || NODE(t, i).right == M_BSTREE_NIL) {
+            k = NODE(t, i).left != M_BSTREE_NIL ? NODE(t, i).left : NODE(t, i).right;
+            NODE(t, i).left  = M_BSTREE_NIL;
+            NODE(t, i).right = M_BSTREE_NIL;
+            m_bstree_node_release(t, i);
+            return k;
+        }
+        k = m_bstree_node_take_min(t, NODE(t, i).right, i);
+        NODE(t, i).right = k;
     }
 
-    return k;
+    return *removed ? m_bstree_node_balance(t, i) : i;
+}
+
+int m_bstree_size(m_bstree* t)
+{
+    return t->count;
 }
 
-int m_bstree_add(m_bstree* t, void* m) {
-    m_bstree_entry* k = m_bstree_entry_add(t, t->troot, m);
-    if (k != NULL) {
-        t->troot = k;
-        return 0;
-    } else return -1;
+/**
+ * @brief Adds a copy of m to the tree.
+ * @return 0 if it was added, -1 if an equal item was there already.
+ */
+int m_bstree_add(m_bstree* t, void* m)
+{
+    int added = 0;
+
+    /* with snapshots about, don't copy a path only to find m on it */
+    if (t->pool->refs > 1 && m_bstree_find(t, m) != NULL)
+        return -1;
+
+    t->root = m_bstree_node_add(t, t->root, m, &added);
+    t->count += added;
+    return added ? 0 : -1;
 }
 
+/**
+ * @brief Finds the item equal to m. What is returned lives in the pool,
+ * and holds until the tree is next changed; while there are snapshots
+ * it may be shared with them, and must not be written through.
+ */
 void* m_bstree_find(m_bstree* t, void* m)
 {
-    m_bstree_entry *k = t->troot;
-    while (k != NULL)
+    int i = t->root;
+
+    while (i != M_BSTREE_NIL)
     {
-        int cmp = t->compare(m, k->data);
-        if (cmp > 0) {
-            if (k->right == NULL)
-                return NULL;
-            else k = k->right;
-        }
-        else
-        if (cmp < 0) {
-            if (k->left == NULL)
-                return NULL;
-            else k = k->left;
-        }
-        else return k->data;
+        int cmp = t->compare(m, ITEM(t, i));
+        if (cmp == 0)
+            return ITEM(t, i);
+        i = cmp < 0 ? NODE(t, i).left : NODE(t, i).right;
     }
+    return NULL;
 }
 
-int m_bstree_remove(m_bstree* t, void *m)
+/**
+ * @brief Removes the item equal to m.
+ * @return 0 if it was removed, -1 if there was none.
+ */
+int m_bstree_remove(m_bstree* t, void* m)
 {
-    m_bstree_entry **k = &(t->troot);
-    while (k != NULL)
-    {
-        int cmp = t->compare((*k)->data, m);
-        if (cmp > 0) {
-            if ((*k)->right == NULL)
-                return -1;
-            else *k = (*k)->right;
-        }
-        else
-        if (cmp < 0) {
-            if ((*k)->left == NULL)
-                return -1;
-            else *k = (*k)->left;
-        }
-        else 
-        {
-            m_bstree_entry *left = (*k)->left;
-            m_bstree_entry *right = (*k)->right;
-
-            if (left == NULL) {
-                if (right == NULL) {
-                    free(*k);
-                    *k = NULL;
-                } else *k = right;
-                return 0;
-            }
+    int removed = 0;
 
-            if (right == NULL) {
-                *k = left;
-                return 0;
-            }
+    if (t->pool->refs > 1 && m_bstree_find(t, m) == NULL)
+        return -1;
+
+    t->root = m_bstree_node_remove(t, t->root, m, &removed);
+    t->count -= removed;
+    return removed ? 0 : -1;
+}
+
+/**
+ * @brief Calls visit on every item in order, stopping early if it returns
+ * nonzero.
+ * @return What visit last returned, or 0 for an empty tree.
+ */
+int m_bstree_walk(m_bstree* t, int (*visit)(void* item, void* arg), void* arg)
+{
+    int stack[M_BSTREE_MAX_DEPTH];
+    int depth = 0, i = t->root, stat = 0;
 
-            *k = left;
-            m_bstree_entry* kmax = m_bstree_get_max((*k)->right);
-            if (kmax != NULL) {
-                kmax->right = right;
-                kmax->left = (*k)->right;
-                (*k)->right = kmax;
-            } else (*k)->right = right;
-            return 0;
+    while (stat == 0 && (i != M_BSTREE_NIL || depth > 0))
+    {
+        if (i != M_BSTREE_NIL) {
+            stack[depth++] = i;
+            i = NODE(t, i).left;
+        } else {
+            i    = stack[--depth];
+            stat = visit(ITEM(t, i), arg);
+            i    = NODE(t, i).right;
         }
     }
-    return -1;
+    return stat;
 }
 
 m_bstree* m_bstree_init(size_t size, int (*cmp)(const void*, const void*)) {
     m_bstree* t = (m_bstree*)malloc(sizeof(m_bstree));
 
-    t->size          = size;
-    t->troot         = NULL;
-    t->table_height  = 0;
-    t->compare       = cmp;
+    t->size    = size;
+    t->root    = M_BSTREE_NIL;
+    t->count   = 0;
+    t->pool    = m_bstree_pool_init(size, M_BSTREE_POOL_MIN);
+    t->compare = cmp;
 
     return t;
 }
 
 static int
-m_bstree_entry_destroy(m_bstree* m, m_bstree_entry* k)
+m_bstree_node_build(m_bstree* t, char* items, int lo, int hi)
 {
-    if (k->left != NULL)
-        m_bstree_entry_destroy(m, k->left);
-    if (k->right != NULL)
-        m_bstree_entry_destroy(m, k->right);
-    free(k->data);
-    free(k);
+    int mid, i, k;
+
+    if (lo >= hi)
+        return M_BSTREE_NIL;
+
+    mid = lo + (hi - lo) / 2;
+    i   = m_bstree_node_new(t, items + (size_t)mid * t->size);
+    k   = m_bstree_node_build(t, items, lo, mid);
+    NODE(t, i).left = k;
+    k   = m_bstree_node_build(t, items, mid + 1, hi);
+    NODE(t, i).right = k;
+    m_bstree_node_height(t, i);
+    return i;
 }
 
-int m_bstree_destroy(m_bstree* t)
+/**
+ * @brief Makes a balanced tree of count items in one pass, without a
+ * single comparison past checking that they are strictly increasing.
+ * @return The tree, or NULL if the items are out of order or repeat.
+ */
+m_bstree* m_bstree_build(size_t size, int (*cmp)(const void*, const void*), void* items, int count)
 {
-    m_bstree_entry_destroy(t, t->troot);
-    free(t);
-    return 0;
+    char* it = (char*)items;
+    m_bstree* t;
+
+    for (int i = 1; i < count; ++i)
+        if (cmp(it + (size_t)(i - 1) * size, it + (size_t)i * size) >= 0)
+            return NULL;
+
+    t          = (m_bstree*)malloc(sizeof(m_bstree));
+    t->size    = size;
+    t->count   = count;
+    t->pool    = m_bstree_pool_init(size, count + 1);
+    t->compare = cmp;
+    t->root    = m_bstree_node_build(t, it, 0, count);
+
+    return t;
 }
 
-static m_bstree_entry*
-m_bstree_entry_copy(m_bstree_entry* src)
+int m_bstree_destroy(m_bstree* t)
 {
-    m_bstree_entry* dst = NULL;
-
-    if (src != NULL) {
-        dst         = (m_bstree_entry*)malloc(sizeof(m_bstree_entry));
-        dst->data   = src->data;
-        dst->height = src->height;
-        dst->left   = m_bstree_entry_copy(src->left);
-        dst->right  = m_bstree_entry_copy(src->right);
-    } 
-    
-    return dst;
+    m_bstree_node_release(t, t->root);
+    if (--t->pool->refs == 0) {
+        free(t->pool->nodes);
+        free(t->pool->items);
+        free(t->pool);
+    }
+    free(t);
+    return 0;
 }
 
+/**
+ * @brief Takes a snapshot of src. Both trees can be changed afterwards
+ * without the other seeing it; the nodes stay shared until then.
+ */
 m_bstree* m_bstree_copy(m_bstree* src)
 {
     m_bstree* t = NULL;
 
     if (src != NULL) {
-        t                = (m_bstree*)malloc(sizeof(m_bstree));
-        t->size          = src->size;
-        t->table_height  = src->table_height;
-        t->compare       = src->compare;
-        t->troot         = m_bstree_entry_copy(src->troot);
+        t  = (m_bstree*)malloc(sizeof(m_bstree));
+        *t = *src;
+        t->pool->refs++;
+        NODE(t, t->root).refs++;
     }
 
     return t;
-}
\ No newline at end of file
+}
@@ -7,28 +7,53 @@
 #include <string.h>
 
 #define MAX(X, Y) ((X) > (Y) ? (X) : (Y))
-#define MIN(X, Y) ((X) < (Y) ? (X) : (Y))
-#define TREEHEIGHT(X) (1 + ((X)->left == NULL ? ((X)->right == NULL ? 0 : (X)->right->height)\
-    : ((X)->right == NULL ? (X)->left->height\
-    : MAX((X)->left->height, (X)->right->height))))
-#define TREEBALANCE(T) ((T) == NULL ? 0 :\
-    ((T)->left == NULL ? ((T)->right == NULL ? 0 : -((T)->right->height)) \
-    : ((T)->right == NULL ? (T)->left->height : (T)->left->height - (T)->right->height)))
-
-typedef struct m_bstree_entry
+#define MIN(X, Y) ((X) > (Y) ? (Y) : (X))
+
+/* index standing for no node */
+#define M_BSTREE_NIL 0
+
+typedef struct m_bstree_node
+{
+    int left;                                   // Index of the left child, or M_BSTREE_NIL
+    int right;                                  // Index of the right child, or M_BSTREE_NIL
+    int height;                                 // Height of the subtree, 1 for a leaf
+    int refs;                                   // Roots and parents pointing here
+}
+m_bstree_node;
+
+/**
+ * Nodes of one or more trees, in two arrays that grow by doubling: the
+ * links, and the items, each in a slot of its own size. Nodes point at
+ * each other by index, so growing moves nothing that refers to them, and
+ * freed nodes are chained through left for reuse. Slot 0 is the null
+ * node.
+ */
+typedef struct m_bstree_pool
 {
-    void* data;
-    int height;
-    struct m_bstree_entry* left;
-    struct m_bstree_entry* right;
+    size_t size;                                // Size of an item
+    int count;                                  // Nodes handed out, with the null node
+    int capacity;                               // Nodes there is room for
+    int free;                                   // First freed node, or M_BSTREE_NIL
+    int refs;                                   // Trees sharing the pool
+    m_bstree_node* nodes;                       // Links of every node
+    char* items;                                // Item of every node
 }
-m_bstree_entry;
+m_bstree_pool;
 
-typedef struct m_bstree {
-    size_t size;                                // Size of a node
-    size_t table_height;                        // Height of the tree
-    m_bstree_entry *troot;                      // Root of the binary tree
-    int (*compare)(const void*, const void*);   // Function for comparing two nodes
+/**
+ * An AVL tree of fixed size items. Copies are snapshots: they share the
+ * pool and every node, and a node is only copied when a tree that shares
+ * it changes something beneath it, so a copy costs nothing and a change
+ * after one costs a path. Trees sharing a pool must be used from one
+ * thread at a time.
+ */
+typedef struct m_bstree
+{
+    size_t size;                                // Size of an item
+    int root;                                   // Index of the root, or M_BSTREE_NIL
+    int count;                                  // Items in the tree
+    m_bstree_pool* pool;                        // Where the nodes live
+    int (*compare)(const void*, const void*);   // Function for comparing two items
 }
 m_bstree;
 
@@ -37,10 +62,11 @@ int m_bstree_destroy(m_bstree* t);
 int m_bstree_add(m_bstree* t, void* m);
 void* m_bstree_find(m_bstree* t, void* m);
 int m_bstree_remove(m_bstree* t, void* m);
+int m_bstree_walk(m_bstree* t, int (*visit)(void* item, void* arg), void* arg);
 m_bstree* m_bstree_copy(m_bstree* src);
+m_bstree* m_bstree_build(size_t size, int (*cmp)(const void*, const void*), void* items, int count);
 m_bstree* m_bstree_init(size_t size, int (*cmp)(const void*, const void*));
 
-#define m_bstree_iter_create() ((m_bstree_iter){NULL, 0, 0, NULL})
 #define m_bstree_create(type, cmp) (m_bstree_init(sizeof(type), (cmp)))
 
-#endif
\ No newline at end of file
+#endif
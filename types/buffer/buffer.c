@@ -0,0 +1,159 @@
+#include "buffer.h"
+
+/**
+ * @brief Initialize a buffer.
+ * 
+ * @return An empty buffer; no memory is reserved until the first write.
+ */
+m_buffer m_buffer_init(void)
+{
+    m_buffer b;
+
+    b.content  = NULL;
+    b.length   = 0;
+    b.capacity = 0;
+
+    return b;
+}
+
+/**
+ * @brief Make room for more bytes, doubling the buffer so that a run of
+ * small writes costs amortized constant time each.
+ * 
+ * @param b Buffer to grow.
+ * @param more Bytes about to be written.
+ */
+void m_buffer_reserve(m_buffer* b, size_t more)
+{
+    size_t cap = b->capacity ? b->capacity : 256;
+
+    if (b->content != NULL && b->length + more <= b->capacity)
+        return;
+    while (cap < b->length + more)
+        cap *= 2;
+
+    b->content = (char*)realloc(b->content, cap + 1);
+    if (b->content == NULL) {
+        fputs("out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    b->capacity = cap;
+}
+
+/**
+ * @brief Append bytes to a buffer.
+ * 
+ * @param b Buffer to append to.
+ * @param str Bytes to append; they may hold NULs.
+ * @param len Number of bytes.
+ */
+void m_buffer_put(m_buffer* b, const char* str, size_t len)
+{
+    m_buffer_reserve(b, len);
+    memcpy(b->content + b->length, str, len);
+    b->length += len;
+    b->content[b->length] = '\0';
+}
+
+/**
+ * @brief Append spaces to a buffer.
+ * 
+ * @param b Buffer to append to.
+ * @param count Number of spaces.
+ */
+void m_buffer_pad(m_buffer* b, size_t count)
+{
+    m_buffer_reserve(b, count);
+    memset(b->content + b->length, ' ', count);
+    b->length += count;
+    b->content[b->length] = '\0';
+}
+
+/**
+ * @brief Append a number in decimal, without going through printf.
+ * 
+ * @param b Buffer to append to.
+ * @param n Number to append.
+ */
+void m_buffer_putu(m_buffer* b, unsigned long n)
+{
+    char digits[24];
+    int i = sizeof(digits);
+
+    do {
+        digits[--i] = '0' + n % 10;
+        n /= 10;
+    } while (n);
+    m_buffer_put(b, digits + i, sizeof(digits) - i);
+}
+
+/**
+ * @brief Append formatted text to a buffer.
+ * 
+ * @param b Buffer to append to.
+ * @param fmt Format, as for printf.
+ */
+void m_buffer_printf(m_buffer* b, const char* fmt, ...)
+{
+    int len;
+    va_list args;
+
+    /* most writes fit in what is left, so they are formatted in place */
+    m_buffer_reserve(b, 64);
+    va_start(args, fmt);
+    len = vsnprintf(b->content + b->length, b->capacity - b->length + 1, fmt, args);
+    va_end(args);
+    if (len < 0)
+        return;
+
+    if ((size_t)len > b->capacity - b->length) {
+        m_buffer_reserve(b, len);
+        va_start(args, fmt);
+        vsnprintf(b->content + b->length, len + 1, fmt, args);
+        va_end(args);
+    }
+    b->length += len;
+}
+
+/**
+ * @brief Write the whole buffer to a file in one call.
+ * 
+ * @param b Buffer to write.
+ * @param fptr File to write into.
+ * @return Number of bytes written.
+ */
+size_t m_buffer_write(m_buffer* b, FILE* fptr)
+{
+    return b->length ? fwrite(b->content, sizeof(char), b->length, fptr) : 0;
+}
+
+/**
+ * @brief Hand the bytes of a buffer over to the caller, leaving it empty.
+ * 
+ * @param b Buffer to empty.
+ * @param len Where the number of bytes goes, or NULL.
+ * @return The NUL terminated bytes, to be freed by the caller.
+ */
+char* m_buffer_take(m_buffer* b, size_t* len)
+{
+    char* content;
+
+    m_buffer_reserve(b, 0);
+    content = b->content;
+    if (len)
+        *len = b->length;
+    *b = m_buffer_init();
+
+    return content;
+}
+
+/**
+ * @brief Free all memory held by a buffer.
+ * 
+ * @param b Buffer to free.
+ */
+void m_buffer_free(m_buffer* b)
+{
+    free(b->content);
+    *b = m_buffer_init();
+}
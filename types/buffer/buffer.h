@@ -0,0 +1,35 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+typedef struct
+m_buffer
+{
+    char*  content;                             // Bytes written so far, NUL terminated
+    size_t length;                              // Number of bytes written
+    size_t capacity;                            // Bytes content can hold, less the NUL
+}
+m_buffer;
+
+m_buffer m_buffer_init(void);
+void m_buffer_reserve(m_buffer* b, size_t more);
+void m_buffer_put(m_buffer* b, const char* str, size_t len);
+void m_buffer_pad(m_buffer* b, size_t count);
+void m_buffer_putu(m_buffer* b, unsigned long n);
+void m_buffer_printf(m_buffer* b, const char* fmt, ...);
+size_t m_buffer_write(m_buffer* b, FILE* fptr);
+char* m_buffer_take(m_buffer* b, size_t* len);
+void m_buffer_free(m_buffer* b);
+#define m_buffer_puts(b, str) (m_buffer_put((b), (str), strlen(str)))
+#define m_buffer_putc(b, ch) do {\
+    m_buffer_reserve((b), 1);\
+    (b)->content[(b)->length++] = (ch);\
+    (b)->content[(b)->length]   = '\0';\
+} while (0)
+
+#endif
@@ -3,6 +3,31 @@
 #include <string.h>
 #include "maps.h"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define M_HASHMAP_EMPTY   0x80                  // Slot never used
+#define M_HASHMAP_DELETED 0xFE                  // Slot whose key was removed
+#define M_HASHMAP_ALIGN   (sizeof(void*) > sizeof(double) ? sizeof(void*) : sizeof(double))
+
+/* before a slot's value: the whole hash, so growing needs no rehashing, and the key */
+typedef struct m_hashslot
+{
+    uint64_t hash;
+    const char* key;
+    size_t len;
+}
+m_hashslot;
+
+#define M_HASHMAP_HEADER ((sizeof(m_hashslot) + M_HASHMAP_ALIGN - 1) & ~(M_HASHMAP_ALIGN - 1))
+#define M_HASHMAP_SLOT(m, i) ((m_hashslot*)((m)->slots + (i) * (m)->stride))
+#define M_HASHMAP_VALUE(m, i) ((void*)((m)->slots + (i) * (m)->stride + M_HASHMAP_HEADER))
+
+/* the low seven bits go in the control byte, the rest pick where probing starts */
+#define M_HASHMAP_H1(h) ((size_t)((h) >> 7))
+#define M_HASHMAP_H2(h) ((unsigned char)((h) & 0x7F))
+
 unsigned long
 m_hashmap_def_hashfunc(unsigned char *str)
 {
@@ -11,139 +36,344 @@ m_hashmap_def_hashfunc(unsigned char *str)
 
     while (c = *str++)
         hash = ((hash << 5) + hash) + c;
-    
+
     return hash;
 }
 
-static int m_hashentry_comp(const void* a, const void *b)
+static inline uint64_t
+m_hashmap_mix(uint64_t x)
 {
-    m_hashentry* am = (m_hashentry*)a;
-    m_hashentry* bm = (m_hashentry*)b;
-    if (am->key > bm->key) return 1;
-    if (am->key < bm->key) return -1;
-    return 0;
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
 }
 
-static int m_dump_comp(const void* a, const void* b)
+/**
+ * @brief Hash a string of bytes eight at a time.
+ *
+ * @param key Bytes to hash; they may hold NULs.
+ * @param len Number of bytes.
+ * @return A hash whose every bit depends on every byte.
+ */
+uint64_t m_hashmap_hash_bytes(const void* key, size_t len)
 {
-    m_dumpentry* ad = (m_dumpentry*)a;
-    m_dumpentry* bd = (m_dumpentry*)b;
-    return strcmp(ad->key, bd->key);
+    const unsigned char* p = (const unsigned char*)key;
+    uint64_t h = 0x9E3779B97F4A7C15ull ^ len;
+    uint64_t w;
+
+    for (; len >= 8; p += 8, len -= 8) {
+        memcpy(&w, p, 8);
+        h = (h ^ m_hashmap_mix(w)) * 0x9E3779B97F4A7C15ull;
+    }
+    if (len > 0) {
+        w = 0;
+        memcpy(&w, p, len);
+        h = (h ^ m_hashmap_mix(w)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    return m_hashmap_mix(h);
 }
 
-static char* m_dump_to_string(const void* a) {return (char*)a;}
+/* bit i set where control byte i of the group at ctrl equals c */
+static inline unsigned
+m_hashmap_group_match(const unsigned char* ctrl, unsigned char c)
+{
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)c)));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < M_HASHMAP_GROUP; ++i)
+        mask |= (unsigned)(ctrl[i] == c) << i;
+    return mask;
+#endif
+}
 
-static inline void 
-m_hashentry_print(m_bstree_entry* m, char* (*tostr)(const void*), int INDENT)
+/* bit i set where slot i of the group is free, empty or deleted */
+static inline unsigned
+m_hashmap_group_free(const unsigned char* ctrl)
 {
-    if (m != NULL) {
-        m_hashentry* h = (m_hashentry*)m->data;
-        if (h != NULL) {
-            for (int i = 0; i < INDENT; ++i) 
-                printf(" ");
-            printf("key: %i, value: %s\n", h->key, tostr(h->value));
-            m_hashentry_print(m->left, tostr, INDENT+1);
-            m_hashentry_print(m->right, tostr, INDENT+1);
-        }
-    }
+#ifdef __SSE2__
+    return (unsigned)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < M_HASHMAP_GROUP; ++i)
+        mask |= (unsigned)(ctrl[i] >> 7) << i;
+    return mask;
+#endif
 }
 
-static void*
-m_hashmap_def_item_copy(m_hashmap* m, void* src)
+static inline int
+m_hashmap_lowest(unsigned mask)
 {
-    void* dst = malloc(m->vsize);
-    memcpy(dst, src, m->vsize);
-    return dst;
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctz(mask);
+#else
+    int i = 0;
+    while (!(mask & 1u << i))
+        ++i;
+    return i;
+#endif
 }
 
-static int
-m_hashmap_def_item_destr(m_hashmap* m, void* src)
+static inline void
+m_hashmap_set_ctrl(m_hashmap* m, size_t i, unsigned char c)
 {
-    free(src);
-    return 0;
+    m->ctrl[i] = c;
+    if (i < M_HASHMAP_GROUP)
+        m->ctrl[m->capacity + i] = c;
+}
+
+/**
+ * probe for a key, a group at a time, starting where its hash says and
+ * moving on by one more group each time. a group with an empty slot ends
+ * the search, since the key would have been put there.
+ */
+static size_t
+m_hashmap_probe(m_hashmap* m, const void* key, size_t len, uint64_t hash, bool* found)
+{
+    size_t mask  = m->capacity - 1;
+    size_t pos   = M_HASHMAP_H1(hash) & mask;
+    size_t spare = (size_t)-1;
+
+    for (size_t step = M_HASHMAP_GROUP; ; pos = (pos + step) & mask, step += M_HASHMAP_GROUP)
+    {
+        const unsigned char* group = m->ctrl + pos;
+        unsigned match = m_hashmap_group_match(group, M_HASHMAP_H2(hash));
+        unsigned open;
+
+        while (match) {
+            size_t i = (pos + m_hashmap_lowest(match)) & mask;
+            m_hashslot* s = M_HASHMAP_SLOT(m, i);
+            if (s->hash == hash && s->len == len && !memcmp(s->key, key, len)) {
+                *found = true;
+                return i;
+            }
+            match &= match - 1;
+        }
+
+        open = m_hashmap_group_free(group);
+        if (open && spare == (size_t)-1)
+            spare = (pos + m_hashmap_lowest(open)) & mask;
+        if (m_hashmap_group_match(group, M_HASHMAP_EMPTY)) {
+            *found = false;
+            return spare;
+        }
+    }
+}
+
+/* move every key into a table of the given size, dropping deleted slots */
+static void
+m_hashmap_resize(m_hashmap* m, size_t capacity)
+{
+    m_hashmap old = *m;
+
+    m->capacity = capacity;
+    m->tombs    = 0;
+    m->ctrl     = (unsigned char*)malloc(capacity + M_HASHMAP_GROUP);
+    m->slots    = (unsigned char*)malloc(capacity * m->stride);
+    if (m->ctrl == NULL || m->slots == NULL) {
+        fputs("out of memory.\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    memset(m->ctrl, M_HASHMAP_EMPTY, capacity + M_HASHMAP_GROUP);
+
+    for (size_t i = 0; i < old.capacity; ++i) {
+        size_t mask = capacity - 1;
+        size_t pos;
+        unsigned open;
+        uint64_t hash;
+
+        if (old.ctrl[i] & 0x80)
+            continue;
+
+        /* nothing in the new table matches, so only a free slot is wanted */
+        hash = M_HASHMAP_SLOT(&old, i)->hash;
+        pos  = M_HASHMAP_H1(hash) & mask;
+        for (size_t step = M_HASHMAP_GROUP; !(open = m_hashmap_group_free(m->ctrl + pos)); step += M_HASHMAP_GROUP)
+            pos = (pos + step) & mask;
+        pos = (pos + m_hashmap_lowest(open)) & mask;
+
+        m_hashmap_set_ctrl(m, pos, M_HASHMAP_H2(hash));
+        memcpy(M_HASHMAP_SLOT(m, pos), M_HASHMAP_SLOT(&old, i), m->stride);
+    }
+
+    free(old.ctrl);
+    free(old.slots);
 }
 
-m_hashmap* m_hashmap_init(int vsize, unsigned long (*hash)(unsigned char* str))
+/**
+ * @brief Initialize a hashmap.
+ *
+ * @param vsize Size of each value.
+ * @param hash Hash of a key's bytes, or NULL for m_hashmap_hash_bytes.
+ * @return An empty map; no table is reserved until the first insert.
+ */
+m_hashmap* m_hashmap_init(int vsize, uint64_t (*hash)(const void* key, size_t len))
 {
     m_hashmap* map = (m_hashmap*)malloc(sizeof(m_hashmap));
-    map->hash      = hash == NULL ? m_hashmap_def_hashfunc : hash;
+    map->hash      = hash == NULL ? m_hashmap_hash_bytes : hash;
     map->vsize     = vsize;
-    map->tree      = m_bstree_init(sizeof(m_hashentry), m_hashentry_comp);
-    map->dump      = m_bstree_init(sizeof(m_dumpentry), m_dump_comp);
-    
+    map->stride    = (M_HASHMAP_HEADER + vsize + M_HASHMAP_ALIGN - 1) & ~(M_HASHMAP_ALIGN - 1);
+    map->count     = 0;
+    map->capacity  = 0;
+    map->tombs     = 0;
+    map->ctrl      = NULL;
+    map->slots     = NULL;
+    map->keys      = m_arena_init();
+
     return map;
 }
 
 int m_hashmap_destroy(m_hashmap* m) {
-    m_bstree_destroy(m->tree);
-    m_bstree_destroy(m->dump);
+    free(m->ctrl);
+    free(m->slots);
+    m_arena_destroy(&m->keys);
     free(m);
     return 0;
 }
 
+/**
+ * @brief Look a key up.
+ *
+ * @param m Map to look in.
+ * @param key Bytes of the key.
+ * @param len Length of the key.
+ * @return The value, where it is kept in the map, or NULL if the key is
+ * not there. It stays put until the next insert.
+ */
+void* m_hashmap_find(m_hashmap* m, const void* key, size_t len)
+{
+    bool found;
+    size_t i;
+
+    if (m->count == 0)
+        return NULL;
+    i = m_hashmap_probe(m, key, len, m->hash(key, len), &found);
+    return found ? M_HASHMAP_VALUE(m, i) : NULL;
+}
+
+/**
+ * @brief Add a key, or replace its value if it is there already. The
+ * table grows once seven slots in eight are used or deleted.
+ *
+ * @param m Map to add to.
+ * @param key Bytes of the key, which are copied.
+ * @param len Length of the key.
+ * @param val Value to copy in, or NULL to leave an existing value alone
+ * and zero a new one, for callers that fill it in place.
+ * @return The value, where it is kept in the map.
+ */
+void* m_hashmap_insert(m_hashmap* m, const void* key, size_t len, void* val)
+{
+    bool found;
+    size_t i;
+    char* copy;
+    m_hashslot* s;
+    uint64_t hash = m->hash(key, len);
+
+    if (m->capacity == 0)
+        m_hashmap_resize(m, M_HASHMAP_GROUP);
+
+    i = m_hashmap_probe(m, key, len, hash, &found);
+    if (!found) {
+        /* out of room: grow, or just clear out deleted slots if they are most of it */
+        if ((m->count + m->tombs + 1) * 8 > m->capacity * 7) {
+            m_hashmap_resize(m, m->count * 2 >= m->capacity ? m->capacity * 2 : m->capacity);
+            i = m_hashmap_probe(m, key, len, hash, &found);
+        }
+
+        copy = (char*)m_arena_alloc(&m->keys, len ? len : 1);
+        memcpy(copy, key, len);
+        s = M_HASHMAP_SLOT(m, i);
+        s->hash = hash;
+        s->key  = copy;
+        s->len  = len;
+
+        m->tombs -= m->ctrl[i] == M_HASHMAP_DELETED;
+        m_hashmap_set_ctrl(m, i, M_HASHMAP_H2(hash));
+        m->count++;
+        if (val == NULL)
+            memset(M_HASHMAP_VALUE(m, i), 0, m->vsize);
+    }
+
+    if (val != NULL)
+        memcpy(M_HASHMAP_VALUE(m, i), val, m->vsize);
+    return M_HASHMAP_VALUE(m, i);
+}
+
+/**
+ * @brief Remove a key. Its copy stays in the arena until the map is
+ * destroyed.
+ *
+ * @param m Map to remove from.
+ * @param key Bytes of the key.
+ * @param len Length of the key.
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the key was not there.
+ */
+int m_hashmap_erase(m_hashmap* m, const void* key, size_t len)
+{
+    bool found;
+    size_t i;
+
+    if (m->count == 0)
+        return EXIT_FAILURE;
+    i = m_hashmap_probe(m, key, len, m->hash(key, len), &found);
+    if (!found)
+        return EXIT_FAILURE;
+
+    m_hashmap_set_ctrl(m, i, M_HASHMAP_DELETED);
+    m->count--;
+    m->tombs++;
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief Walk the map, in no particular order.
+ *
+ * @param m Map to walk.
+ * @param at Where the walk is; start it at 0.
+ * @param key Where the key goes, or NULL.
+ * @param len Where its length goes, or NULL.
+ * @return The next value, or NULL once every key has been seen.
+ */
+void* m_hashmap_next(m_hashmap* m, size_t* at, const char** key, size_t* len)
+{
+    for (; *at < m->capacity; ++*at) {
+        if (!(m->ctrl[*at] & 0x80)) {
+            m_hashslot* s = M_HASHMAP_SLOT(m, *at);
+            if (key) *key = s->key;
+            if (len) *len = s->len;
+            return M_HASHMAP_VALUE(m, (*at)++);
+        }
+    }
+    return NULL;
+}
+
 void* m_hashmap_get(m_hashmap *m, char* key)
 {
-    m_hashentry* e = (m_hashentry*)malloc(sizeof(m_hashentry));
-    e->key = m->hash(key);
-    printf("Finding %s, with hash %u\n", key, e->key);
-    void* ret = m_bstree_find(m->tree, e);
-    if (ret == NULL) {
-        printf("Didn't find it??\n");
-        m_dumpentry* d = (m_dumpentry*)malloc(sizeof(m_dumpentry));
-        d->key = key;
-        ret = m_bstree_find(m->dump, d);
-        return (!ret) ? NULL : ((m_dumpentry*)ret)->value;
-    } else return ((m_hashentry*)ret)->value;
+    return m_hashmap_find(m, key, strlen(key));
 }
 
 int m_hashmap_set(m_hashmap* m, char* key, void* val)
 {
-    m_hashentry* e = (m_hashentry*)malloc(sizeof(m_hashentry));
-    e->key = m->hash(key);
-    printf("Finding %s, with hash %u\n", key, e->key);
-    void* ret = m_bstree_find(m->tree, e);
-    if (ret == NULL) {
-        printf("Didn't find it??\n");
-        m_dumpentry* d = (m_dumpentry*)malloc(sizeof(m_dumpentry));
-        d->key = key;
-        ret = m_bstree_find(m->dump, d);
-        if (ret) {
-            ((m_hashentry*)ret)->value = val;
-            return EXIT_SUCCESS;
-        } else return EXIT_FAILURE;
-    } else {
-        ((m_hashentry*)ret)->value = val;
-        return EXIT_SUCCESS;
-    }
+    void* ret = m_hashmap_find(m, key, strlen(key));
+    if (ret == NULL)
+        return EXIT_FAILURE;
+    memcpy(ret, val, m->vsize);
+    return EXIT_SUCCESS;
 }
 
 void m_hashmap_remove(m_hashmap *m, char* key)
 {
-    m_hashentry* e = (m_hashentry*)malloc(sizeof(m_hashentry));
-    e->key = m->hash(key);
-    printf("Finding %s, with hash %u\n", key, e->key);
-    void* ret = m_bstree_find(m->tree, e);
-    if (ret != NULL) {
-        printf("Found it!!\n");
-        m_bstree_remove(m->tree, ret);
-    }
+    m_hashmap_erase(m, key, strlen(key));
 }
 
 int m_hashmap_add_entry(m_hashmap *m, char* key, void* val)
 {
-    m_hashentry* e = (m_hashentry*)malloc(sizeof(m_hashentry));
-    e->key = m->hash(key);
-    e->value = malloc(m->vsize);
-    memcpy(e->value, val, m->vsize);
-    if (m_bstree_add(m->tree, e) == -1)
-    {
-        m_hashentry* e2 = (m_hashentry*)m_bstree_find(m->tree, e);
-        if (e2->key != e->key) {
-            m_dumpentry* d = (m_dumpentry*)malloc(sizeof(m_dumpentry));
-            d->key = key;
-            d->value = malloc(m->vsize);
-            memcpy(d->value, val, m->vsize);
-            m_bstree_add(m->dump, d);
-        }
-    }
-}
\ No newline at end of file
+    m_hashmap_insert(m, key, strlen(key), val);
+    return EXIT_SUCCESS;
+}
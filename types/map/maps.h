@@ -4,39 +4,50 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include "..\list\lists.h"
-#include "..\bstree\bstree.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include "../arena/arena.h"
 
-typedef struct m_hashentry
-{
-    void* value;
-    unsigned int key;
-}
-m_hashentry;
-
-typedef struct m_dumpentry
-{
-    char* key;
-    void* value; 
-}
-m_dumpentry;
+/* control bytes looked at in one probe */
+#define M_HASHMAP_GROUP 16
 
+/**
+ * A flat, open addressing map from byte strings to values of one size.
+ * Every slot has a control byte: empty, deleted, or seven bits of the
+ * hash of the key held there. A lookup checks a whole group of control
+ * bytes at once (with SSE2 where there is one) and only compares keys
+ * whose seven bits match, so most misses touch no slot at all. Values
+ * live in the slots, after the key's hash and length, and the keys are
+ * copied into an arena the map owns.
+ */
 typedef struct m_hashmap
 {
     size_t vsize;                               // Size of hashmap values
-    m_bstree* tree;                             // Hashmap tree size
-    m_bstree* dump;                             // Place to dump collisions
-    unsigned long (*hash)(unsigned char* str);  // Hash function of hashmap
+    size_t stride;                              // Bytes per slot, header and value
+    size_t count;                               // Keys held
+    size_t capacity;                            // Slots, a power of two, or 0 when empty
+    size_t tombs;                               // Slots whose key was removed
+    unsigned char* ctrl;                        // Control bytes, the first group repeated at the end
+    unsigned char* slots;                       // Slot storage
+    m_arena keys;                               // Copies of the keys
+    uint64_t (*hash)(const void* key, size_t len); // Hash function of hashmap
 }
 m_hashmap;
 
+unsigned long m_hashmap_def_hashfunc(unsigned char* str);
+uint64_t m_hashmap_hash_bytes(const void* key, size_t len);
+m_hashmap* m_hashmap_init(int vsize, uint64_t (*hash)(const void* key, size_t len));
 int m_hashmap_destroy(m_hashmap* m);
+void* m_hashmap_find(m_hashmap* m, const void* key, size_t len);
+void* m_hashmap_insert(m_hashmap* m, const void* key, size_t len, void* val);
+int m_hashmap_erase(m_hashmap* m, const void* key, size_t len);
+void* m_hashmap_next(m_hashmap* m, size_t* at, const char** key, size_t* len);
 int m_hashmap_set(m_hashmap *m, char* key, void* val);
 void* m_hashmap_get(m_hashmap *m, char* key);
 void m_hashmap_remove(m_hashmap *m, char* key);
 int m_hashmap_add_entry(m_hashmap *m, char* key, void* val);
-m_hashmap* m_hashmap_init(int vsize, unsigned long (*hash)(unsigned char* str));
 
 #define m_hashmap_create(type, hash) (m_hashmap_init(sizeof(type), (hash)))
+#define m_hashmap_count(m) ((m)->count)
 
-#endif
\ No newline at end of file
+#endif
@@ -26,13 +26,12 @@ int m_stack_push(m_stack* m, void* item)
     else return 0;
 }
 
+/* the item popped stays where it was, valid until the next push */
 void* m_stack_pop(m_stack* m)
 {
     if (m->count > 0) {
         m->count--;
-        void* item = malloc(m->size);
-        memcpy(item, m->content + (m->size * m->count), m->size);
-        return item;
+        return m->content + (m->size * m->count);
     } else return NULL;
 }
 
@@ -6,7 +6,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
-#include "..\list\lists.h"
+#include "../list/lists.h"
 
 typedef struct
 m_tuple